@@ -0,0 +1,125 @@
+#include "stdafx.h"
+#include <array>
+#include <atomic>
+#include <eventual/memory_resource.h>
+
+// A producer thread creates promises and hands their (ready) futures to a consumer thread,
+// which releases the last reference: each State is allocated on one thread and freed on the
+// other. Compares the memory resources when each is set as the library default.
+
+using namespace eventual;
+
+namespace
+{
+    constexpr std::size_t handoffCount = 200000;
+
+    // a single producer, single consumer ring of futures
+    class Handoff
+    {
+        static constexpr std::size_t Capacity = 256;
+
+    public:
+
+        Handoff() : _head(0), _tail(0) { }
+
+        void Push(future<int>&& future)
+        {
+            const auto tail = _tail.load(std::memory_order_relaxed);
+            while (tail - _head.load(std::memory_order_acquire) == Capacity)
+                std::this_thread::yield();
+
+            _slots[tail % Capacity] = std::move(future);
+            _tail.store(tail + 1, std::memory_order_release);
+        }
+
+        future<int> Pop()
+        {
+            const auto head = _head.load(std::memory_order_relaxed);
+            while (_tail.load(std::memory_order_acquire) == head)
+                std::this_thread::yield();
+
+            auto future = std::move(_slots[head % Capacity]);
+            _head.store(head + 1, std::memory_order_release);
+
+            return future;
+        }
+
+    private:
+        std::array<future<int>, Capacity> _slots;
+        std::atomic<std::size_t> _head;
+        std::atomic<std::size_t> _tail;
+    };
+
+    double PingPong(memory_resource* resource)
+    {
+        auto previous = set_default_resource(resource);
+
+        Handoff handoff;
+        std::size_t sum = 0;
+
+        auto producer = [&handoff]()
+        {
+            for (std::size_t i = 0; i < handoffCount; ++i)
+            {
+                promise<int> p;
+                auto f = p.get_future();
+                p.set_value(1);
+                handoff.Push(std::move(f));
+            }
+        };
+
+        auto consumer = [&handoff, &sum]()
+        {
+            for (std::size_t i = 0; i < handoffCount; ++i)
+                sum += handoff.Pop().get();
+        };
+
+        auto ns = benchmark::RunConcurrently(producer, consumer);
+
+        set_default_resource(previous);
+        benchmark::DoNotOptimize(sum);
+
+        return ns / handoffCount;
+    }
+}
+
+BENCHMARK_CASE(Allocation, CrossThreadPingPong)
+{
+    synchronized_pool_resource pool;
+    thread_caching_resource cache;
+
+    benchmark::Report("new_delete_resource", PingPong(new_delete_resource()), "ns/state");
+    benchmark::Report("synchronized_pool_resource", PingPong(&pool), "ns/state");
+    benchmark::Report("thread_caching_resource", PingPong(&cache), "ns/state");
+}
+
+BENCHMARK_CASE(Allocation, SameThread)
+{
+    synchronized_pool_resource pool;
+    unsynchronized_pool_resource unsynchronized;
+    thread_caching_resource cache;
+
+    auto run = [](memory_resource* resource)
+    {
+        auto previous = set_default_resource(resource);
+        std::size_t sum = 0;
+
+        auto ns = benchmark::NanosecondsPerIteration(handoffCount, [&sum]()
+        {
+            promise<int> p;
+            auto f = p.get_future();
+            p.set_value(1);
+            sum += f.get();
+        });
+
+        set_default_resource(previous);
+        benchmark::DoNotOptimize(sum);
+
+        return ns;
+    };
+
+    benchmark::Report("new_delete_resource", run(new_delete_resource()), "ns/state");
+    benchmark::Report("unsynchronized_pool_resource", run(&unsynchronized), "ns/state");
+    benchmark::Report("synchronized_pool_resource", run(&pool), "ns/state");
+    benchmark::Report("thread_caching_resource", run(&cache), "ns/state");
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+
+// A minimal benchmark harness; intentionally dependency free so that the
+// benchmarks can be built anywhere the library itself can be built.
+
+namespace benchmark
+{
+    using clock = std::chrono::steady_clock;
+
+    class Registry
+    {
+        struct Entry
+        {
+            std::string name;
+            void(*function)();
+        };
+
+    public:
+
+        static Registry& Instance()
+        {
+            static Registry instance;
+            return instance;
+        }
+
+        void Add(const char* group, const char* name, void(*function)())
+        {
+            _entries.push_back({ std::string(group) + "." + name, function });
+        }
+
+        int Run(const std::string& filter) const
+        {
+            auto ran = 0;
+            for (const auto& entry : _entries)
+            {
+                if (!filter.empty() && entry.name.find(filter) == std::string::npos)
+                    continue;
+
+                std::printf("[ %s ]\n", entry.name.c_str());
+                entry.function();
+                std::fflush(stdout);
+                ran++;
+            }
+
+            return ran;
+        }
+
+    private:
+        std::vector<Entry> _entries;
+    };
+
+    struct Registration
+    {
+        Registration(const char* group, const char* name, void(*function)())
+        {
+            Registry::Instance().Add(group, name, function);
+        }
+    };
+
+    inline void Report(const char* label, double value, const char* unit)
+    {
+        std::printf("    %-44s %14.2f %s\n", label, value, unit);
+    }
+
+    inline double ElapsedNanoseconds(clock::time_point start, clock::time_point end)
+    {
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+
+    // returns the average cost of a single invocation of 'function', in nanoseconds.
+    template<class F>
+    double NanosecondsPerIteration(std::size_t iterations, F&& function)
+    {
+        auto start = clock::now();
+        for (std::size_t i = 0; i < iterations; ++i)
+            function();
+
+        return ElapsedNanoseconds(start, clock::now()) / iterations;
+    }
+
+    // runs each function on its own thread, released at the same time; returns the wall time in nanoseconds.
+    template<class... F>
+    double RunConcurrently(F&&... functions)
+    {
+        std::atomic<bool> go(false);
+        std::vector<std::thread> threads;
+
+        auto launch = [&](auto& function)
+        {
+            threads.emplace_back([&go, &function]()
+            {
+                while (!go.load(std::memory_order_acquire))
+                    std::this_thread::yield();
+
+                function();
+            });
+            return 0;
+        };
+
+        int expand[] = { 0, launch(functions)... };
+        (void)expand;
+
+        auto start = clock::now();
+        go.store(true, std::memory_order_release);
+
+        for (auto& thread : threads)
+            thread.join();
+
+        return ElapsedNanoseconds(start, clock::now());
+    }
+
+    inline std::size_t HardwareThreads()
+    {
+        return std::max<std::size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    // keeps the optimizer from discarding a computed value.
+    template<class T>
+    inline void DoNotOptimize(const T& value)
+    {
+        static const void* volatile sink = nullptr;
+        sink = &value;
+        (void)sink;
+    }
+}
+
+#define BENCHMARK_CASE(group, name) \
+    static void group##_##name##_benchmark(); \
+    static ::benchmark::Registration group##_##name##_registration(#group, #name, &group##_##name##_benchmark); \
+    static void group##_##name##_benchmark()
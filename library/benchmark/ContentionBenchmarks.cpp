@@ -0,0 +1,140 @@
+#include "stdafx.h"
+#include <atomic>
+#include <vector>
+
+// Producers publishing results race consumers registering continuations (or
+// blocking) on the same shared states; measures the per-hop cost of that race.
+
+using namespace eventual;
+
+namespace
+{
+    constexpr std::size_t pairCount = 200000;
+
+    struct Pairs
+    {
+        explicit Pairs(std::size_t count)
+            : promises(count)
+        {
+            futures.reserve(count);
+            for (auto& promise : promises)
+                futures.emplace_back(promise.get_future());
+        }
+
+        std::vector<promise<int>> promises;
+        std::vector<future<int>> futures;
+    };
+}
+
+BENCHMARK_CASE(Contention, Uncontended_SetThen)
+{
+    std::size_t sum = 0;
+    auto ns = benchmark::NanosecondsPerIteration(pairCount, [&sum]()
+    {
+        promise<int> p;
+        p.get_future().then([&sum](future<int> f) { sum += f.get(); });
+        p.set_value(1);
+    });
+
+    benchmark::DoNotOptimize(sum);
+    benchmark::Report("promise + then + set_value (one thread)", ns, "ns/op");
+}
+
+BENCHMARK_CASE(Contention, SetValue_Versus_Then)
+{
+    Pairs pairs(pairCount);
+    std::atomic<std::size_t> sum(0);
+
+    auto producer = [&pairs]()
+    {
+        for (auto& promise : pairs.promises)
+            promise.set_value(1);
+    };
+
+    auto consumer = [&pairs, &sum]()
+    {
+        for (auto& future : pairs.futures)
+            future.then([&sum](auto f) { sum.fetch_add(f.get(), std::memory_order_relaxed); });
+    };
+
+    auto ns = benchmark::RunConcurrently(producer, consumer);
+
+    benchmark::DoNotOptimize(sum);
+    benchmark::Report("set_value racing then (2 threads)", ns / pairCount, "ns/pair");
+}
+
+BENCHMARK_CASE(Contention, FanIn)
+{
+    const auto producers = benchmark::HardwareThreads();
+    Pairs pairs(pairCount);
+    std::atomic<std::size_t> sum(0);
+
+    std::vector<std::thread> threads;
+    std::atomic<bool> go(false);
+    for (std::size_t p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&pairs, &go, p, producers]()
+        {
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+
+            for (auto i = p; i < pairs.promises.size(); i += producers)
+                pairs.promises[i].set_value(1);
+        });
+    }
+
+    auto start = benchmark::clock::now();
+    go.store(true, std::memory_order_release);
+
+    for (auto& future : pairs.futures)
+        future.then([&sum](auto f) { sum.fetch_add(f.get(), std::memory_order_relaxed); });
+
+    for (auto& thread : threads)
+        thread.join();
+
+    auto ns = benchmark::ElapsedNanoseconds(start, benchmark::clock::now());
+
+    benchmark::DoNotOptimize(sum);
+    benchmark::Report("N producers fanning into 1 consumer", ns / pairCount, "ns/pair");
+    benchmark::Report("producers", static_cast<double>(producers), "threads");
+}
+
+BENCHMARK_CASE(Contention, SetValue_Versus_Get)
+{
+    Pairs pairs(pairCount);
+    std::size_t sum = 0;
+
+    auto producer = [&pairs]()
+    {
+        for (auto& promise : pairs.promises)
+            promise.set_value(1);
+    };
+
+    auto consumer = [&pairs, &sum]()
+    {
+        for (auto& future : pairs.futures)
+            sum += future.get();
+    };
+
+    auto ns = benchmark::RunConcurrently(producer, consumer);
+
+    benchmark::DoNotOptimize(sum);
+    benchmark::Report("set_value racing blocking get (2 threads)", ns / pairCount, "ns/pair");
+}
+
+BENCHMARK_CASE(Contention, IsReady_Polling)
+{
+    Pairs pairs(pairCount);
+    for (auto& promise : pairs.promises)
+        promise.set_value(1);
+
+    std::size_t ready = 0;
+    auto ns = benchmark::NanosecondsPerIteration(16, [&pairs, &ready]()
+    {
+        for (const auto& future : pairs.futures)
+            ready += future.is_ready() ? 1 : 0;
+    });
+
+    benchmark::DoNotOptimize(ready);
+    benchmark::Report("is_ready on a completed state", ns / pairCount, "ns/op");
+}
@@ -0,0 +1,59 @@
+#include "stdafx.h"
+#include <cstdint>
+
+// Completes a promise at the head of a chain of then() continuations, each of which
+// completes the next, and reports the cost per link and the stack used by the cascade.
+// Continuations made runnable by a running continuation are queued on the completing
+// thread rather than run inside it, so the stack used should not grow with the chain.
+
+using namespace eventual;
+
+namespace
+{
+    std::uintptr_t lowestStackAddress;
+
+    void NoteStackAddress()
+    {
+        char marker = 0;
+        auto address = reinterpret_cast<std::uintptr_t>(&marker);
+        if (address < lowestStackAddress)
+            lowestStackAddress = address;
+
+        benchmark::DoNotOptimize(marker);
+    }
+
+    void RunChain(std::size_t links)
+    {
+        promise<std::size_t> head;
+        auto chain = head.get_future();
+
+        for (std::size_t i = 0; i < links; ++i)
+        {
+            chain = chain.then([](future<std::size_t>& f)
+            {
+                NoteStackAddress();
+                return f.get() + 1;
+            });
+        }
+
+        char top = 0;
+        lowestStackAddress = reinterpret_cast<std::uintptr_t>(&top);
+
+        auto start = benchmark::clock::now();
+        head.set_value(0);
+        auto ns = benchmark::ElapsedNanoseconds(start, benchmark::clock::now());
+
+        auto stack = reinterpret_cast<std::uintptr_t>(&top) - lowestStackAddress;
+        benchmark::DoNotOptimize(chain.get());
+
+        auto label = std::to_string(links) + " links";
+        benchmark::Report((label + ", completion").c_str(), ns / links, "ns/link");
+        benchmark::Report((label + ", stack used").c_str(), static_cast<double>(stack), "bytes");
+    }
+}
+
+BENCHMARK_CASE(ContinuationDepth, PendingChain)
+{
+    for (std::size_t links : { 10, 1000, 100000, 1000000 })
+        RunChain(links);
+}
@@ -0,0 +1,204 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+#include <eventual/memory_resource.h>
+
+#if defined(__linux__)
+    #include <cstring>
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+// Holds a large population of pending futures (10 million by default; set
+// EVENTUAL_PENDING_FUTURES to change it) and polls every one of them in a random order, as a
+// server sweeping its outstanding requests would. Compares the states allocated with the
+// global operator new against a huge_page_resource: the cost of the sweep is dominated by TLB
+// misses when the states are spread over 4 KiB pages. Reports the dTLB load misses (where
+// the kernel lets the process count them) and the resident set.
+
+using namespace eventual;
+
+namespace
+{
+    std::size_t PendingFutures()
+    {
+        auto value = std::getenv("EVENTUAL_PENDING_FUTURES");
+        auto count = value ? std::strtoull(value, nullptr, 10) : 0;
+
+        return count ? static_cast<std::size_t>(count) : 10000000;
+    }
+
+#if defined(__linux__)
+
+    // counts the dTLB load misses of the calling thread, in user mode.
+    class DtlbMisses
+    {
+    public:
+
+        DtlbMisses()
+        {
+            perf_event_attr attributes;
+            std::memset(&attributes, 0, sizeof(attributes));
+            attributes.size = sizeof(attributes);
+            attributes.type = PERF_TYPE_HW_CACHE;
+            attributes.config = PERF_COUNT_HW_CACHE_DTLB |
+                                (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            attributes.disabled = 1;
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+
+            _fd = static_cast<int>(::syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0));
+        }
+
+        ~DtlbMisses()
+        {
+            if (_fd >= 0)
+                ::close(_fd);
+        }
+
+        bool IsAvailable() const { return _fd >= 0; }
+
+        void Start()
+        {
+            if (IsAvailable())
+            {
+                ::ioctl(_fd, PERF_EVENT_IOC_RESET, 0);
+                ::ioctl(_fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+
+        std::uint64_t Stop()
+        {
+            std::uint64_t count = 0;
+            if (IsAvailable())
+            {
+                ::ioctl(_fd, PERF_EVENT_IOC_DISABLE, 0);
+                if (::read(_fd, &count, sizeof(count)) != sizeof(count))
+                    count = 0;
+            }
+
+            return count;
+        }
+
+    private:
+        int _fd;
+    };
+
+    // the value of a "Name:   1234 kB" line of a /proc file, in MiB; negative if missing.
+    double ProcMebibytes(const char* path, const std::string& name)
+    {
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line))
+        {
+            if (line.compare(0, name.size(), name) == 0 && line.size() > name.size() && line[name.size()] == ':')
+                return std::strtod(line.c_str() + name.size() + 1, nullptr) / 1024;
+        }
+
+        return -1;
+    }
+
+    double ResidentMebibytes()
+    {
+        return ProcMebibytes("/proc/self/status", "VmRSS");
+    }
+
+    double AnonHugePageMebibytes()
+    {
+        return ProcMebibytes("/proc/self/smaps_rollup", "AnonHugePages");
+    }
+
+#else
+
+    class DtlbMisses
+    {
+    public:
+        bool IsAvailable() const { return false; }
+        void Start() { }
+        std::uint64_t Stop() { return 0; }
+    };
+
+    double ResidentMebibytes() { return -1; }
+    double AnonHugePageMebibytes() { return -1; }
+
+#endif
+
+    void ReportIfKnown(const std::string& label, bool known, double value, const char* unit)
+    {
+        if (known)
+            benchmark::Report(label.c_str(), value, unit);
+        else
+            std::printf("    %-44s %14s %s\n", label.c_str(), "n/a", unit);
+    }
+
+    void Sweep(const char* name, memory_resource* resource, std::size_t count)
+    {
+        // future i is stored at a random position, so the sweep below visits the states (which
+        // are allocated in order) at random, while reading the futures themselves in order.
+        std::vector<std::size_t> position(count);
+        std::iota(position.begin(), position.end(), std::size_t(0));
+        std::shuffle(position.begin(), position.end(), std::mt19937_64(42));
+
+        const auto residentBefore = ResidentMebibytes();
+
+        std::vector<promise<int>> promises;
+        std::vector<future<int>> futures(count);
+        promises.reserve(count);
+
+        auto start = benchmark::clock::now();
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            promises.emplace_back(std::allocator_arg_t(), resource);
+            futures[position[i]] = promises.back().get_future();
+        }
+        auto created = benchmark::ElapsedNanoseconds(start, benchmark::clock::now());
+
+        const auto resident = ResidentMebibytes() - residentBefore;
+        const auto hugePages = AnonHugePageMebibytes();
+
+        DtlbMisses misses;
+        std::size_t ready = 0;
+
+        misses.Start();
+        start = benchmark::clock::now();
+        for (const auto& future : futures)
+            ready += future.is_ready() ? 1 : 0;
+        auto swept = benchmark::ElapsedNanoseconds(start, benchmark::clock::now());
+        const auto missCount = misses.Stop();
+
+        benchmark::DoNotOptimize(ready);
+
+        for (auto& promise : promises)
+            promise.set_value(0);
+
+        const std::string prefix(name);
+        benchmark::Report((prefix + " create").c_str(), created / count, "ns/future");
+        benchmark::Report((prefix + " random is_ready").c_str(), swept / count, "ns/future");
+        ReportIfKnown(prefix + " dTLB load misses", misses.IsAvailable(), double(missCount) / count, "misses/future");
+        ReportIfKnown(prefix + " resident set growth", resident >= 0, resident, "MiB");
+        ReportIfKnown(prefix + " AnonHugePages", hugePages >= 0, hugePages, "MiB");
+    }
+}
+
+BENCHMARK_CASE(HugePages, PendingFutures)
+{
+    const auto count = PendingFutures();
+    std::printf("    %zu pending futures\n", count);
+
+    Sweep("new_delete_resource", new_delete_resource(), count);
+
+    {
+        huge_page_resource resource;
+        Sweep("huge_page_resource", &resource, count);
+        std::printf("    huge_page_resource %s huge pages\n", resource.uses_huge_pages() ? "is on" : "could not get");
+    }
+}
@@ -0,0 +1,55 @@
+#include "stdafx.h"
+
+// Compares futures that are ready when they are created (held without a State)
+// with the same round trips through a promise.
+
+using namespace eventual;
+
+namespace
+{
+    constexpr std::size_t iterations = 500000;
+}
+
+BENCHMARK_CASE(ReadyFuture, Get)
+{
+    std::size_t sum = 0;
+
+    auto ready = benchmark::NanosecondsPerIteration(iterations, [&sum]()
+    {
+        sum += make_ready_future(1).get();
+    });
+
+    auto promised = benchmark::NanosecondsPerIteration(iterations, [&sum]()
+    {
+        promise<int> p;
+        auto f = p.get_future();
+        p.set_value(1);
+        sum += f.get();
+    });
+
+    benchmark::DoNotOptimize(sum);
+    benchmark::Report("make_ready_future + get", ready, "ns/op");
+    benchmark::Report("promise + set_value + get", promised, "ns/op");
+}
+
+BENCHMARK_CASE(ReadyFuture, Then)
+{
+    std::size_t sum = 0;
+
+    auto ready = benchmark::NanosecondsPerIteration(iterations, [&sum]()
+    {
+        sum += make_ready_future(1).then([](future<int>& f) { return f.get() + 1; }).get();
+    });
+
+    auto promised = benchmark::NanosecondsPerIteration(iterations, [&sum]()
+    {
+        promise<int> p;
+        auto f = p.get_future();
+        p.set_value(1);
+        sum += f.then([](future<int>& f) { return f.get() + 1; }).get();
+    });
+
+    benchmark::DoNotOptimize(sum);
+    benchmark::Report("make_ready_future + then + get", ready, "ns/op");
+    benchmark::Report("promise + set_value + then + get", promised, "ns/op");
+}
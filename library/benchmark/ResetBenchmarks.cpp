@@ -0,0 +1,68 @@
+#include "stdafx.h"
+
+// A periodic task: each period runs a packaged_task (or sets a promise), reads the result and
+// resets it for the next period. The reset reuses the State once the future is released, and
+// allocates a new one while the previous period's future is still held.
+
+using namespace eventual;
+
+namespace
+{
+    constexpr std::size_t iterations = 500000;
+}
+
+BENCHMARK_CASE(Reset, PackagedTask)
+{
+    std::size_t sum = 0;
+    packaged_task<int(int)> task([](int i) { return i + 1; });
+
+    auto recycled = benchmark::NanosecondsPerIteration(iterations, [&]()
+    {
+        {
+            auto f = task.get_future();
+            task(1);
+            sum += f.get();
+        }
+        task.reset();
+    });
+
+    auto reallocated = benchmark::NanosecondsPerIteration(iterations, [&]()
+    {
+        auto f = task.get_future();
+        task(1);
+        task.reset();
+        sum += f.get();
+    });
+
+    benchmark::DoNotOptimize(sum);
+    benchmark::Report("reset, future released (reused)", recycled, "ns/op");
+    benchmark::Report("reset, future held (allocated)", reallocated, "ns/op");
+}
+
+BENCHMARK_CASE(Reset, Promise)
+{
+    std::size_t sum = 0;
+    promise<int> p;
+
+    auto recycled = benchmark::NanosecondsPerIteration(iterations, [&]()
+    {
+        {
+            auto f = p.get_future();
+            p.set_value(1);
+            sum += f.get();
+        }
+        p.reset();
+    });
+
+    auto fresh = benchmark::NanosecondsPerIteration(iterations, [&sum]()
+    {
+        promise<int> q;
+        auto f = q.get_future();
+        q.set_value(1);
+        sum += f.get();
+    });
+
+    benchmark::DoNotOptimize(sum);
+    benchmark::Report("promise::reset (reused)", recycled, "ns/op");
+    benchmark::Report("new promise each period", fresh, "ns/op");
+}
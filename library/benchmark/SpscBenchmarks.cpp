@@ -0,0 +1,95 @@
+#include "stdafx.h"
+#include <vector>
+
+// Compares promise with spsc_promise on the one-shot paths: setting a value that is then read,
+// and setting a value under a continuation that was attached first. The cross-thread case hands
+// a run of promises to a producer while the consumer reads the futures in order.
+
+using namespace eventual;
+
+namespace
+{
+    constexpr std::size_t iterations = 500000;
+    constexpr std::size_t handoffs = 200000;
+
+    template<class TPromise>
+    double SetGet()
+    {
+        std::size_t sum = 0;
+
+        auto ns = benchmark::NanosecondsPerIteration(iterations, [&sum]()
+        {
+            TPromise p;
+            auto f = p.get_future();
+            p.set_value(1);
+            sum += f.get();
+        });
+
+        benchmark::DoNotOptimize(sum);
+        return ns;
+    }
+
+    template<class TPromise>
+    double ThenSet()
+    {
+        std::size_t sum = 0;
+
+        auto ns = benchmark::NanosecondsPerIteration(iterations, [&sum]()
+        {
+            TPromise p;
+            auto f = p.get_future().then([](future<int>& f) { return f.get() + 1; });
+            p.set_value(1);
+            sum += f.get();
+        });
+
+        benchmark::DoNotOptimize(sum);
+        return ns;
+    }
+
+    template<class TPromise>
+    double Handoff()
+    {
+        std::vector<TPromise> promises(handoffs);
+        std::vector<future<int>> futures;
+        futures.reserve(handoffs);
+
+        for (auto& p : promises)
+            futures.push_back(p.get_future());
+
+        long long sum = 0;
+        auto ns = benchmark::RunConcurrently(
+            [&]()
+            {
+                for (std::size_t i = 0; i < handoffs; ++i)
+                    promises[i].set_value(static_cast<int>(i));
+            },
+            [&]()
+            {
+                for (auto& f : futures)
+                    sum += f.get();
+            });
+
+        benchmark::DoNotOptimize(sum);
+        return ns / handoffs;
+    }
+}
+
+BENCHMARK_CASE(Spsc, SetGet)
+{
+    benchmark::Report("promise + set_value + get", SetGet<promise<int>>(), "ns/op");
+    benchmark::Report("spsc_promise + set_value + get", SetGet<spsc_promise<int>>(), "ns/op");
+}
+
+BENCHMARK_CASE(Spsc, ThenSet)
+{
+    benchmark::Report("promise + then + set_value + get", ThenSet<promise<int>>(), "ns/op");
+    benchmark::Report("spsc_promise + then + set_value + get", ThenSet<spsc_promise<int>>(), "ns/op");
+}
+
+BENCHMARK_CASE(Spsc, Handoff)
+{
+    std::printf("    %zu hardware threads\n", benchmark::HardwareThreads());
+
+    benchmark::Report("promise", Handoff<promise<int>>(), "ns/item");
+    benchmark::Report("spsc_promise", Handoff<spsc_promise<int>>(), "ns/item");
+}
@@ -0,0 +1,85 @@
+#include "stdafx.h"
+#include <string>
+#include <vector>
+#include <eventual/memory_resource.h>
+
+// Reports the size of the State behind a future for a few result types (a State is the one
+// allocation made per pending future, so its size bounds how many of them fit in a cache),
+// and the cost of false sharing between neighbouring States: a producer completes a run of
+// promises while a consumer spins on the futures just behind it. Packed back to back in an
+// arena, the State being completed shares a line with the one being polled; allocated from a
+// cache_aligned_resource, each State has lines of its own. False sharing needs two cores; on a
+// single hardware thread the two layouts should cost the same.
+
+using namespace eventual;
+
+namespace
+{
+    const std::size_t PipelineLength = 200000;
+
+    double Pipeline(memory_resource* resource)
+    {
+        std::vector<promise<int>> promises;
+        std::vector<future<int>> futures;
+        promises.reserve(PipelineLength);
+        futures.reserve(PipelineLength);
+
+        for (std::size_t i = 0; i < PipelineLength; ++i)
+        {
+            promises.emplace_back(std::allocator_arg_t(), resource);
+            futures.push_back(promises.back().get_future());
+        }
+
+        long long sum = 0;
+        auto ns = benchmark::RunConcurrently(
+            [&]()
+            {
+                for (std::size_t i = 0; i < PipelineLength; ++i)
+                    promises[i].set_value(static_cast<int>(i));
+            },
+            [&]()
+            {
+                for (auto& future : futures)
+                {
+                    while (!future.is_ready())
+                        std::this_thread::yield();
+
+                    sum += future.get();
+                }
+            });
+
+        benchmark::DoNotOptimize(sum);
+        return ns / PipelineLength;
+    }
+
+    template<class T>
+    void ReportSize(const char* name)
+    {
+        using state_t = detail::get_state_t<T>;
+
+        benchmark::Report((std::string("sizeof(State<") + name + ">)").c_str(), static_cast<double>(sizeof(state_t)), "bytes");
+    }
+}
+
+BENCHMARK_CASE(StateLayout, Sizes)
+{
+    ReportSize<void>("void");
+    ReportSize<int>("int");
+    ReportSize<std::string>("std::string");
+}
+
+BENCHMARK_CASE(StateLayout, FalseSharing)
+{
+    std::printf("    %zu hardware threads\n", benchmark::HardwareThreads());
+
+    {
+        monotonic_buffer_resource arena;
+        benchmark::Report("packed states", Pipeline(&arena), "ns/item");
+    }
+
+    {
+        monotonic_buffer_resource arena;
+        cache_aligned_resource aligned(&arena);
+        benchmark::Report("cache_aligned_resource", Pipeline(&aligned), "ns/item");
+    }
+}
@@ -0,0 +1,137 @@
+#include "stdafx.h"
+#include <atomic>
+#include <string>
+#include <vector>
+#include <eventual/thread_pool.h>
+
+// Throughput of the work-stealing thread_pool as it scales from one worker to one
+// per hardware thread.
+
+using namespace eventual;
+
+namespace
+{
+    constexpr int spawnDepth = 18;
+    constexpr std::size_t externalCount = 200000;
+
+    std::vector<std::size_t> WorkerCounts()
+    {
+        std::vector<std::size_t> counts;
+        for (std::size_t count = 1; count < benchmark::HardwareThreads(); count *= 2)
+            counts.push_back(count);
+
+        counts.push_back(benchmark::HardwareThreads());
+        return counts;
+    }
+
+    std::string Label(const char* what, std::size_t workers)
+    {
+        return std::string(what) + " (" + std::to_string(workers) + " workers)";
+    }
+
+    // each task spawns two children onto its worker's own deque, down to 'depth' 0.
+    struct SpawnTree
+    {
+        SpawnTree(thread_pool& pool, std::size_t tasks) : Pool(pool), Remaining(tasks) { }
+
+        void Spawn(int depth)
+        {
+            if (depth > 0)
+            {
+                Pool.execute([this, depth]() { Spawn(depth - 1); });
+                Pool.execute([this, depth]() { Spawn(depth - 1); });
+            }
+
+            if (Remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                Done.set_value();
+        }
+
+        thread_pool& Pool;
+        std::atomic<std::size_t> Remaining;
+        promise<void> Done;
+    };
+}
+
+BENCHMARK_CASE(ThreadPool, SpawnTree_Scaling)
+{
+    const std::size_t tasks = (std::size_t(1) << (spawnDepth + 1)) - 1;
+    double baseline = 0;
+
+    for (auto workers : WorkerCounts())
+    {
+        thread_pool pool(workers);
+        SpawnTree tree(pool, tasks);
+        auto done = tree.Done.get_future();
+
+        auto start = benchmark::clock::now();
+        pool.execute([&tree]() { tree.Spawn(spawnDepth); });
+        done.wait();
+        auto ns = benchmark::ElapsedNanoseconds(start, benchmark::clock::now());
+
+        auto throughput = tasks / (ns / 1e9);
+        if (baseline == 0)
+            baseline = throughput;
+
+        benchmark::Report(Label("fork/join spawn tree", workers).c_str(), throughput / 1e6, "M tasks/s");
+        benchmark::Report("  speedup over 1 worker", throughput / baseline, "x");
+    }
+}
+
+BENCHMARK_CASE(ThreadPool, ExternalSubmit_Scaling)
+{
+    for (auto workers : WorkerCounts())
+    {
+        thread_pool pool(workers);
+        std::atomic<std::size_t> remaining(externalCount);
+        promise<void> done;
+        auto finished = done.get_future();
+
+        auto start = benchmark::clock::now();
+        for (std::size_t i = 0; i < externalCount; ++i)
+        {
+            pool.execute([&remaining, &done]()
+            {
+                if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    done.set_value();
+            });
+        }
+
+        finished.wait();
+        auto ns = benchmark::ElapsedNanoseconds(start, benchmark::clock::now());
+
+        benchmark::Report(Label("submitted from one outside thread", workers).c_str(), ns / externalCount, "ns/task");
+    }
+}
+
+BENCHMARK_CASE(ThreadPool, ThenChain_Scaling)
+{
+    constexpr std::size_t chains = 64;
+    constexpr std::size_t links = 2000;
+
+    for (auto workers : WorkerCounts())
+    {
+        thread_pool pool(workers);
+        std::vector<promise<int>> heads(chains);
+        std::vector<future<int>> tails;
+
+        for (auto& head : heads)
+        {
+            auto future = head.get_future();
+            for (std::size_t i = 0; i < links; ++i)
+                future = future.then(pool, [](auto& f) { return f.get() + 1; });
+
+            tails.push_back(std::move(future));
+        }
+
+        auto start = benchmark::clock::now();
+        for (auto& head : heads)
+            head.set_value(0);
+
+        for (auto& tail : tails)
+            tail.wait();
+
+        auto ns = benchmark::ElapsedNanoseconds(start, benchmark::clock::now());
+
+        benchmark::Report(Label("then(pool, ...) continuation chains", workers).c_str(), ns / (chains * links), "ns/link");
+    }
+}
@@ -0,0 +1,95 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+// Bounces a value between two threads, each waiting on a future that the other completes,
+// and reports the distribution of round-trip latencies for each wait_strategy. A blocking
+// wait pays for a sleep and a wake-up on every hop; spinning trades a busy core for their
+// removal. The threads are pinned to different cores where there are several, so that the
+// round trip crosses cores; on a single hardware thread a spinning waiter holds the core the
+// other thread needs, and only the blocking and yielding strategies are meaningful.
+
+using namespace eventual;
+
+namespace
+{
+    const std::size_t RoundTrips = 20000;
+
+    void PinToCore(std::size_t core)
+    {
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(static_cast<int>(core % benchmark::HardwareThreads()), &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+        (void)core;
+#endif
+    }
+
+    double Percentile(const std::vector<double>& sorted, double fraction)
+    {
+        auto index = static_cast<std::size_t>(fraction * (sorted.size() - 1));
+        return sorted[index];
+    }
+
+    void RoundTrip(const char* name, const wait_strategy& strategy)
+    {
+        std::vector<promise<void>> pings(RoundTrips);
+        std::vector<promise<void>> pongs(RoundTrips);
+        std::vector<future<void>> pinged;
+        std::vector<future<void>> ponged;
+        std::vector<double> latencies(RoundTrips);
+
+        for (std::size_t i = 0; i < RoundTrips; ++i)
+        {
+            pinged.push_back(pings[i].get_future());
+            ponged.push_back(pongs[i].get_future());
+        }
+
+        benchmark::RunConcurrently(
+            [&]()
+            {
+                PinToCore(0);
+                for (std::size_t i = 0; i < RoundTrips; ++i)
+                {
+                    auto start = benchmark::clock::now();
+                    pings[i].set_value();
+                    ponged[i].wait(strategy);
+                    latencies[i] = benchmark::ElapsedNanoseconds(start, benchmark::clock::now());
+                }
+            },
+            [&]()
+            {
+                PinToCore(1);
+                for (std::size_t i = 0; i < RoundTrips; ++i)
+                {
+                    pinged[i].wait(strategy);
+                    pongs[i].set_value();
+                }
+            });
+
+        std::sort(latencies.begin(), latencies.end());
+
+        auto label = std::string(name);
+        benchmark::Report((label + ", p50").c_str(), Percentile(latencies, 0.5), "ns");
+        benchmark::Report((label + ", p99").c_str(), Percentile(latencies, 0.99), "ns");
+        benchmark::Report((label + ", p999").c_str(), Percentile(latencies, 0.999), "ns");
+    }
+}
+
+BENCHMARK_CASE(WaitStrategy, RoundTripLatency)
+{
+    std::printf("    %zu hardware threads\n", benchmark::HardwareThreads());
+
+    RoundTrip("block", wait_strategy::block());
+    RoundTrip("yield 50us", wait_strategy::yield(std::chrono::microseconds(50)));
+    RoundTrip("spin 50us", wait_strategy::spin(std::chrono::microseconds(50)));
+    RoundTrip("adaptive", wait_strategy::adaptive());
+}
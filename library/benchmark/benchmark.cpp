@@ -0,0 +1,26 @@
+// benchmark.cpp : Defines the entry point for the benchmark runner.
+//
+// usage: Benchmark [filter]
+//   runs every registered benchmark whose "Group.Name" contains 'filter'.
+
+#include "stdafx.h"
+#include <string>
+#include <thread>
+
+int main(int argCount, char* args[])
+{
+    std::string filter = argCount > 1 ? args[1] : "";
+
+    // libstdc++ skips the atomic updates of shared_ptr until a second thread has been started;
+    // start one so that single threaded cases measure what a (multi threaded) client pays.
+    std::thread([]() { }).join();
+
+    auto ran = benchmark::Registry::Instance().Run(filter);
+    if (ran == 0)
+    {
+        std::printf("no benchmarks match: \"%s\"\n", filter.c_str());
+        return 1;
+    }
+
+    return 0;
+}
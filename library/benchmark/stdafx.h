@@ -0,0 +1,10 @@
+// stdafx.h : include file for standard system include files,
+// or project specific include files that are used frequently, but
+// are changed infrequently
+//
+
+#pragma once
+
+#include "Benchmark.h"
+
+#include <eventual/eventual.h>
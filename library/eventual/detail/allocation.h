@@ -7,16 +7,57 @@
 #include <atomic>
 #include <cstddef>
 #include <new>
+#include <typeinfo>
+
+// Defined as 1, the library's memory_resource is std::pmr::memory_resource, so that a promise or
+// task may be given a std::pmr::polymorphic_allocator (or any std::pmr resource) to allocate from
+// directly; this requires C++17. It changes the type behind every allocator and State, so it must
+// be set the same way for every translation unit of a program (the EVENTUAL_STD_PMR option of the
+// eventual_lib target defines it for all of them). It is not inferred from the language standard.
+#ifndef EVENTUAL_STD_PMR
+    #define EVENTUAL_STD_PMR 0
+#endif
+
+#if EVENTUAL_STD_PMR
+    #if !((__cplusplus >= 201703L) || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L))
+        #error "EVENTUAL_STD_PMR requires C++17."
+    #endif
+#endif
+
+#if defined(_MSC_VER)
+    // with MSVC, translation units that disagree fail to link
+    #if EVENTUAL_STD_PMR
+        #pragma detect_mismatch("EVENTUAL_STD_PMR", "1")
+    #else
+        #pragma detect_mismatch("EVENTUAL_STD_PMR", "0")
+    #endif
+#endif
+
+#if EVENTUAL_STD_PMR
+    #include <memory_resource>
+#endif
 
 namespace eventual
 {
     namespace detail
     {
-        // a simplified implementation of a c++17 memory_resource
+        constexpr std::size_t CacheLineSize = 64;
+
+        // occupies (at least) a cache line of its own, when the enclosing object is line aligned.
+        template<class T>
+        struct CacheLinePadded
+        {
+            T Value;
+            char Padding[CacheLineSize - sizeof(T) % CacheLineSize];
+        };
 
-        class memory_resource;
+#if EVENTUAL_STD_PMR
 
-        using shared_resource = std::shared_ptr<memory_resource>;
+        using memory_resource = std::pmr::memory_resource;
+
+#else
+
+        // a simplified implementation of a c++17 memory_resource
 
         class memory_resource
         {
@@ -37,15 +78,27 @@ namespace eventual
                 do_deallocate(p, bytes, alignment);
             }
 
-            bool is_equal(const memory_resource& other) const
+            bool is_equal(const memory_resource& other) const noexcept
             {
                 return do_is_equal(other);
             }
 
+            // identifies the concrete type of a resource, so that do_is_equal can tell whether
+            // another resource is of its own type without RTTI; nullptr if it does not say.
+            const void* type_key() const noexcept
+            {
+                return do_type_key();
+            }
+
         protected:
             virtual void* do_allocate(size_t bytes, size_t alignment) = 0;
             virtual void do_deallocate(void* p, size_t bytes, size_t alignment) = 0;
-            virtual bool do_is_equal(const memory_resource& other) const = 0;
+            virtual bool do_is_equal(const memory_resource& other) const noexcept = 0;
+
+            virtual const void* do_type_key() const noexcept
+            {
+                return nullptr;
+            }
         };
 
         inline bool operator==(const memory_resource& a, const memory_resource& b)
@@ -58,6 +111,10 @@ namespace eventual
             return !(a == b);
         }
 
+#endif
+
+        using shared_resource = std::shared_ptr<memory_resource>;
+
         template<class Allocator>
         class resource_adapter_impl
             : public memory_resource
@@ -110,17 +167,57 @@ namespace eventual
                 }
             }
 
-            virtual bool do_is_equal(const memory_resource& other) const override
+            virtual bool do_is_equal(const memory_resource& other) const noexcept override
             {
-                const auto otherPtr = dynamic_cast<const resource_adapter_impl*>(std::addressof(other));
+                const auto otherPtr = AsAdapter(other);
                 if (!otherPtr)
                     return false;
 
                 return _allocator == otherPtr->_allocator;
             }
 
+#if !EVENTUAL_STD_PMR
+            virtual const void* do_type_key() const noexcept override
+            {
+                return TypeKey();
+            }
+#endif
+
         private:
 
+#if !EVENTUAL_STD_PMR
+            // one address per adapter type (and so per allocator type)
+            static const void* TypeKey() noexcept
+            {
+                static const char key = 0;
+                return &key;
+            }
+
+            static const resource_adapter_impl* AsAdapter(const memory_resource& other) noexcept
+            {
+                if (other.type_key() != TypeKey())
+                    return nullptr;
+
+                return static_cast<const resource_adapter_impl*>(std::addressof(other));
+            }
+#elif defined(__cpp_rtti) || defined(_CPPRTTI) || defined(__GXX_RTTI)
+            // the exact type: an adapter derived from this one (with a block) is not its equal.
+            static const resource_adapter_impl* AsAdapter(const memory_resource& other) noexcept
+            {
+                if (typeid(other) != typeid(resource_adapter_impl))
+                    return nullptr;
+
+                return static_cast<const resource_adapter_impl*>(std::addressof(other));
+            }
+#else
+            // std::pmr::memory_resource cannot say what it is without RTTI; an adapter is only
+            // known to be equal to itself.
+            const resource_adapter_impl* AsAdapter(const memory_resource& other) const noexcept
+            {
+                return std::addressof(other) == this ? this : nullptr;
+            }
+#endif
+
             template<size_t Alignment>
             void* do_allocate(size_t bytes)
             {
@@ -201,6 +298,88 @@ namespace eventual
         template<class Allocator>
         using resource_adapter = resource_adapter_impl<typename std::allocator_traits<Allocator>::template rebind_alloc<char>>;
 
+        // A resource_adapter that holds room for one block of up to Size bytes, allocated along
+        // with the adapter itself. A strong_polymorphic_allocator<T> built from a plain allocator
+        // creates one sized for a T, so that the state it is made for lives in the same
+        // allocation as the adapter. The block is handed out to the first request that fits it
+        // (and again once it has been deallocated); anything else goes to the allocator.
+        //
+        // The block makes the adapter sizeof(T) larger. Copies and rebinds of the allocator share
+        // the one adapter, so that is paid once per allocator built from a plain allocator (once
+        // per State, for a promise or packaged_task), not per copy. Since the block can only be
+        // returned to the adapter that holds it, an adapter with a block is only equal to itself.
+        template<class Allocator, std::size_t Size, std::size_t Alignment>
+        class resource_adapter_with_block_impl
+            : public resource_adapter_impl<Allocator>
+        {
+            using Base = resource_adapter_impl<Allocator>;
+            using size_t = std::size_t;
+
+        public:
+            typedef Allocator allocator_type;
+
+            resource_adapter_with_block_impl(const Allocator& allocator)
+                : Base(allocator), _inUse(false)
+            { }
+
+            static shared_resource create_shared(allocator_type allocator)
+            {
+                return std::allocate_shared<resource_adapter_with_block_impl>(allocator, allocator);
+            }
+
+        protected:
+
+            virtual void* do_allocate(size_t bytes, size_t alignment) override
+            {
+                if (bytes <= Size && alignment <= Alignment && !_inUse.exchange(true, std::memory_order_acquire))
+                    return &_block;
+
+                return Base::do_allocate(bytes, alignment);
+            }
+
+            virtual void do_deallocate(void* p, size_t bytes, size_t alignment) override
+            {
+                if (p == &_block)
+                {
+                    _inUse.store(false, std::memory_order_release);
+                    return;
+                }
+
+                Base::do_deallocate(p, bytes, alignment);
+            }
+
+            virtual bool do_is_equal(const memory_resource& other) const noexcept override
+            {
+                return this == std::addressof(other);
+            }
+
+#if !EVENTUAL_STD_PMR
+            // distinct from the plain adapter's, which would otherwise take this one for its equal.
+            virtual const void* do_type_key() const noexcept override
+            {
+                static const char key = 0;
+                return &key;
+            }
+#endif
+
+        private:
+            std::aligned_storage_t<Size, Alignment> _block;
+            std::atomic<bool> _inUse;
+        };
+
+        template<class Allocator, class T>
+        using resource_adapter_with_block = resource_adapter_with_block_impl<
+            typename std::allocator_traits<Allocator>::template rebind_alloc<char>, sizeof(T), alignof(T)>;
+
+#if EVENTUAL_STD_PMR
+
+        // the default is std::pmr's, shared with the rest of the program
+        using std::pmr::new_delete_resource;
+        using std::pmr::get_default_resource;
+        using std::pmr::set_default_resource;
+
+#else
+
         class default_resource_singleton
         {
         public:
@@ -211,13 +390,39 @@ namespace eventual
 
                 return &instance;
             }
+
+            static std::atomic<memory_resource*>& default_resource() noexcept
+            {
+                static std::atomic<memory_resource*> instance(new_delete_resource_singleton());
+
+                return instance;
+            }
         };
 
-        inline memory_resource* get_default_resource() noexcept
+        inline memory_resource* new_delete_resource() noexcept
         {
             return default_resource_singleton::new_delete_resource_singleton();
         }
 
+        inline memory_resource* get_default_resource() noexcept
+        {
+            return default_resource_singleton::default_resource().load(std::memory_order_acquire);
+        }
+
+        // Replaces the resource used by default-constructed allocators (and so by every promise,
+        // task and continuation not given an allocator), returning the previous one; nullptr
+        // restores new_delete_resource(). Since states hold the default resource without a
+        // reference count, a replaced resource must outlive everything allocated from it.
+        inline memory_resource* set_default_resource(memory_resource* resource) noexcept
+        {
+            if (!resource)
+                resource = new_delete_resource();
+
+            return default_resource_singleton::default_resource().exchange(resource, std::memory_order_acq_rel);
+        }
+
+#endif
+
         template<class T>
         class polymorphic_allocator
         {
@@ -257,6 +462,15 @@ namespace eventual
                 assert(_resource);
             }
 
+#if EVENTUAL_STD_PMR
+            template<class U>
+            polymorphic_allocator(const std::pmr::polymorphic_allocator<U>& other) noexcept
+                : _resource(other.resource())
+            {
+                assert(_resource);
+            }
+#endif
+
             polymorphic_allocator(const polymorphic_allocator& other) = default;
 
             polymorphic_allocator& operator=(const polymorphic_allocator& rhs) = default;
@@ -323,9 +537,21 @@ namespace eventual
                 typedef strong_polymorphic_allocator<U> other;
             };
 
-            template<class Alloc, class = std::enable_if_t<!std::is_convertible<Alloc, strong_polymorphic_allocator>::value>>
+            // allocators that refer to a memory_resource (and resource pointers) use it directly.
+            template<class Alloc, class = std::enable_if_t<
+                !std::is_convertible<Alloc, strong_polymorphic_allocator>::value &&
+                !std::is_convertible<Alloc, polymorphic_allocator<T>>::value>>
             strong_polymorphic_allocator(const Alloc& alloc)
-                : strong_polymorphic_allocator(resource_adapter<Alloc>::create_shared(alloc))
+                : strong_polymorphic_allocator(resource_adapter_with_block<Alloc, T>::create_shared(alloc))
+            {
+                assert(_resource);
+            }
+
+            // a polymorphic_allocator (std::pmr's too, or a memory_resource*) does not own its
+            // resource, so neither does this; the resource is used directly, without an adapter,
+            // and must outlive every copy of the allocator.
+            strong_polymorphic_allocator(const polymorphic_allocator<T>& other)
+                : strong_polymorphic_allocator(shared_resource(shared_resource(), other.resource()))
             {
                 assert(_resource);
             }
@@ -344,8 +570,18 @@ namespace eventual
                 assert(_resource);
             }
 
+            template<class U>
+            strong_polymorphic_allocator(strong_polymorphic_allocator<U>&& other) noexcept
+                : polymorphic_allocator<T>(other.resource()),
+                  _resource(std::move(other._resource))
+            {
+                assert(_resource);
+            }
+
             strong_polymorphic_allocator(const strong_polymorphic_allocator& other) = default;
+            strong_polymorphic_allocator(strong_polymorphic_allocator&& other) noexcept = default;
             strong_polymorphic_allocator& operator=(const strong_polymorphic_allocator& rhs) = default;
+            strong_polymorphic_allocator& operator=(strong_polymorphic_allocator&& rhs) noexcept = default;
 
             shared_resource share() const
             {
@@ -353,9 +589,33 @@ namespace eventual
             }
 
         private:
+
+            template<class>
+            friend class strong_polymorphic_allocator;
+
             shared_resource _resource;
         };
 
+        // The default resource must outlive every allocator (see set_default_resource); share it without
+        // a reference count (or an adapter).
+        template<class T>
+        strong_polymorphic_allocator<T> default_strong_allocator()
+        {
+            return strong_polymorphic_allocator<T>(shared_resource(shared_resource(), get_default_resource()));
+        }
+
+        // a memory_resource* given where an allocator is expected stands for a polymorphic_allocator.
+        template<class Alloc, class = std::enable_if_t<!std::is_convertible<Alloc, memory_resource*>::value>>
+        const Alloc& AsAllocator(const Alloc& alloc) noexcept
+        {
+            return alloc;
+        }
+
+        inline polymorphic_allocator<char> AsAllocator(memory_resource* resource) noexcept
+        {
+            return polymorphic_allocator<char>(resource);
+        }
+
         template<class T1, class T2>
         inline bool operator==(const polymorphic_allocator<T1>& a, const polymorphic_allocator<T2>& b)
         {
@@ -0,0 +1,178 @@
+#pragma once
+
+// The MIT License(MIT)
+// 
+// Copyright(c) 2016 Ryan Ferraro
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace eventual
+{
+    namespace detail
+    {
+        // The type-erased callable of a unique_function; it lives either in the function's
+        // inline storage, or (when it does not fit) in a block from the function's allocator.
+        template<class R, class... Args>
+        class FunctionTarget
+        {
+        public:
+
+            virtual R Invoke(Args&&... args) = 0;
+
+            // moves the target into 'storage', returning its new address; an allocated target
+            // only moves its pointer, and returns itself.
+            virtual FunctionTarget* MoveTo(void* storage) noexcept = 0;
+
+            // destroys the target, releasing its block if it was allocated.
+            virtual void Destroy() noexcept = 0;
+
+        protected:
+            ~FunctionTarget() { }
+        };
+
+        template<class R>
+        struct FunctionInvoker
+        {
+            template<class F, class... Args>
+            static R Invoke(F& function, Args&&... args)
+            {
+                return function(std::forward<Args>(args)...);
+            }
+        };
+
+        template<>
+        struct FunctionInvoker<void>
+        {
+            template<class F, class... Args>
+            static void Invoke(F& function, Args&&... args)
+            {
+                function(std::forward<Args>(args)...);
+            }
+        };
+
+        template<class F, class R, class... Args>
+        class InlineFunctionTarget final : public FunctionTarget<R, Args...>
+        {
+            using Base = FunctionTarget<R, Args...>;
+
+        public:
+
+            template<class TFunction>
+            explicit InlineFunctionTarget(TFunction&& function)
+                : _function(std::forward<TFunction>(function))
+            { }
+
+            virtual R Invoke(Args&&... args) override
+            {
+                return FunctionInvoker<R>::Invoke(_function, std::forward<Args>(args)...);
+            }
+
+            virtual Base* MoveTo(void* storage) noexcept override
+            {
+                auto target = new(storage) InlineFunctionTarget(std::move(_function));
+                this->~InlineFunctionTarget();
+                return target;
+            }
+
+            virtual void Destroy() noexcept override
+            {
+                this->~InlineFunctionTarget();
+            }
+
+        private:
+            F _function;
+        };
+
+        template<class F, class Alloc, class R, class... Args>
+        class AllocatedFunctionTarget final : public FunctionTarget<R, Args...>
+        {
+            using Base = FunctionTarget<R, Args...>;
+            using allocator_t = typename std::allocator_traits<Alloc>::template rebind_alloc<AllocatedFunctionTarget>;
+            using traits = std::allocator_traits<allocator_t>;
+
+        public:
+
+            template<class TFunction>
+            AllocatedFunctionTarget(TFunction&& function, const allocator_t& allocator)
+                : _function(std::forward<TFunction>(function)),
+                  _allocator(allocator)
+            { }
+
+            template<class TFunction>
+            static Base* Create(TFunction&& function, const Alloc& alloc)
+            {
+                auto allocator = allocator_t(alloc);
+                auto ptr = traits::allocate(allocator, 1);
+
+                try
+                {
+                    traits::construct(allocator, ptr, std::forward<TFunction>(function), allocator);
+                }
+                catch (...)
+                {
+                    traits::deallocate(allocator, ptr, 1);
+                    throw;
+                }
+
+                return ptr;
+            }
+
+            virtual R Invoke(Args&&... args) override
+            {
+                return FunctionInvoker<R>::Invoke(_function, std::forward<Args>(args)...);
+            }
+
+            virtual Base* MoveTo(void*) noexcept override
+            {
+                return this;
+            }
+
+            virtual void Destroy() noexcept override
+            {
+                auto allocator = _allocator;
+
+                traits::destroy(allocator, this);
+                traits::deallocate(allocator, this, 1);
+            }
+
+        private:
+            F _function;
+            allocator_t _allocator;
+        };
+
+        template<class F, class TStorage, class R, class... Args>
+        struct fits_function_storage : std::integral_constant<bool,
+            sizeof(InlineFunctionTarget<F, R, Args...>) <= sizeof(TStorage) &&
+            alignof(InlineFunctionTarget<F, R, Args...>) <= alignof(TStorage) &&
+            std::is_nothrow_move_constructible<F>::value>
+        { };
+
+        template<class F>
+        bool IsNullFunction(const F&) noexcept { return false; }
+
+        template<class R, class... Args>
+        bool IsNullFunction(R(*function)(Args...)) noexcept { return function == nullptr; }
+    }
+}
@@ -0,0 +1,236 @@
+#pragma once
+
+// The MIT License(MIT)
+// 
+// Copyright(c) 2016 Ryan Ferraro
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#if defined(__linux__)
+    #include <sys/mman.h>
+#endif
+
+#include "allocation.h"
+
+namespace eventual
+{
+    namespace detail
+    {
+        constexpr std::size_t HugePageSize = 2 * 1024 * 1024;
+
+        struct HugePageRegion
+        {
+            void* Address;
+            std::size_t Size;
+            bool Huge;
+        };
+
+        inline std::size_t RoundUpToHugePages(std::size_t bytes)
+        {
+            return (bytes + HugePageSize - 1) / HugePageSize * HugePageSize;
+        }
+
+#if defined(__linux__)
+
+        // maps 'size' bytes (a multiple of HugePageSize) of anonymous memory: from the reserved huge
+        // pages (MAP_HUGETLB) if allowed and available, or else huge page aligned and advised for
+        // transparent huge pages (MADV_HUGEPAGE).
+        inline HugePageRegion MapHugePages(std::size_t size, bool allowHugeTlb)
+        {
+            assert(size % HugePageSize == 0);
+
+            const auto protection = PROT_READ | PROT_WRITE;
+            const auto flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+#if defined(MAP_HUGETLB)
+            if (allowHugeTlb)
+            {
+                auto p = ::mmap(nullptr, size, protection, flags | MAP_HUGETLB, -1, 0);
+                if (p != MAP_FAILED)
+                    return { p, size, true };
+            }
+#else
+            (void)allowHugeTlb;
+#endif
+
+            // over-map, then trim to a huge page boundary
+            const auto mappedSize = size + HugePageSize;
+            auto mapped = ::mmap(nullptr, mappedSize, protection, flags, -1, 0);
+            if (mapped == MAP_FAILED)
+                throw std::bad_alloc();
+
+            const auto begin = reinterpret_cast<std::uintptr_t>(mapped);
+            const auto aligned = (begin + HugePageSize - 1) & ~std::uintptr_t(HugePageSize - 1);
+            const auto end = begin + mappedSize;
+
+            if (aligned != begin)
+                ::munmap(mapped, aligned - begin);
+
+            if (end != aligned + size)
+                ::munmap(reinterpret_cast<void*>(aligned + size), end - (aligned + size));
+
+            auto huge = false;
+#if defined(MADV_HUGEPAGE)
+            huge = ::madvise(reinterpret_cast<void*>(aligned), size, MADV_HUGEPAGE) == 0;
+#endif
+
+            return { reinterpret_cast<void*>(aligned), size, huge };
+        }
+
+        inline void UnmapHugePages(const HugePageRegion& region) noexcept
+        {
+            ::munmap(region.Address, region.Size);
+        }
+
+#else
+
+        // without a way to ask for huge pages, a region is still one contiguous allocation.
+        inline HugePageRegion MapHugePages(std::size_t size, bool)
+        {
+            return { ::operator new(size), size, false };
+        }
+
+        inline void UnmapHugePages(const HugePageRegion& region) noexcept
+        {
+            ::operator delete(region.Address);
+        }
+
+#endif
+
+        // Hands out memory from large regions mapped on huge pages, a bump of a pointer at a
+        // time; nothing is returned before the arena is released. Meant as the upstream of a
+        // SizeClassPools, which recycles the blocks that it carves from each chunk.
+        class HugePageArena
+            : public memory_resource
+        {
+            using size_t = std::size_t;
+
+        public:
+
+            HugePageArena(size_t regionSize, bool allowHugeTlb)
+                : _regionSize(RoundUpToHugePages(std::max<size_t>(regionSize, 1))),
+                  _allowHugeTlb(allowHugeTlb),
+                  _next(nullptr),
+                  _end(nullptr)
+            { }
+
+            HugePageArena(const HugePageArena&) = delete;
+            HugePageArena& operator=(const HugePageArena&) = delete;
+
+            ~HugePageArena()
+            {
+                Release();
+            }
+
+            void Release() noexcept
+            {
+                for (const auto& region : _regions)
+                    UnmapHugePages(region);
+
+                _regions.clear();
+                _next = _end = nullptr;
+            }
+
+            size_t RegionSize() const { return _regionSize; }
+            bool UsesHugeTlb() const { return _allowHugeTlb; }
+
+            size_t MappedBytes() const
+            {
+                size_t bytes = 0;
+                for (const auto& region : _regions)
+                    bytes += region.Size;
+
+                return bytes;
+            }
+
+            // true if every region mapped so far is on (or advised for) huge pages.
+            bool OnHugePages() const
+            {
+                return std::all_of(_regions.begin(), _regions.end(), [](const HugePageRegion& region) { return region.Huge; });
+            }
+
+        protected:
+
+            virtual void* do_allocate(size_t bytes, size_t alignment) override
+            {
+                if (auto p = Bump(bytes, alignment))
+                    return p;
+
+                AddRegion(bytes + alignment);
+
+                auto p = Bump(bytes, alignment);
+                assert(p);
+
+                return p;
+            }
+
+            virtual void do_deallocate(void*, size_t, size_t) override
+            {
+                // memory is only returned by Release()
+            }
+
+            virtual bool do_is_equal(const memory_resource& other) const noexcept override
+            {
+                return this == std::addressof(other);
+            }
+
+        private:
+
+            void* Bump(size_t bytes, size_t alignment) noexcept
+            {
+                if (!_next)
+                    return nullptr;
+
+                const auto next = reinterpret_cast<std::uintptr_t>(_next);
+                const auto aligned = (next + alignment - 1) & ~std::uintptr_t(alignment - 1);
+
+                if (aligned + bytes > reinterpret_cast<std::uintptr_t>(_end))
+                    return nullptr;
+
+                _next = reinterpret_cast<char*>(aligned + bytes);
+                return reinterpret_cast<void*>(aligned);
+            }
+
+            void AddRegion(size_t minimumSize)
+            {
+                _regions.reserve(_regions.size() + 1);
+
+                auto region = MapHugePages(std::max(_regionSize, RoundUpToHugePages(minimumSize)), _allowHugeTlb);
+                _regions.push_back(region);
+
+                _next = static_cast<char*>(region.Address);
+                _end = _next + region.Size;
+            }
+
+            size_t _regionSize;
+            bool _allowHugeTlb;
+            std::vector<HugePageRegion> _regions;
+            char* _next;
+            char* _end;
+        };
+    }
+}
@@ -35,12 +35,16 @@
 #include <cassert>
 #include <memory>
 #include <cstddef>
-
-#include <list>
+#include <cstdint>
+#include <atomic>
+#include <condition_variable>
+#include <algorithm>
 
 #include "traits.h"
 #include "utility.h"
 #include "allocation.h"
+#include "parking_lot.h"
+#include "wait_strategy.h"
 
 namespace eventual
 {
@@ -52,14 +56,10 @@ namespace eventual
 
     namespace detail
     {
-        template<class Future, class... Futures>
-        static decltype(auto) When_All_(Future&& head, Futures&&... others);
-
-        static future<std::tuple<>> When_All_();
-
         template <class R> class CommonPromise;
         template <class R> class BasicPromise;
         template <class R> class BasicFuture;
+        template <class R> class UniqueFuture;
 
         // Aliases
 
@@ -77,183 +77,254 @@ namespace eventual
         using any_future_result_vector = future<when_any_result<std::vector<typename std::iterator_traits<InputIterator>::value_type>>>;
 
         template<class... Futures>
-        using any_futures_result_tuple = future<when_any_result<std::tuple<std::decay_t<Futures>...>>>;
+        using any_futures_result_tuple = std::enable_if_t<are_futures<Futures...>::value,
+            future<when_any_result<std::tuple<std::decay_t<Futures>...>>>>;
 
         class FutureFactory
         {
         public:
             template<class TResult>
             static future<TResult> Create(const CommonPromise<TResult>& promise);
+
+            template<class TResult, class TState>
+            static future<TResult> Create(StatePtr<TState>&& state);
+
+            template<class TResult, class TValue>
+            static future<TResult> CreateReady(TValue&& value);
+
+            template<class TResult>
+            static future<TResult> CreateExceptional(std::exception_ptr ex);
         };
 
         class FutureHelper
         {
         public:
 
+            // for a caller that keeps the future (e.g. a join state, which may hand it back): the
+            // callback claims the State's inline slot, as any later one will see.
             template<class TResult, class T>
             static void SetCallback(BasicFuture<TResult>& future, T&& callback);
 
             template<class TResult, class T>
-            static bool TrySetValue(BasicPromise<TResult>& promise, const T& value);
+            static void SetCallback(UniqueFuture<TResult>& future, T&& callback);
+
+            // for a caller that consumes the future into the callback: a future (unlike a
+            // shared_future) is the only handle on its State, so no callback can follow this one
+            // (see State::SetSoleCallback); the pointer only selects the overload.
+            template<class TState, class T, class TResult>
+            static void SetCallback(TState& state, T&& callback, const BasicFuture<TResult>*);
+
+            template<class TState, class T, class TResult>
+            static void SetCallback(TState& state, T&& callback, const UniqueFuture<TResult>*);
+
+            template<class TResult>
+            static bool HasException(const BasicFuture<TResult>& future);
+
+            template<class TResult>
+            static bool HasException(const UniqueFuture<TResult>& future);
+
+            template<class TResult>
+            static std::exception_ptr GetException(const BasicFuture<TResult>& future);
 
             template<class TResult>
-            static decltype(auto) GetState(BasicFuture<TResult>& future);
+            static std::exception_ptr GetException(const UniqueFuture<TResult>& future);
 
             template<class TResult>
             static decltype(auto) GetResult(BasicFuture<TResult>& future);
-        };
 
-        template<class T>
-        struct PlacementDestructor
-        {
-            void operator()(T* item) const
-            {
-                item->~T();
-                (void)item; // suppresses C4100 in VS2015
-            }
-        };
+            template<class TResult>
+            static decltype(auto) GetResult(UniqueFuture<TResult>& future);
 
-        class SimpleDelegate
-        {
-            class Delegate
-            {
-            public:
-                virtual ~Delegate() { }
-                virtual void operator()() = 0;
-            };
+            // the future, with any ready result moved to a State so that it can be shared.
+            template<class TResult>
+            static UniqueFuture<TResult>&& Promote(UniqueFuture<TResult>&& future);
 
-            template<class T>
-            class SmallDelegate : public Delegate
-            {
-            public:
+            // completes 'target' with the result of 'future' once it is ready, from a callback
+            // registered on the future's own State; no continuation task or State is created.
+            template<class TResult, class TState>
+            static void Forward(BasicFuture<TResult>&& future, StatePtr<TState>&& target);
 
-                SmallDelegate(T&& callable)
-                    : _callable(std::forward<T>(callable))
-                { }
+            template<class TResult, class TState>
+            static void Forward(UniqueFuture<TResult>&& future, StatePtr<TState>&& target);
 
-                virtual void operator()() override
-                {
-                    _callable();
-                }
+        private:
 
-            private:
-                T _callable;
-            };
+            template<class TFuture, class TState>
+            static void ForwardFromState(TFuture&& future, StatePtr<TState>&& target);
 
-            template<class T>
-            class LargeDelegate : public Delegate
-            {
-            public:
+            template<class TState, class TFuture>
+            static void SetResultFromFuture(TState& state, TFuture& future);
+        };
 
-                LargeDelegate(T&& callable, polymorphic_allocator<T>&& allocator)
-                    : _callable(Create(std::forward<T>(callable), allocator))
-                { }
+        // An intrusive, type-erased callback. Pending continuations are linked
+        // together into a lock-free stack owned by the State they are waiting on.
+        class alignas(8) Continuation
+        {
+        public:
 
-                virtual void operator()() override
-                {
-                    (*_callable)();
-                }
+            // invokes the callback, then releases the continuation.
+            virtual void Invoke() = 0;
 
-            private:
+            // releases the continuation without invoking the callback.
+            virtual void Discard() noexcept = 0;
 
-                struct Deleter
-                {
-                    Deleter(const polymorphic_allocator<T>& resource)
-                        : _resource(resource)
-                    {
-                    }
+            Continuation* Next = nullptr;
 
-                    void operator()(T* functor)
-                    {
-                        using traits = std::allocator_traits<polymorphic_allocator<T>>;
+        protected:
+            ~Continuation() { }
+        };
 
-                        traits::destroy(_resource, functor);
-                        traits::deallocate(_resource, functor, 1);
-                    }
+        template<class T>
+        class AllocatedContinuation final : public Continuation
+        {
+            using allocator_t = polymorphic_allocator<AllocatedContinuation>;
+            using traits = std::allocator_traits<allocator_t>;
 
-                    polymorphic_allocator<T> _resource;
-                };
+        public:
+
+            AllocatedContinuation(T&& callable, const allocator_t& allocator)
+                : _callable(std::forward<T>(callable)),
+                  _allocator(allocator)
+            { }
+
+            template<class Alloc>
+            static Continuation* Create(T&& callable, const Alloc& alloc)
+            {
+                auto allocator = allocator_t(alloc);
+                auto ptr = traits::allocate(allocator, 1);
 
-                std::unique_ptr<T, Deleter> Create(T&& callable, polymorphic_allocator<T>& resource)
+                try
+                {
+                    traits::construct(allocator, ptr, std::forward<T>(callable), allocator);
+                }
+                catch (...)
                 {
-                    using traits = std::allocator_traits<polymorphic_allocator<T>>;
+                    traits::deallocate(allocator, ptr, 1);
+                    throw;
+                }
 
-                    auto ptr = traits::allocate(resource, 1);
-                    traits::construct(resource, ptr, std::forward<T>(callable));
+                return ptr;
+            }
 
-                    return std::unique_ptr<T, Deleter>(ptr, Deleter(resource));
+            virtual void Invoke() override
+            {
+                try
+                {
+                    _callable();
+                }
+                catch (...)
+                {
+                    Discard();
+                    throw;
                 }
 
-                std::unique_ptr<T, Deleter> _callable;
-            };
+                Discard();
+            }
 
-            // dummy type
-            struct Callable
+            virtual void Discard() noexcept override
             {
-                void operator()() { }
-            };
-            
-            //todo: fine-tune this size
-            using storage_t = std::aligned_union_t<32, SmallDelegate<Callable>, LargeDelegate<Callable>>;
+                auto allocator = _allocator;
+
+                traits::destroy(allocator, this);
+                traits::deallocate(allocator, this, 1);
+            }
 
-            using delegate_pointer_t = std::unique_ptr<Delegate, PlacementDestructor<Delegate>>;
+        private:
+            T _callable;
+            allocator_t _allocator;
+        };
 
+        // A continuation constructed in-place within the storage reserved by a State,
+        // so that the first continuation of every State costs no allocation.
+        template<class T>
+        class InlineContinuation final : public Continuation
+        {
         public:
 
-            template<class T, class = typename enable_if_not_same<SimpleDelegate, T>::type>
-            SimpleDelegate(T&& functor, const polymorphic_allocator<SimpleDelegate>& alloc)
-                : _data(),
-                  _object(Create(std::forward<T>(functor), alloc))
+            InlineContinuation(T&& callable)
+                : _callable(std::forward<T>(callable))
             { }
 
-            // only contructable in-place. No move/copy.
-            SimpleDelegate(SimpleDelegate&&) = delete;
-            SimpleDelegate& operator=(const SimpleDelegate&) = delete;
-            SimpleDelegate(const SimpleDelegate&) = delete;
-            SimpleDelegate& operator=(SimpleDelegate&&) = default;
-
-            void operator()() const
+            virtual void Invoke() override
             {
-                // this internal object should never be null
-                assert(_object);
+                try
+                {
+                    _callable();
+                }
+                catch (...)
+                {
+                    Discard();
+                    throw;
+                }
 
-                _object->operator()();
+                Discard();
+            }
+
+            virtual void Discard() noexcept override
+            {
+                this->~InlineContinuation();
             }
 
         private:
+            T _callable;
+        };
 
-            template<class T>
-            enable_if_size_is_less_than_or_eq_t<SmallDelegate<T>, storage_t, delegate_pointer_t>
-            Create(T&& functor, const polymorphic_allocator<SimpleDelegate>)
-            {
-                static_assert(sizeof(SmallDelegate<T>) <= sizeof(storage_t), "Delegate does not fit in storage buffer.");
+        // room for a continuation task, its future and a few words of captured state
+        using inline_continuation_storage_t = std::aligned_storage_t<10 * sizeof(void*), alignof(Continuation)>;
 
-                return delegate_pointer_t(new(&_data) SmallDelegate<T>(std::forward<T>(functor)));
-            }
+        template<class T>
+        using fits_inline_continuation = std::integral_constant<bool,
+            sizeof(InlineContinuation<T>) <= sizeof(inline_continuation_storage_t) &&
+            alignof(InlineContinuation<T>) <= alignof(inline_continuation_storage_t)>;
+
+        // The lifecycle of a State is packed into a single atomic word. The low bits
+        // carry the flags below; the remaining bits point to the most recently
+        // registered continuation (if any).
+        enum StatusFlags : std::uintptr_t
+        {
+            StatusEmpty = 0,
+            StatusReady = 1,
+            StatusExceptional = 2,
+            StatusWaiting = 4,
+            StatusFlagMask = StatusReady | StatusExceptional | StatusWaiting
+        };
 
-            template<class T>
-            enable_if_size_is_greater_than_t<SmallDelegate<T>, storage_t, delegate_pointer_t>
-            Create(T&& functor, const polymorphic_allocator<SimpleDelegate>& alloc)
-            {
-                static_assert(sizeof(SmallDelegate<T>) > sizeof(storage_t), "Incorrect delegate choosen.");
-                static_assert(sizeof(LargeDelegate<T>) <= sizeof(storage_t), "Pointer delegate does not fit in storage buffer.");
+        static_assert(alignof(Continuation) > StatusFlagMask, "Continuations must leave room for the status flags.");
 
-                return delegate_pointer_t(new(&_data) LargeDelegate<T>(std::forward<T>(functor), polymorphic_allocator<T>(alloc)));
-            }
-            
-            storage_t _data;
-            delegate_pointer_t _object;
+        // The rest of a State's bookkeeping, which only its producer and consumer touch (the
+        // status word is shared with every waiter and continuation), is packed into a second
+        // word. FlagHasResult is claimed before the result is stored, unless the producer is the
+        // only one that can store it (see StoreResult); FlagException is set once an exception
+        // has been. The member of the ResultBlock that is alive is the one StatusReady and
+        // StatusExceptional point to: a State is only made ready after its result is stored.
+        enum StateFlags : std::uint32_t
+        {
+            FlagRetrieved = 1,
+            FlagHasResult = 2,
+            FlagInlineClaimed = 4,
+            FlagException = 8
         };
 
+        inline Continuation* GetContinuations(std::uintptr_t status)
+        {
+            return reinterpret_cast<Continuation*>(status & ~std::uintptr_t(StatusFlagMask));
+        }
+
+        inline std::uintptr_t PackStatus(Continuation* head, std::uintptr_t flags)
+        {
+            return reinterpret_cast<std::uintptr_t>(head) | flags;
+        }
+
+        // The outcome of a State: a value or an exception, which share storage. The State
+        // records which of them (if either) is alive in its flags, and destroys it.
         template<typename T>
         class ResultBlock
         {
-            using storage_t = std::aligned_storage_t<sizeof(T), alignof(T)>;
-            using result_pointer_t = std::unique_ptr<T, PlacementDestructor<T>>;
+            using storage_t = std::aligned_union_t<1, T, std::exception_ptr>;
 
         public:
 
-            ResultBlock() { }
+            ResultBlock() noexcept { }
 
             ResultBlock(ResultBlock&&) = delete;
             ResultBlock(const ResultBlock&) = delete;
@@ -261,443 +332,1615 @@ namespace eventual
             ResultBlock& operator=(const ResultBlock&) = delete;
 
             template<typename R>
-            void Set(R&& result)
+            void SetValue(R&& result)
             {
-                assert(!_result);
-
-                // placement new
-                _result.reset(new(&_data) T(std::forward<R>(result)));
+                new(&_storage) T(std::forward<R>(result));
             }
 
-            T get()
+            void SetException(std::exception_ptr ex) noexcept
             {
-                assert(_result);
-
-                return std::move(*_result);
+                new(&_storage) std::exception_ptr(std::move(ex));
             }
 
-            const T& get() const
-            {
-                assert(_result != nullptr);
+            T& Value() noexcept { return *reinterpret_cast<T*>(&_storage); }
+            const T& Value() const noexcept { return *reinterpret_cast<const T*>(&_storage); }
 
-                return *_result;
+            const std::exception_ptr& Exception() const noexcept
+            {
+                return *reinterpret_cast<const std::exception_ptr*>(&_storage);
             }
 
+            void DestroyValue() noexcept { Value().~T(); }
+            void DestroyException() noexcept { reinterpret_cast<std::exception_ptr*>(&_storage)->~exception_ptr(); }
+
         private:
-            storage_t _data;
-            result_pointer_t _result;
+            storage_t _storage;
         };
 
-        struct StateTag { explicit StateTag(int) { } };
-
+        // The result of a future that was already known when the future was created (e.g. by
+        // make_ready_future); it is held by the future itself, so no State is allocated for it.
         template<typename T>
-        class State
+        class ReadyResult
         {
+            using storage_t = std::aligned_union_t<1, T, std::exception_ptr>;
 
-        private:
-
-            using unique_lock = std::unique_lock<std::mutex>;
-            using strong_reference = std::shared_ptr<State>;
-            using weak_reference = std::weak_ptr<State>;
-            using allocator_t = strong_polymorphic_allocator<State>;
-            using delegate_allocator_t = strong_polymorphic_allocator<SimpleDelegate>;
-            using callbacks_t = std::list<SimpleDelegate, delegate_allocator_t>;
+            enum class Kind : unsigned char { None, Value, Exception };
 
         public:
 
-            template<class Alloc>
-            State(const StateTag&, const Alloc& alloc) :
-                _retrieved(false),
-                _hasResult(false),
-                _result(),
-                _exception(nullptr),
-                _self(),
-                _ready(0),
-                _mutex(),
-                _condition(),
-                _allocator(allocator_t(alloc)),
-                _callbacks(delegate_allocator_t(_allocator))
-            { }
-            
-            static std::shared_ptr<State> MakeState()
-            {
-                return AllocState(std::allocator<State>());
-            }
+            ReadyResult() noexcept : _kind(Kind::None) { }
 
-            template<class Alloc, class = typename enable_if_not_same<State, Alloc>::type>
-            static std::shared_ptr<State> AllocState(const Alloc& alloc)
+            ReadyResult(ReadyResult&& other) noexcept : _kind(Kind::None)
             {
-                auto state = std::allocate_shared<State>(alloc, StateTag(0), alloc);
+                MoveFrom(other);
+            }
 
-                state->SetNotifier(state);
+            ReadyResult(const ReadyResult&) = delete;
 
-                return state;
+            ~ReadyResult()
+            {
+                Reset();
             }
 
-            State(State&&) = delete;
-            State(const State&) = delete;
-            State& operator=(State&&) = delete;
-            State& operator=(const State&) = delete;
-
-            const allocator_t& Get_Allocator() const
+            ReadyResult& operator=(ReadyResult&& other) noexcept
             {
-                return _allocator;
+                if (this != &other)
+                {
+                    Reset();
+                    MoveFrom(other);
+                }
+                return *this;
             }
 
-            bool Is_Ready() const { return _ready != 0; }
+            ReadyResult& operator=(const ReadyResult&) = delete;
 
-            void Wait() const
+            bool HasResult() const noexcept { return _kind != Kind::None; }
+            bool HasException() const noexcept { return _kind == Kind::Exception; }
+
+            template<class TValue>
+            void SetValue(TValue&& value)
             {
-                auto lock = AquireLock();
-                Wait(lock);
+                assert(!HasResult());
+
+                new(&_storage) T(std::forward<TValue>(value));
+                _kind = Kind::Value;
             }
 
-            template <class TDuration>
-            bool Wait_For(const TDuration& rel_time)
+            void SetException(std::exception_ptr ex) noexcept
             {
-                auto lock = AquireLock();
-                return _condition.wait_for(lock, rel_time, [this]() { return Is_Ready(); });
+                assert(!HasResult());
+
+                new(&_storage) std::exception_ptr(std::move(ex));
+                _kind = Kind::Exception;
             }
 
-            template <class TTime>
-            bool Wait_Until(const TTime& abs_time)
+            std::exception_ptr GetException() const noexcept
             {
-                auto lock = AquireLock();
-                return _condition.wait_until(lock, abs_time, [this]() { return Is_Ready(); });
+                return HasException() ? *reinterpret_cast<const std::exception_ptr*>(&_storage) : nullptr;
             }
 
-            template<class TCallback>
-            void SetCallback(TCallback&& callback)
+            // moves the result out (or rethrows the exception), leaving this empty.
+            T Take()
             {
-                {
-                    auto lock = AquireLock();
+                assert(HasResult());
 
-                    if (!Is_Ready())
-                    {
-                        _callbacks.emplace_back(std::forward<TCallback>(callback), _callbacks.get_allocator());
-                        return;
-                    }
+                if (HasException())
+                {
+                    auto ex = GetException();
+                    Reset();
+                    std::rethrow_exception(ex);
                 }
 
-                //promise is ready, invoke immediately
-                callback();
+                auto& value = *reinterpret_cast<T*>(&_storage);
+                auto result = T(std::move(value));
+                Reset();
+                return result;
             }
 
-            void NotifyCompletion()
+            void Reset() noexcept
             {
-                {
-                    auto lock = AquireLock();
-                    _ready = true;
-                    _condition.notify_all();
-                }
+                if (_kind == Kind::Value)
+                    reinterpret_cast<T*>(&_storage)->~T();
+                else if (_kind == Kind::Exception)
+                    reinterpret_cast<std::exception_ptr*>(&_storage)->~exception_ptr();
 
-                InvokeContinuations();
+                _kind = Kind::None;
             }
 
-            bool HasException() { return _exception ? true : false; }
-            std::exception_ptr GetException() { return _exception; }
-            bool HasResult() { return _hasResult; }
+            // completes 'state' with the result, leaving this empty.
+            template<class TState>
+            void MoveTo(TState& state)
+            {
+                assert(HasResult());
 
-            // future retrieved
-            bool SetRetrieved()
+                if (HasException())
+                    state.SetException(GetException());
+                else
+                    state.SetResult(std::move(*reinterpret_cast<T*>(&_storage)));
+
+                Reset();
+            }
+
+        private:
+
+            void MoveFrom(ReadyResult& other) noexcept
             {
-                auto lock = AquireLock();
-                if (_retrieved)
-                    return false;
+                if (other._kind == Kind::Value)
+                    SetValue(std::move(*reinterpret_cast<T*>(&other._storage)));
+                else if (other._kind == Kind::Exception)
+                    SetException(other.GetException());
 
-                _retrieved = true;
-                return _retrieved;
+                other.Reset();
             }
 
-            bool SetException(std::exception_ptr ex)
+            storage_t _storage;
+            Kind _kind;
+        };
+
+        struct StateTag { explicit StateTag(int) { } };
+
+        struct AdoptReference { explicit AdoptReference(int) { } };
+
+        // The reference count shared by every kind of State; the last reference
+        // destroys (and deallocates) the most derived State.
+        class StateBase
+        {
+        public:
+
+            StateBase() : _references(1) { }
+
+            StateBase(StateBase&&) = delete;
+            StateBase(const StateBase&) = delete;
+            StateBase& operator=(StateBase&&) = delete;
+            StateBase& operator=(const StateBase&) = delete;
+
+            void AddRef() noexcept
             {
-                if (!SetExceptionImpl(ex))
-                    return false;
+                _references.fetch_add(1, std::memory_order_relaxed);
+            }
 
-                NotifyPromiseFullfilled();
-                return true;
+            void Release() noexcept
+            {
+                if (_references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    Destroy();
             }
 
-            bool SetExceptionAtThreadExit(std::exception_ptr ex)
+            // true if the caller holds the only reference; no other can then be taken, and
+            // whatever the former holders did with the State happens before this returns.
+            bool IsUnique() const noexcept
             {
-                if (!SetExceptionImpl(ex))
-                    return false;
+                return _references.load(std::memory_order_acquire) == 1;
+            }
 
-                NotifyPromiseFullfilledAtThreadExit();
-                return true;
+        protected:
+
+            ~StateBase() { }
+
+            virtual void Destroy() noexcept = 0;
+
+        private:
+            std::atomic<std::uint32_t> _references;
+        };
+
+        // An intrusive, single pointer handle to a (reference counted) State.
+        template<class TState>
+        class StatePtr
+        {
+            template<class>
+            friend class StatePtr;
+
+            template<class U>
+            using enable_if_convertible_t = std::enable_if_t<std::is_convertible<U*, TState*>::value>;
+
+        public:
+
+            StatePtr() noexcept : _state(nullptr) { }
+            StatePtr(std::nullptr_t) noexcept : _state(nullptr) { }
+
+            explicit StatePtr(TState* state) noexcept
+                : _state(state)
+            {
+                if (_state)
+                    _state->AddRef();
             }
 
-            T GetResult()
+            StatePtr(TState* state, const AdoptReference&) noexcept
+                : _state(state)
+            { }
+
+            StatePtr(const StatePtr& other) noexcept
+                : StatePtr(other._state)
+            { }
+
+            StatePtr(StatePtr&& other) noexcept
+                : _state(other._state)
             {
-                auto lock = AquireLock();
+                other._state = nullptr;
+            }
 
-                Wait(lock);
-                CheckException();
-                return _result.get();
+            template<class U, class = enable_if_convertible_t<U>>
+            StatePtr(const StatePtr<U>& other) noexcept
+                : StatePtr(static_cast<TState*>(other._state))
+            { }
+
+            template<class U, class = enable_if_convertible_t<U>>
+            StatePtr(StatePtr<U>&& other) noexcept
+                : _state(other._state)
+            {
+                other._state = nullptr;
             }
 
-            const T& GetResult() const
+            ~StatePtr()
             {
-                auto lock = AquireLock();
+                if (_state)
+                    _state->Release();
+            }
 
-                Wait(lock);
-                CheckException();
-                return _result.get();
+            StatePtr& operator=(const StatePtr& rhs) noexcept
+            {
+                StatePtr(rhs).swap(*this);
+                return *this;
             }
 
-            template<class TValue>
-            bool SetResult(TValue&& value)
+            StatePtr& operator=(StatePtr&& rhs) noexcept
             {
-                {
-                    auto lock = AquireLock();
-                    
-                    if (!SetHasResult())
-                        return false;
+                StatePtr(std::move(rhs)).swap(*this);
+                return *this;
+            }
 
-                    _result.Set(std::forward<TValue>(value));
-                }
+            void swap(StatePtr& other) noexcept
+            {
+                std::swap(_state, other._state);
+            }
 
-                NotifyPromiseFullfilled();
-                return true;
+            void reset() noexcept
+            {
+                StatePtr().swap(*this);
             }
 
-            template<class TValue>
-            bool SetResultAtThreadExit(TValue&& value)
+            TState* get() const noexcept { return _state; }
+            TState& operator*() const noexcept { return *_state; }
+            TState* operator->() const noexcept { return _state; }
+
+            explicit operator bool() const noexcept { return _state != nullptr; }
+
+        private:
+            TState* _state;
+        };
+
+        // Runs continuations on the calling thread one after another, rather than one inside the
+        // other. While a thread runs a continuation, any continuations that it makes runnable
+        // (by completing a State, or by registering on one that is already complete) are queued,
+        // and run by the outermost call once the running one returns: a cascade of completions
+        // or a long chain of then() runs at a constant stack depth. Continuations run in the
+        // order that they became runnable: those of one State in registration order, and those
+        // of a nested completion after the ones already pending. Only a nested completion is
+        // queued; the outermost call runs its own continuations in place.
+        class Trampoline
+        {
+            struct Entry
             {
-                {
-                    auto lock = AquireLock();
-                    
-                    if (!SetHasResult())
-                        return false;
+                Continuation* Callback;
 
-                    _result.Set(std::forward<TValue>(value));
-                }
+                // a queued continuation may live in its State (see InlineContinuation)
+                StatePtr<StateBase> Owner;
+            };
 
-                NotifyPromiseFullfilledAtThreadExit();
-                return true;
-            }
+            struct Queue
+            {
+                // the rest of the continuations given to the outermost call (whose caller keeps
+                // their State alive); they run before any that are queued.
+                Continuation* Current = nullptr;
 
-        protected:
+                std::vector<Entry> Entries;
+                std::size_t Next = 0;
+                bool Running = false;
+                std::exception_ptr Error;
+            };
+
+        public:
+
+            static bool IsRunning()
+            {
+                return Local().Running;
+            }
+
+            // runs the continuations from 'first' (linked by Next) of a State that 'owner' holds,
+            // and any that they make runnable; called from a continuation, queues them to run
+            // after it.
+            static void Run(Continuation* first, StateBase* owner)
+            {
+                auto& queue = Local();
+
+                if (queue.Running)
+                {
+                    Push(queue, first, owner);
+                    return;
+                }
+
+                // the caller keeps 'owner' alive until the continuations have run
+                queue.Current = first;
+                Enter(queue, []() { });
+            }
+
+            // calls 'callable' as if it were a continuation, without queuing it; the caller must
+            // not be running a continuation (see IsRunning).
+            template<class F>
+            static void Invoke(F&& callable)
+            {
+                auto& queue = Local();
+                assert(!queue.Running);
+
+                Enter(queue, std::forward<F>(callable));
+            }
+
+            // runs the pending continuations now, in the same order as the outermost call would,
+            // for a continuation that is about to block on a State that one of them may complete.
+            static void Help()
+            {
+                auto& queue = Local();
+                if (queue.Running)
+                    Drain(queue);
+            }
+
+        private:
+
+            static Queue& Local()
+            {
+                static thread_local Queue queue;
+                return queue;
+            }
+
+            // the continuations are no longer linked to their State: if there is no room to
+            // queue them, they run now, inside the running one, rather than being lost.
+            static void Push(Queue& queue, Continuation* first, StateBase* owner)
+            {
+                if (!Reserve(queue.Entries, Count(first)))
+                {
+                    while (first)
+                    {
+                        auto next = first->Next;
+                        InvokeOne(queue, first);
+                        first = next;
+                    }
+                    return;
+                }
+
+                while (first)
+                {
+                    auto next = first->Next;
+                    queue.Entries.push_back({ first, StatePtr<StateBase>(owner) });
+                    first = next;
+                }
+            }
+
+            static std::size_t Count(Continuation* first) noexcept
+            {
+                std::size_t count = 0;
+                for (; first; first = first->Next)
+                    ++count;
+
+                return count;
+            }
+
+            // makes room for 'count' more entries, so that pushing them cannot throw.
+            static bool Reserve(std::vector<Entry>& entries, std::size_t count) noexcept
+            {
+                auto required = entries.size() + count;
+                if (required <= entries.capacity())
+                    return true;
+
+                try
+                {
+                    entries.reserve((std::max)(required, 2 * entries.capacity()));
+                    return true;
+                }
+                catch (...)
+                {
+                    return false;
+                }
+            }
+
+            template<class F>
+            static void Enter(Queue& queue, F&& callable)
+            {
+                queue.Running = true;
+
+                try
+                {
+                    callable();
+                }
+                catch (...)
+                {
+                    if (!queue.Error)
+                        queue.Error = std::current_exception();
+                }
+
+                Drain(queue);
+                queue.Running = false;
+
+                // the first exception to escape a continuation is rethrown to the outermost caller;
+                // the continuations queued after it still run.
+                if (queue.Error)
+                {
+                    auto error = std::move(queue.Error);
+                    queue.Error = nullptr;
+                    std::rethrow_exception(error);
+                }
+            }
+
+            static void Drain(Queue& queue) noexcept
+            {
+                for (;;)
+                {
+                    if (auto current = queue.Current)
+                    {
+                        queue.Current = current->Next;
+                        InvokeOne(queue, current);
+                        continue;
+                    }
+
+                    if (queue.Next == queue.Entries.size())
+                        break;
+
+                    auto entry = std::move(queue.Entries[queue.Next++]);
+                    InvokeOne(queue, entry.Callback);
+                }
+
+                queue.Entries.clear();
+                queue.Next = 0;
+            }
+
+            static void InvokeOne(Queue& queue, Continuation* continuation) noexcept
+            {
+                try
+                {
+                    continuation->Invoke();
+                }
+                catch (...)
+                {
+                    if (!queue.Error)
+                        queue.Error = std::current_exception();
+                }
+            }
+        };
+
+        // 'allocator' may also be passed (moved) as one of 'args', provided that the state
+        // cannot throw once it has moved from it.
+        template<class TState, class... Args>
+        StatePtr<TState> AllocateState(strong_polymorphic_allocator<TState>& allocator, Args&&... args)
+        {
+            using traits = std::allocator_traits<strong_polymorphic_allocator<TState>>;
+
+            auto state = traits::allocate(allocator, 1);
+
+            try
+            {
+                traits::construct(allocator, state, std::forward<Args>(args)...);
+            }
+            catch (...)
+            {
+                traits::deallocate(allocator, state, 1);
+                throw;
+            }
+
+            return StatePtr<TState>(state, AdoptReference(0));
+        }
+
+        // 'allocator' is moved out of the state, keeping its memory resource alive until the state is released.
+        template<class TState>
+        void DeallocateState(TState* state, strong_polymorphic_allocator<TState> allocator) noexcept
+        {
+            using traits = std::allocator_traits<strong_polymorphic_allocator<TState>>;
+
+            traits::destroy(allocator, state);
+            traits::deallocate(allocator, state, 1);
+        }
+
+        template<typename T>
+        class State : public StateBase
+        {
+
+        private:
+
+            using unique_lock = ParkingLot::unique_lock;
+            using strong_reference = StatePtr<State>;
+            using allocator_t = strong_polymorphic_allocator<State>;
+
+        public:
+
+            template<class Alloc>
+            State(const StateTag&, Alloc&& alloc) :
+                _flags(0),
+                _status(StatusEmpty),
+                _waitStrategy(wait_strategy::adaptive()),
+                _allocator(std::forward<Alloc>(alloc)),
+                _result()
+            { }
+
+            ~State()
+            {
+                Clear();
+            }
+            
+            static StatePtr<State> MakeState()
+            {
+                return AllocState(default_strong_allocator<State>());
+            }
+
+            template<class Alloc, class = typename enable_if_not_same<State, Alloc>::type>
+            static StatePtr<State> AllocState(const Alloc& alloc)
+            {
+                // the allocator is only moved into the state by its last member initializer.
+                auto allocator = allocator_t(alloc);
+                return AllocateState(allocator, StateTag(0), std::move(allocator));
+            }
+
+            State(State&&) = delete;
+            State(const State&) = delete;
+            State& operator=(State&&) = delete;
+            State& operator=(const State&) = delete;
+
+            const allocator_t& Get_Allocator() const
+            {
+                return _allocator;
+            }
+
+            bool Is_Ready() const
+            {
+                return (_status.load(std::memory_order_acquire) & StatusReady) != 0;
+            }
+
+            // the strategy of waits that do not name one.
+            void SetWaitStrategy(const wait_strategy& strategy)
+            {
+                _waitStrategy = strategy;
+            }
+
+            const wait_strategy& GetWaitStrategy() const
+            {
+                return _waitStrategy;
+            }
+
+            // For a promise that is being reset: if it holds the only reference to this State,
+            // returns the State to the condition of a new one (keeping its allocator and wait
+            // strategy), so that it can be reused without allocating. Otherwise, returns false.
+            // A continuation that may still run holds a reference (to the future it was registered
+            // through, or while it runs, see NotifyCompletion), so none is lost: the only callbacks
+            // discarded here are those of a future that was dropped (e.g. a when_any loser, whose
+            // callback holds nothing but its JoinClaim). Clearing the flags frees the inline slot.
+            bool TryRecycle() noexcept
+            {
+                if (!IsUnique())
+                    return false;
+
+                Clear();
+                _flags.store(0, std::memory_order_relaxed);
+                _status.store(StatusEmpty, std::memory_order_relaxed);
+                return true;
+            }
+
+            void Wait() const
+            {
+                Wait(_waitStrategy);
+            }
+
+            void Wait(const wait_strategy& strategy) const
+            {
+                if (!HelpUntilReady())
+                    return;
+
+                if (SpinUntil(strategy, [this]() { return Is_Ready(); }, []() { return false; }))
+                    return;
+
+                auto lock = AquireLock();
+                Wait(lock);
+            }
+
+            template <class TDuration>
+            bool Wait_For(const TDuration& rel_time)
+            {
+                return Wait_For(rel_time, _waitStrategy);
+            }
+
+            template <class TDuration>
+            bool Wait_For(const TDuration& rel_time, const wait_strategy& strategy)
+            {
+                return Wait_Until(std::chrono::steady_clock::now() + rel_time, strategy);
+            }
+
+            template <class TTime>
+            bool Wait_Until(const TTime& abs_time)
+            {
+                return Wait_Until(abs_time, _waitStrategy);
+            }
+
+            template <class TTime>
+            bool Wait_Until(const TTime& abs_time, const wait_strategy& strategy)
+            {
+                using clock = typename TTime::clock;
+
+                if (!HelpUntilReady())
+                    return true;
+
+                if (SpinUntil(strategy, [this]() { return Is_Ready(); }, [&abs_time]() { return clock::now() >= abs_time; }))
+                    return true;
+
+                auto lock = AquireLock();
+                if (!RegisterWaiter())
+                    return true;
+
+                return ParkingLot::Wait_Until(this, lock, abs_time, [this]() { return Is_Ready(); });
+            }
+
+            template<class TCallback>
+            void SetCallback(TCallback&& callback)
+            {
+                SetCallback(std::forward<TCallback>(callback), this);
+            }
+
+            // 'owner' is the object that holds this state; a deferred callback keeps it alive.
+            template<class TCallback>
+            void SetCallback(TCallback&& callback, StateBase* owner)
+            {
+                Register(std::forward<TCallback>(callback), false, owner);
+            }
+
+            // for a continuation registered by consuming the only future of this State (not a
+            // shared_future), after which no other can be registered: unless an earlier callback
+            // (e.g. of when_any, whose losers are handed back) claimed it, the continuation takes
+            // the inline slot without claiming it, and the push, a single compare-exchange, can
+            // only fail if the State completes first.
+            template<class TCallback>
+            void SetSoleCallback(TCallback&& callback)
+            {
+                Register(std::forward<TCallback>(callback), true, this);
+            }
+
+            // For the only producer of the State (see SolePromise), which has no other setter to
+            // claim the result from: it stores the result once, then publishes it, with a single
+            // exchange of the status word. FlagHasResult is not set: HasResult reports the result
+            // once it is published.
+            template<class TValue>
+            void StoreResult(TValue&& value)
+            {
+                _result.SetValue(std::forward<TValue>(value));
+            }
+
+            void StoreException(std::exception_ptr ex)
+            {
+                _result.SetException(std::move(ex));
+                _flags.fetch_or(FlagException, std::memory_order_release);
+            }
+
+            void Publish()
+            {
+                Publish(this);
+            }
+
+            // 'owner' is the object that holds this state; it is kept alive while the continuations run.
+            void Publish(StateBase* owner)
+            {
+                NotifyCompletion(owner);
+            }
+
+            void NotifyCompletion(StateBase* owner)
+            {
+                auto completed = HasFlag(FlagException) ? (StatusReady | StatusExceptional) : StatusReady;
+                auto status = _status.exchange(completed, std::memory_order_acq_rel);
+
+                if ((status & StatusWaiting) != 0)
+                    ParkingLot::NotifyAll(this);
+
+                auto head = GetContinuations(status);
+                if (!head)
+                    return;
+
+                // the caller only borrows its reference; a continuation may release it (e.g. by
+                // resetting the promise that completed this state) while the inline slot is in use.
+                // The reference is taken on the owner, which this state may be embedded in.
+                auto keepAlive = StatePtr<StateBase>(owner);
+                InvokeContinuations(head, owner);
+            }
+
+            bool HasException()
+            {
+                return (_status.load(std::memory_order_acquire) & StatusExceptional) != 0;
+            }
+
+            std::exception_ptr GetException() { return HasFlag(FlagException) ? _result.Exception() : nullptr; }
+            // a sole producer (see StoreResult) claims no flag; its result is there once published.
+            bool HasResult() { return HasFlag(FlagHasResult) || Is_Ready(); }
+
+            // future retrieved
+            bool SetRetrieved()
+            {
+                return SetFlag(FlagRetrieved);
+            }
+
+            bool SetException(std::exception_ptr ex)
+            {
+                return SetException(ex, this);
+            }
+
+            // 'owner' is the object that holds this state; it is kept alive while the continuations run.
+            bool SetException(std::exception_ptr ex, StateBase* owner)
+            {
+                if (!SetExceptionImpl(ex))
+                    return false;
+
+                NotifyPromiseFullfilled(owner);
+                return true;
+            }
+
+            bool SetExceptionAtThreadExit(std::exception_ptr ex)
+            {
+                return SetExceptionAtThreadExit(ex, this);
+            }
+
+            // 'owner' is the object that holds this state; it is kept alive until the thread exits.
+            bool SetExceptionAtThreadExit(std::exception_ptr ex, StateBase* owner)
+            {
+                if (!SetExceptionImpl(ex))
+                    return false;
+
+                NotifyPromiseFullfilledAtThreadExit(owner);
+                return true;
+            }
+
+            T GetResult()
+            {
+                Wait();
+                CheckException();
+                return std::move(_result.Value());
+            }
+
+            const T& GetResult() const
+            {
+                Wait();
+                CheckException();
+                return _result.Value();
+            }
+
+            template<class TValue>
+            bool SetResult(TValue&& value)
+            {
+                return SetResult(std::forward<TValue>(value), this);
+            }
+
+            // 'owner' is the object that holds this state; it is kept alive while the continuations run.
+            template<class TValue>
+            bool SetResult(TValue&& value, StateBase* owner)
+            {
+                if (!SetHasResult())
+                    return false;
+
+                _result.SetValue(std::forward<TValue>(value));
+
+                NotifyPromiseFullfilled(owner);
+                return true;
+            }
+
+            template<class TValue>
+            bool SetResultAtThreadExit(TValue&& value)
+            {
+                return SetResultAtThreadExit(std::forward<TValue>(value), this);
+            }
+
+            // 'owner' is the object that holds this state; it is kept alive until the thread exits.
+            template<class TValue>
+            bool SetResultAtThreadExit(TValue&& value, StateBase* owner)
+            {
+                if (!SetHasResult())
+                    return false;
+
+                _result.SetValue(std::forward<TValue>(value));
+
+                NotifyPromiseFullfilledAtThreadExit(owner);
+                return true;
+            }
+
+        protected:
+
+            virtual void Destroy() noexcept override
+            {
+                DeallocateState(this, ReleaseAllocator());
+            }
+
+            allocator_t ReleaseAllocator() noexcept
+            {
+                return std::move(_allocator);
+            }
+
+            strong_reference GetNotifier()
+            {
+                return strong_reference(this);
+            }
+
+            // locks this state's bucket of the parking lot, for a blocking waiter.
+            unique_lock AquireLock() const
+            {
+                return ParkingLot::Lock(this);
+            }
+
+            void InvokeContinuations(Continuation* head, StateBase* owner)
+            {
+                // the stack holds the newest continuation first; restore registration order.
+                Continuation* ordered = nullptr;
+                while (head)
+                {
+                    auto next = head->Next;
+                    head->Next = ordered;
+                    ordered = head;
+                    head = next;
+                }
+
+                Trampoline::Run(ordered, owner);
+            }
+
+            static void DiscardContinuations(Continuation* head) noexcept
+            {
+                while (head)
+                {
+                    auto next = head->Next;
+                    head->Discard();
+                    head = next;
+                }
+            }
+
+            // lock must be held; blocks until the state is ready.
+            void Wait(unique_lock& lock) const
+            {
+                if (!RegisterWaiter())
+                    return;
+
+                ParkingLot::Wait(this, lock, [this]() { return Is_Ready(); });
+            }
+
+            // returns false if the state is ready, after running any continuations queued on this
+            // thread (one of which may be what completes it).
+            bool HelpUntilReady() const
+            {
+                if (Is_Ready())
+                    return false;
+
+                Trampoline::Help();
+                return !Is_Ready();
+            }
+
+            // lock must be held; returns false if the state is already ready.
+            bool RegisterWaiter() const
+            {
+                auto status = _status.fetch_or(StatusWaiting, std::memory_order_acq_rel);
+                return (status & StatusReady) == 0;
+            }
+
+        private:
+
+            // destroys the result, or the continuations of a State that never completed.
+            void Clear() noexcept
+            {
+                auto status = _status.load(std::memory_order_acquire);
+                if ((status & StatusReady) == 0)
+                    DiscardContinuations(GetContinuations(status));
+                else if ((status & StatusExceptional) != 0)
+                    _result.DestroyException();
+                else
+                    _result.DestroyValue();
+            }
+
+            template<class TCallback>
+            void Register(TCallback&& callback, bool sole, StateBase* owner)
+            {
+                if (!Is_Ready())
+                {
+                    auto continuation = CreateContinuation(std::forward<TCallback>(callback), sole);
+                    if (PushContinuation(continuation))
+                        return;
+
+                    // completed while registering, invoke immediately
+                    continuation->Next = nullptr;
+                    Trampoline::Run(continuation, owner);
+                    return;
+                }
+
+                // promise is ready: invoke immediately, or after the running continuation
+                if (Trampoline::IsRunning())
+                {
+                    auto continuation = CreateContinuation(std::forward<TCallback>(callback), sole);
+                    continuation->Next = nullptr;
+                    Trampoline::Run(continuation, owner);
+                    return;
+                }
+
+                Trampoline::Invoke(std::forward<TCallback>(callback));
+            }
+
+            template<class TCallback>
+            std::enable_if_t<fits_inline_continuation<std::decay_t<TCallback>>::value, Continuation*>
+            CreateContinuation(TCallback&& callback, bool sole)
+            {
+                using continuation_t = InlineContinuation<std::decay_t<TCallback>>;
+
+                // the first continuation claims the inline slot (a sole one has no rival for
+                // it, but may follow one that holds it); any others are allocated.
+                if (sole ? !HasFlag(FlagInlineClaimed) : SetFlag(FlagInlineClaimed))
+                    return new(&_inlineContinuation) continuation_t(std::forward<TCallback>(callback));
+
+                return AllocateContinuation(std::forward<TCallback>(callback));
+            }
+
+            template<class TCallback>
+            std::enable_if_t<!fits_inline_continuation<std::decay_t<TCallback>>::value, Continuation*>
+            CreateContinuation(TCallback&& callback, bool)
+            {
+                return AllocateContinuation(std::forward<TCallback>(callback));
+            }
+
+            template<class TCallback>
+            Continuation* AllocateContinuation(TCallback&& callback)
+            {
+                using continuation_t = AllocatedContinuation<std::decay_t<TCallback>>;
+
+                return continuation_t::Create(std::forward<TCallback>(callback), _allocator);
+            }
+
+            bool PushContinuation(Continuation* continuation)
+            {
+                auto status = _status.load(std::memory_order_acquire);
+                do
+                {
+                    if ((status & StatusReady) != 0)
+                        return false;
+
+                    continuation->Next = GetContinuations(status);
+                } while (!_status.compare_exchange_weak(
+                    status, 
+                    PackStatus(continuation, status & StatusFlagMask), 
+                    std::memory_order_acq_rel, 
+                    std::memory_order_acquire));
+
+                return true;
+            }
+
+            void NotifyPromiseFullfilled(StateBase* owner)
+            {
+                NotifyCompletion(owner);
+            }
+
+            void NotifyPromiseFullfilledAtThreadExit(StateBase* owner)
+            {
+                assert(owner);
+
+                using exit_function_t = std::pair<StatePtr<StateBase>, State*>;
+
+                class ExitNotifier
+                {
+                public:
+                    // the trampoline is constructed first, so that it outlives the notifier
+                    ExitNotifier() { Trampoline::IsRunning(); }
+                    ExitNotifier(const ExitNotifier&) = delete;
+                    ExitNotifier& operator=(const ExitNotifier&) = delete;
+
+                    ~ExitNotifier() noexcept
+                    {
+                        while (!_exitFunctions.empty())
+                        {
+                            auto& exitFunction = _exitFunctions.front();
+                            exitFunction.second->NotifyCompletion(exitFunction.first.get());
+                            _exitFunctions.pop();
+                        }
+                    }
+
+                    void Add(exit_function_t&& block)
+                    {
+                        _exitFunctions.emplace(std::forward<exit_function_t>(block));
+                    }
+
+                private:
+                    std::queue<exit_function_t> _exitFunctions;
+                };
+
+                thread_local ExitNotifier notifier;
+                notifier.Add(exit_function_t(StatePtr<StateBase>(owner), this));
+            }
+
+            bool HasFlag(StateFlags flag) const
+            {
+                return (_flags.load(std::memory_order_acquire) & flag) != 0;
+            }
+
+            // returns false if the flag was already set.
+            bool SetFlag(StateFlags flag)
+            {
+                return (_flags.fetch_or(flag, std::memory_order_acq_rel) & flag) == 0;
+            }
+
+            bool SetHasResult()
+            {
+                return SetFlag(FlagHasResult);
+            }
+
+            void CheckException() const
+            {
+                if (HasFlag(FlagException))
+                    std::rethrow_exception(_result.Exception());
+            }
+
+            bool SetExceptionImpl(std::exception_ptr ex)
+            {
+                if (!SetHasResult())
+                    return false;
+
+                _result.SetException(std::move(ex));
+                _flags.fetch_or(FlagException, std::memory_order_release);
+                return true;
+            }
+
+            // The flags fill the padding after the reference count (on ABIs that reuse a base's
+            // tail padding), and with the status word open the State: that is the line a consumer
+            // polls, and the one it writes when it registers a continuation. The result, which
+            // the producer writes, comes last, at least a cache line past the status word, so that
+            // storing it does not contend with a consumer spinning on is_ready(). Allocated from a
+            // cache_aligned_resource, a State also shares no line with its neighbours.
+            std::atomic<std::uint32_t> _flags;
+            mutable std::atomic<std::uintptr_t> _status;
+
+            inline_continuation_storage_t _inlineContinuation;
+
+            wait_strategy _waitStrategy;
+            allocator_t _allocator;
+
+            ResultBlock<T> _result;
+        };
+
+        // The state of a promise<future<T>>; TPrimaryState holds the nested future,
+        // and the (reference counted) TSecondaryState holds its unwrapped result.
+        template<typename TPrimaryState, typename TSecondaryState>
+        class CompositeState : public TSecondaryState
+        {
+            using allocator_t = strong_polymorphic_allocator<CompositeState>;
+
+        public:
+
+            template<class Alloc>
+            CompositeState(const StateTag& tag, const Alloc& alloc)
+                : TSecondaryState(tag, alloc), _primary(tag, alloc)
+            {
+                SetCallback([this]() mutable
+                {
+                    if (HasException())
+                    {
+                        TSecondaryState::SetException(GetException());
+                        return;
+                    }
+
+                    auto innerFuture = GetResult();
+                    if (!innerFuture.valid())
+                    {
+                        TSecondaryState::SetException(CreateFutureExceptionPtr(future_errc::broken_promise));
+                        return;
+                    }
+
+                    FutureHelper::Forward(std::move(innerFuture), StatePtr<TSecondaryState>(this));
+                });
+            }
+
+            bool Is_Ready() const { return _primary.Is_Ready(); }
+
+            void SetWaitStrategy(const wait_strategy& strategy)
+            {
+                _primary.SetWaitStrategy(strategy);
+                TSecondaryState::SetWaitStrategy(strategy);
+            }
+
+            const wait_strategy& GetWaitStrategy() const { return _primary.GetWaitStrategy(); }
+
+            // the nested future's callback (see the constructor) would have to be registered
+            // again; a reset promise<future<T>> allocates a new State instead.
+            bool TryRecycle() noexcept { return false; }
+
+            void Wait() const { _primary.Wait(); }
+            void Wait(const wait_strategy& strategy) const { _primary.Wait(strategy); }
+
+            template <class TDuration>
+            bool Wait_For(const TDuration& rel_time)
+            {
+                return _primary.Wait_For(rel_time);
+            }
+
+            template <class TDuration>
+            bool Wait_For(const TDuration& rel_time, const wait_strategy& strategy)
+            {
+                return _primary.Wait_For(rel_time, strategy);
+            }
+
+            template <class TTime>
+            bool Wait_Until(const TTime& abs_time)
+            {
+                return _primary.Wait_Until(abs_time);
+            }
+
+            template <class TTime>
+            bool Wait_Until(const TTime& abs_time, const wait_strategy& strategy)
+            {
+                return _primary.Wait_Until(abs_time, strategy);
+            }
+
+            template<class TCallback>
+            void SetCallback(TCallback&& callback)
+            {
+                _primary.SetCallback(std::forward<TCallback>(callback), this);
+            }
+
+            // the nested future's own callback (see the constructor) already holds the inline slot.
+            template<class TCallback>
+            void SetSoleCallback(TCallback&& callback)
+            {
+                _primary.SetCallback(std::forward<TCallback>(callback), this);
+            }
+
+            decltype(auto) Get_Allocator() const
+            {
+                return TSecondaryState::Get_Allocator();
+            }
+
+            bool HasResult() { return _primary.HasResult(); }
+
+            bool SetRetrieved() { return _primary.SetRetrieved(); }
+
+            bool HasException()
+            {
+                return _primary.HasException();
+            }
+
+            std::exception_ptr GetException()
+            {
+                return _primary.GetException();
+            }
+
+            bool SetException(std::exception_ptr ex)
+            {
+                return _primary.SetException(ex, this);
+            }
+
+            bool SetExceptionAtThreadExit(std::exception_ptr ex)
+            {
+                return _primary.SetExceptionAtThreadExit(ex, this);
+            }
+
+            decltype(auto) GetResult()
+            {
+                return _primary.GetResult();
+            }
+
+            decltype(auto) GetResult() const
+            {
+                return _primary.GetResult();
+            }
+
+            template<class TValue>
+            bool SetResult(TValue&& value)
+            {
+                return _primary.SetResult(std::forward<TValue>(value), this);
+            }
+
+            template<class TValue>
+            bool SetResultAtThreadExit(TValue&& value)
+            {
+                return _primary.SetResultAtThreadExit(std::forward<TValue>(value), this);
+            }
+
+            template<class TValue>
+            void StoreResult(TValue&& value)
+            {
+                _primary.StoreResult(std::forward<TValue>(value));
+            }
 
-            strong_reference GetNotifier()
+            void StoreException(std::exception_ptr ex)
             {
-                return _self.lock();
+                _primary.StoreException(ex);
             }
 
-            void SetNotifier(const weak_reference& notifier)
+            void Publish()
             {
-                _self = notifier;
+                _primary.Publish(this);
             }
 
-            unique_lock AquireLock() const
+            static StatePtr<CompositeState> MakeState()
             {
-                return unique_lock(_mutex);
+                return AllocState(default_strong_allocator<CompositeState>());
             }
 
-            void InvokeContinuations()
+            template<class Alloc, class = typename enable_if_not_same<CompositeState, Alloc>::type>
+            static StatePtr<CompositeState> AllocState(const Alloc& alloc)
             {
-                auto current = _callbacks.begin();
-                while (current != _callbacks.end())
-                {
-                    (*current)(); // todo: exceptions?
-                    current++;
-                    _callbacks.pop_front(); // break circular references.
-                }
+                auto allocator = allocator_t(alloc);
+                return AllocateState(allocator, StateTag(0), allocator);
             }
 
-            void Wait(unique_lock& lock) const
+        protected:
+
+            virtual void Destroy() noexcept override
             {
-                _condition.wait(lock, [this]() { return Is_Ready(); });
+                DeallocateState(this, allocator_t(TSecondaryState::ReleaseAllocator()));
             }
 
         private:
+            TPrimaryState _primary;
+        };
+
+        // The state of when_all: it holds the input futures, and publishes them as its result once
+        // the last of them completes. Each input registers one callback; the callbacks share a
+        // single reference to the state, which the last of them releases.
+        template<class Sequence>
+        class WhenAllState : public State<Sequence>
+        {
+            using Base = State<Sequence>;
+            using allocator_t = strong_polymorphic_allocator<WhenAllState>;
+
+        public:
+
+            WhenAllState(const StateTag& tag, allocator_t&& allocator, Sequence&& futures)
+                : Base(tag, std::move(allocator)),
+                  _futures(std::move(futures)),
+                  _pending(0)
+            { }
 
-            void NotifyPromiseFullfilled()
+            static future<Sequence> Create(Sequence&& futures)
             {
-                NotifyCompletion();
+                auto allocator = default_strong_allocator<WhenAllState>();
+                auto state = AllocateState(allocator, StateTag(0), std::move(allocator), std::move(futures));
+
+                state->RegisterCallbacks();
+                return FutureFactory::Create<Sequence>(std::move(state));
             }
 
-            void NotifyPromiseFullfilledAtThreadExit()
+        protected:
+
+            virtual void Destroy() noexcept override
             {
-                auto block = _self.lock();
-                assert(block);
+                DeallocateState(this, allocator_t(Base::ReleaseAllocator()));
+            }
 
-                class ExitNotifier
+        private:
+
+            void RegisterCallbacks()
+            {
+                std::size_t count = 0;
+                for_each(_futures, [&count](auto& future)
                 {
-                public:
-                    ExitNotifier() = default;
-                    ExitNotifier(const ExitNotifier&) = delete;
-                    ExitNotifier& operator=(const ExitNotifier&) = delete;
+                    if (!future.valid())
+                        throw CreateFutureError(future_errc::no_state);
 
-                    ~ExitNotifier() noexcept
-                    {
-                        while (!_exitFunctions.empty())
-                        {
-                            _exitFunctions.front()->NotifyCompletion();
-                            _exitFunctions.pop();
-                        }
-                    }
+                    count++;
+                });
 
-                    void Add(strong_reference&& block)
-                    {
-                        _exitFunctions.emplace(std::forward<strong_reference>(block));
-                    }
+                // one arrival per input, plus one for the registration itself
+                _pending.store(count + 1, std::memory_order_relaxed);
+                this->AddRef();
 
-                private:
-                    std::queue<strong_reference> _exitFunctions;
-                };
+                std::size_t registered = 0;
+                try
+                {
+                    for_each(_futures, [this, &registered](auto& future)
+                    {
+                        FutureHelper::SetCallback(future, [this]() { Arrive(1); });
+                        registered++;
+                    });
+                }
+                catch (...)
+                {
+                    Arrive(count - registered + 1);
+                    throw;
+                }
 
-                thread_local ExitNotifier notifier;
-                notifier.Add(std::move(block));
+                Arrive(1);
             }
 
-            bool SetHasResult()
+            void Arrive(std::size_t arrivals)
             {
-                if (_hasResult)
-                    return false;
+                if (_pending.fetch_sub(arrivals, std::memory_order_acq_rel) != arrivals)
+                    return;
 
-                _hasResult = true;
-                return _hasResult;
+                // the callbacks' reference is released last; it may destroy this state.
+                Base::SetResult(std::move(_futures));
+                this->Release();
             }
 
-            void CheckException() const
+            Sequence _futures;
+            std::atomic<std::size_t> _pending;
+        };
+
+        // The claim on a join state that its input callbacks share in place of the state itself.
+        // The first to claim it takes the state (and the reference held for it); the rest find it
+        // taken with a plain load, and only release the claim. The join state is therefore freed
+        // once it is claimed and published, however long its other inputs remain pending.
+        template<class TJoin>
+        class JoinClaim final : public StateBase
+        {
+            using allocator_t = strong_polymorphic_allocator<JoinClaim>;
+
+        public:
+
+            JoinClaim(allocator_t&& allocator, TJoin* join) noexcept
+                : _allocator(std::move(allocator)),
+                  _join(join)
             {
-                if (_exception)
-                    std::rethrow_exception(_exception);
+                join->AddRef();
             }
 
-            bool SetExceptionImpl(std::exception_ptr ex)
+            static StatePtr<JoinClaim> Create(TJoin* join)
             {
-                auto lock = AquireLock();
-                if (!SetHasResult())
-                    return false;
+                auto allocator = allocator_t(join->Get_Allocator());
+                return AllocateState(allocator, std::move(allocator), join);
+            }
 
-                _exception = ex;
-                return true;
+            // the join state for the first caller; null for every later one.
+            StatePtr<TJoin> Claim() noexcept
+            {
+                if (!_join.load(std::memory_order_relaxed))
+                    return nullptr;
+
+                return StatePtr<TJoin>(_join.exchange(nullptr, std::memory_order_acq_rel), AdoptReference(0));
             }
 
-            bool _retrieved;
-            bool _hasResult;
-            ResultBlock<T> _result;
-            std::exception_ptr _exception;
-            weak_reference _self;
+        protected:
 
-            int _ready;
-            mutable std::mutex _mutex;
-            mutable std::condition_variable _condition;
+            virtual void Destroy() noexcept override
+            {
+                Claim();
+                DeallocateState(this, std::move(_allocator));
+            }
+
+        private:
             allocator_t _allocator;
-            callbacks_t _callbacks;
+            std::atomic<TJoin*> _join;
         };
 
-        template<typename TPrimaryState, typename TSecondaryState>
-        class CompositeState : public TPrimaryState, public TSecondaryState
+        // The first input to complete takes the join state from the claim that the callbacks
+        // share; every later (losing) callback finds the claim taken, so a loser never touches
+        // the join state, and its callback (which stays registered on the loser's State) only
+        // holds the claim. The input futures are published once both the winner has been
+        // claimed and every callback has been registered.
+        template<class Sequence>
+        class WhenAnyState : public State<when_any_result<Sequence>>
         {
+            using Result = when_any_result<Sequence>;
+            using Base = State<Result>;
+            using Claim = JoinClaim<WhenAnyState>;
+            using allocator_t = strong_polymorphic_allocator<WhenAnyState>;
+
+            static constexpr std::size_t NoWinner = std::size_t(-1);
+
         public:
 
-            template<class Alloc>
-            CompositeState(const StateTag& tag, const Alloc& alloc)
-                : TPrimaryState(tag, alloc), TSecondaryState(tag, alloc)
+            WhenAnyState(const StateTag& tag, allocator_t&& allocator, Sequence&& futures)
+                : Base(tag, std::move(allocator)),
+                  _futures(std::move(futures)),
+                  _winner(NoWinner),
+                  _gates(0)
+            { }
+
+            static future<Result> Create(allocator_t allocator, Sequence&& futures)
             {
-                SetCallback([this]() mutable
+                auto state = AllocateState(allocator, StateTag(0), std::move(allocator), std::move(futures));
+
+                state->RegisterCallbacks();
+                return FutureFactory::Create<Result>(std::move(state));
+            }
+
+        protected:
+
+            virtual void Destroy() noexcept override
+            {
+                DeallocateState(this, allocator_t(Base::ReleaseAllocator()));
+            }
+
+        private:
+
+            void RegisterCallbacks()
+            {
+                std::size_t count = 0;
+                for_each(_futures, [&count](auto& future)
                 {
-                    if (HasException())
-                    {
-                        TSecondaryState::SetException(GetException());
-                        return;
-                    }
+                    if (!future.valid())
+                        throw CreateFutureError(future_errc::no_state);
 
-                    auto innerFuture = GetResult();
-                    if (!innerFuture.valid())
-                    {
-                        TSecondaryState::SetException(CreateFutureExceptionPtr(future_errc::broken_promise));
-                        return;
-                    }
+                    count++;
+                });
+
+                // the result is published by whichever of the winner and the registration opens
+                // the last gate.
+                _gates.store(count == 0 ? 1 : 2, std::memory_order_relaxed);
 
-                    auto futureState = TSecondaryState::GetNotifier();
-                    innerFuture.then([futureState = std::move(futureState)](auto& future)
+                auto claim = Claim::Create(this);
+
+                std::size_t registered = 0;
+                try
+                {
+                    for_each(_futures, [&claim, &registered](auto& future)
                     {
-                        CompositeState::SetResultFromFuture(*futureState, future);
+                        FutureHelper::SetCallback(future, [claim, index = registered]()
+                        {
+                            if (auto join = claim->Claim())
+                                join->Win(index);
+                        });
+                        registered++;
                     });
-                });
+                }
+                catch (...)
+                {
+                    // the callbacks already registered find the claim taken
+                    claim->Claim();
+                    throw;
+                }
+
+                Open();
             }
 
-            template<class TCallback>
-            void SetCallback(TCallback&& callback)
+            void Win(std::size_t index)
             {
-                TPrimaryState::SetCallback(std::forward<TCallback>(callback));
+                _winner = index;
+                Open();
             }
 
-            decltype(auto) Get_Allocator()
+            void Open()
             {
-                return TPrimaryState::Get_Allocator();
+                if (_gates.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                    return;
+
+                Result result;
+                result.index = _winner;
+                result.futures = std::move(_futures);
+
+                Base::SetResult(std::move(result));
             }
 
-            bool HasResult() { return TPrimaryState::HasResult(); }
+            Sequence _futures;
+            std::size_t _winner;
+            std::atomic<unsigned> _gates;
+        };
 
-            bool SetRetrieved() { return TPrimaryState::SetRetrieved(); }
+        // The state of repeat_until: it calls the body, waits for the future that it returns and
+        // tests the result, until the predicate accepts one. Each iteration starts from the loop
+        // rather than from the last one's continuation, so nothing is nested: an iteration that
+        // completes before its callback is registered is picked up by the loop itself (a
+        // trampoline), and one that completes later resumes the loop on the completing thread.
+        // Only the current iteration's future is held.
+        template<class Body, class Predicate>
+        class LoopState : public State<loop_unit_t<Body>>
+        {
+            using unit_t = loop_unit_t<Body>;
+            using Base = State<unit_t>;
+            using Future = loop_future_t<Body>;
+            using allocator_t = strong_polymorphic_allocator<LoopState>;
 
-            bool HasException()
-            {
-                return TPrimaryState::HasException();
-            }
+            static_assert(is_future<Future>::value, "The body of a loop must return a future.");
 
-            std::exception_ptr GetException()
+            // who continues the loop once the current iteration completes
+            enum Phase : unsigned
             {
-                return TPrimaryState::GetException();
-            }
+                Registering,    // the thread registering the callback, if it completes meanwhile
+                Registered,     // the callback
+                Completed       // set by the callback, when it ran during registration
+            };
 
-            bool SetException(std::exception_ptr ex)
+        public:
+
+            template<class TBody, class TPredicate>
+            LoopState(const StateTag& tag, allocator_t&& allocator, TBody&& body, TPredicate&& predicate)
+                : Base(tag, std::move(allocator)),
+                  _body(std::forward<TBody>(body)),
+                  _predicate(std::forward<TPredicate>(predicate)),
+                  _phase(Registered)
+            { }
+
+            template<class TBody, class TPredicate>
+            static future_from_unit_t<unit_t> Create(TBody&& body, TPredicate&& predicate)
             {
-                return TPrimaryState::SetException(ex);
+                auto allocator = default_strong_allocator<LoopState>();
+                auto state = AllocateState(allocator, StateTag(0), std::move(allocator),
+                    std::forward<TBody>(body), std::forward<TPredicate>(predicate));
+
+                state->Run();
+                return FutureFactory::Create<type_from_unit_t<unit_t>>(std::move(state));
             }
 
-            decltype(auto) GetResult()
+        protected:
+
+            virtual void Destroy() noexcept override
             {
-                return TPrimaryState::GetResult();
+                DeallocateState(this, allocator_t(Base::ReleaseAllocator()));
             }
 
-            decltype(auto) GetResult() const
+        private:
+
+            void Run()
             {
-                return TPrimaryState::GetResult();
+                for (;;)
+                {
+                    try
+                    {
+                        _current = _body();
+                    }
+                    catch (...)
+                    {
+                        Base::SetException(std::current_exception());
+                        return;
+                    }
+
+                    if (!_current.valid())
+                    {
+                        Base::SetException(CreateFutureExceptionPtr(future_errc::no_state));
+                        return;
+                    }
+
+                    if (!Await() || Step())
+                        return;
+                }
             }
 
-            template<class TValue>
-            bool SetResult(TValue&& value)
+            // true if the current iteration has completed; otherwise the callback resumes the loop.
+            bool Await()
             {
-                return TPrimaryState::SetResult(std::forward<TValue>(value));
+                if (_current.is_ready())
+                    return true;
+
+                _phase.store(Registering, std::memory_order_relaxed);
+                FutureHelper::SetCallback(_current, [loop = StatePtr<LoopState>(this)]() { loop->Resume(); });
+
+                return _phase.exchange(Registered, std::memory_order_acq_rel) == Completed;
             }
 
-            static std::shared_ptr<CompositeState> MakeState()
+            void Resume()
             {
-                return AllocState(std::allocator<CompositeState>());
+                if (_phase.exchange(Completed, std::memory_order_acq_rel) == Registering)
+                    return;
+
+                if (!Step())
+                    Run();
             }
 
-            template<class Alloc, class = typename enable_if_not_same<CompositeState, Alloc>::type>
-            static std::shared_ptr<CompositeState> AllocState(const Alloc& alloc)
+            // consumes the current iteration; true once the loop is complete.
+            bool Step()
             {
-                auto state = std::allocate_shared<CompositeState>(alloc, StateTag(0), alloc);
+                auto current = std::move(_current);
 
-                state->SetNotifier(state);
+                try
+                {
+                    if (FutureHelper::HasException(current))
+                    {
+                        Base::SetException(FutureHelper::GetException(current));
+                        return true;
+                    }
 
-                return state;
-            }
+                    auto result = FutureHelper::GetResult(current);
+                    if (!Accept(result))
+                        return false;
 
-        protected:
+                    Base::SetResult(std::move(result));
+                }
+                catch (...)
+                {
+                    Base::SetException(std::current_exception());
+                }
 
-            void SetNotifier(const std::weak_ptr<CompositeState>& notifier)
-            {
-                TPrimaryState::SetNotifier(notifier);
-                TSecondaryState::SetNotifier(notifier);
+                return true;
             }
 
-            std::shared_ptr<TPrimaryState> GetNotifier()
-            {
-                return TPrimaryState::GetNotifier();
-            }
+            bool Accept(Unit&) { return _predicate(); }
 
-        private:
-            template<class TState, class T>
-            static void SetResultFromFuture(TState& state, BasicFuture<T>& future);
+            template<class T>
+            bool Accept(std::reference_wrapper<T>& result) { return _predicate(result.get()); }
+
+            template<class T>
+            bool Accept(T& result) { return _predicate(static_cast<const T&>(result)); }
+
+            std::decay_t<Body> _body;
+            std::decay_t<Predicate> _predicate;
+            Future _current;
+            std::atomic<unsigned> _phase;
         };
 
         template<class R>
@@ -722,13 +1965,24 @@ namespace eventual
                 _state(StateType::AllocState(alloc))
             { }
 
+            explicit CommonPromise(const wait_strategy& strategy) : CommonPromise()
+            {
+                _state->SetWaitStrategy(strategy);
+            }
+
+            template<class Alloc>
+            CommonPromise(std::allocator_arg_t arg, const Alloc& alloc, const wait_strategy& strategy) :
+                CommonPromise(arg, alloc)
+            {
+                _state->SetWaitStrategy(strategy);
+            }
+
             ~CommonPromise() noexcept
             {
-                auto state = _state;
-                if (!state || state->HasResult())
+                if (!_state || _state->HasResult())
                     return;
 
-                state->SetException(CreateFutureExceptionPtr(future_errc::broken_promise));
+                _state->SetException(CreateFutureExceptionPtr(future_errc::broken_promise));
             }
 
             CommonPromise& operator=(const CommonPromise& rhs) = delete;
@@ -746,7 +2000,7 @@ namespace eventual
             template<class TValue>
             void SetValue(TValue&& value)
             {
-                auto state = ValidateState();
+                const auto& state = ValidateState();
 
                 if (!state->SetResult(std::forward<TValue>(value)))
                     throw CreateFutureError(future_errc::promise_already_satisfied);
@@ -755,7 +2009,7 @@ namespace eventual
             template<class TValue>
             void SetValueAtThreadExit(TValue&& value)
             {
-                auto state = ValidateState();
+                const auto& state = ValidateState();
 
                 if (!state->SetResultAtThreadExit(std::forward<TValue>(value)))
                     throw CreateFutureError(future_errc::promise_already_satisfied);
@@ -763,7 +2017,7 @@ namespace eventual
 
             void SetException(std::exception_ptr exceptionPtr)
             {
-                auto state = ValidateState();
+                const auto& state = ValidateState();
 
                 if (!state->SetException(exceptionPtr))
                     throw CreateFutureError(future_errc::promise_already_satisfied);
@@ -771,7 +2025,7 @@ namespace eventual
 
             void SetExceptionAtThreadExit(std::exception_ptr exceptionPtr)
             {
-                auto state = ValidateState();
+                const auto& state = ValidateState();
 
                 if (!state->SetExceptionAtThreadExit(exceptionPtr))
                     throw CreateFutureError(future_errc::promise_already_satisfied);
@@ -780,39 +2034,50 @@ namespace eventual
             template<class TValue>
             bool TrySetValue(TValue&& value)
             {
-                auto state = ValidateState();
+                const auto& state = ValidateState();
 
                 return state->SetResult(std::forward<TValue>(value));
             }
 
+            // reuses the State if this promise holds the only reference to it; otherwise it
+            // abandons the State (breaking the promise, if it was never kept) for a new one.
+            // A continuation of the State may call it: while the continuations run, the State
+            // (or the CompositeState that it is part of) holds a reference to itself.
             void Reset()
             {
-                auto state = ValidateState();
+                const auto& state = ValidateState();
+                if (state->TryRecycle())
+                    return;
 
-                const auto& allocator = state->Get_Allocator();
-                auto newState = StateType::AllocState(allocator);
+                CommonPromise fresh(StateType::AllocState(state->Get_Allocator()));
+                fresh._state->SetWaitStrategy(state->GetWaitStrategy());
 
-                std::swap(_state, newState);
+                swap(fresh);
             }
 
             bool Valid() const noexcept
             {
-                auto state = _state;
-                return state ? true : false;
+                return _state ? true : false;
             }
 
-            SharedState ValidateState() const
+            // the returned reference is borrowed from (and only valid as long as) this promise.
+            const SharedState& ValidateState() const
             {
-                auto state = _state;
-                if (!state)
+                if (!_state)
                     throw CreateFutureError(future_errc::no_state);
 
-                return state;
+                return _state;
+            }
+
+            // takes the State from this promise, which is left without one.
+            SharedState ReleaseState() noexcept
+            {
+                return std::move(_state);
             }
 
             SharedState CopyState() const
             {
-                auto state = ValidateState();
+                const auto& state = ValidateState();
 
                 if (!state->SetRetrieved())
                     throw CreateFutureError(future_errc::future_already_retrieved);
@@ -842,39 +2107,142 @@ namespace eventual
             BasicPromise(SharedState state) 
                 : Base(state) { }
 
-            template<class Alloc>
-            BasicPromise(std::allocator_arg_t arg, const Alloc& alloc) 
-                : Base(arg, alloc) { }
+            template<class Alloc>
+            BasicPromise(std::allocator_arg_t arg, const Alloc& alloc) 
+                : Base(arg, alloc) { }
+
+            explicit BasicPromise(const wait_strategy& strategy)
+                : Base(strategy) { }
+
+            template<class Alloc>
+            BasicPromise(std::allocator_arg_t arg, const Alloc& alloc, const wait_strategy& strategy)
+                : Base(arg, alloc, strategy) { }
+
+            BasicPromise& operator=(const BasicPromise& rhs) = delete;
+            BasicPromise& operator=(BasicPromise&& other) noexcept = default;
+
+            void set_exception(std::exception_ptr exceptionPtr) { Base::SetException(exceptionPtr); }
+            void set_exception_at_thread_exit(std::exception_ptr exceptionPtr) { Base::SetExceptionAtThreadExit(exceptionPtr); }
+
+            void reset() { Base::Reset(); }
+
+        protected:
+
+            template<class TValue>
+            void SetValue(TValue&& value)
+            {
+                Base::SetValue(std::forward<TValue>(value));
+            }
+
+            template<class TValue>
+            void SetValueAtThreadExit(TValue&& value)
+            {
+                Base::SetValueAtThreadExit(std::forward<TValue>(value));
+            }
+
+            void SetException(std::exception_ptr exceptionPtr)
+            {
+                Base::SetException(exceptionPtr);
+            }
+
+            void SetExceptionAtThreadExit(std::exception_ptr exceptionPtr)
+            {
+                Base::SetExceptionAtThreadExit(exceptionPtr);
+            }
+        };
+
+        // The producer of an spsc_promise. As the only setter of its State, it keeps track of
+        // whether it has set it itself, instead of claiming the result in the State against
+        // other setters: setting costs a single atomic exchange (see State::StoreResult). It
+        // must not be used by several threads at once, and cannot set a result at thread exit.
+        template<class R>
+        class SolePromise : public CommonPromise<R>
+        {
+            using Base = CommonPromise<R>;
+
+        public:
+            SolePromise() : _satisfied(false) { }
+            SolePromise(const SolePromise& other) = delete;
+
+            SolePromise(SolePromise&& other) noexcept
+                : Base(std::move(other)), _satisfied(other._satisfied)
+            { }
+
+            template<class Alloc>
+            SolePromise(std::allocator_arg_t arg, const Alloc& alloc)
+                : Base(arg, alloc), _satisfied(false)
+            { }
+
+            ~SolePromise() noexcept
+            {
+                Abandon();
+            }
+
+            SolePromise& operator=(const SolePromise& rhs) = delete;
+
+            SolePromise& operator=(SolePromise&& other) noexcept
+            {
+                if (this != &other)
+                {
+                    Abandon();
+                    Base::operator=(std::move(other));
+                    _satisfied = other._satisfied;
+                }
+                return *this;
+            }
+
+            void swap(SolePromise& other) noexcept
+            {
+                Base::swap(other);
+                std::swap(_satisfied, other._satisfied);
+            }
 
-            BasicPromise& operator=(const BasicPromise& rhs) = delete;
-            BasicPromise& operator=(BasicPromise&& other) noexcept = default;
+            void set_exception(std::exception_ptr exceptionPtr)
+            {
+                const auto& state = ValidateUnsatisfied();
 
-            void set_exception(std::exception_ptr exceptionPtr) { Base::SetException(exceptionPtr); }
-            void set_exception_at_thread_exit(std::exception_ptr exceptionPtr) { Base::SetExceptionAtThreadExit(exceptionPtr); }
+                state->StoreException(exceptionPtr);
+                _satisfied = true;
+                state->Publish();
+            }
 
         protected:
 
+            // if the value's constructor throws, the promise is still unsatisfied.
             template<class TValue>
             void SetValue(TValue&& value)
             {
-                Base::SetValue(std::forward<TValue>(value));
-            }
+                const auto& state = ValidateUnsatisfied();
 
-            template<class TValue>
-            void SetValueAtThreadExit(TValue&& value)
-            {
-                Base::SetValueAtThreadExit(std::forward<TValue>(value));
+                state->StoreResult(std::forward<TValue>(value));
+                _satisfied = true;
+                state->Publish();
             }
 
-            void SetException(std::exception_ptr exceptionPtr)
+        private:
+
+            const typename Base::SharedState& ValidateUnsatisfied() const
             {
-                Base::SetException(exceptionPtr);
+                const auto& state = Base::ValidateState();
+
+                if (_satisfied)
+                    throw CreateFutureError(future_errc::promise_already_satisfied);
+
+                return state;
             }
 
-            void SetExceptionAtThreadExit(std::exception_ptr exceptionPtr)
+            // breaks the promise if it was never kept (the State's own flags do not say).
+            void Abandon() noexcept
             {
-                Base::SetExceptionAtThreadExit(exceptionPtr);
+                auto state = Base::ReleaseState();
+                if (!state || _satisfied)
+                    return;
+
+                state->StoreException(CreateFutureExceptionPtr(future_errc::broken_promise));
+                state->Publish();
             }
+
+            bool _satisfied;
         };
 
         template<class TFunctor, class R, class... ArgTypes>
@@ -978,6 +2346,39 @@ namespace eventual
             TFunctor _task;
         };
 
+        // Runs a continuation on the thread that completes the future.
+        struct InlineDispatch
+        {
+            // the result is only valid until the end of the full expression.
+            template<class TCallback>
+            TCallback&& operator()(TCallback&& callback) const
+            {
+                return std::forward<TCallback>(callback);
+            }
+        };
+
+        // Posts a continuation to an executor once the future completes.
+        template<class TExecutor>
+        class ExecutorDispatch
+        {
+        public:
+
+            explicit ExecutorDispatch(TExecutor& executor) : _executor(executor) { }
+
+            template<class TCallback>
+            auto operator()(TCallback&& callback) const
+            {
+                return
+                    [
+                        &executor = _executor,
+                        callback = std::forward<TCallback>(callback)
+                    ]() mutable { executor.execute(std::move(callback)); };
+            }
+
+        private:
+            TExecutor& _executor;
+        };
+
         template<class R>
         class BasicFuture
         {
@@ -1007,22 +2408,36 @@ namespace eventual
 
             void wait() const
             {
-                auto state = ValidateState();
-                state->Wait();
+                ValidateState()->Wait();
+            }
+
+            void wait(const wait_strategy& strategy) const
+            {
+                ValidateState()->Wait(strategy);
             }
 
             template <class Rep, class Period>
             future_status wait_for(const std::chrono::duration<Rep, Period>& rel_time) const
             {
-                auto state = ValidateState();
-                return state->Wait_For(rel_time) ? future_status::ready : future_status::timeout;
+                return ValidateState()->Wait_For(rel_time) ? future_status::ready : future_status::timeout;
+            }
+
+            template <class Rep, class Period>
+            future_status wait_for(const std::chrono::duration<Rep, Period>& rel_time, const wait_strategy& strategy) const
+            {
+                return ValidateState()->Wait_For(rel_time, strategy) ? future_status::ready : future_status::timeout;
             }
 
             template <class Clock, class Duration>
             future_status wait_until(const std::chrono::time_point<Clock, Duration>& abs_time) const
             {
-                auto state = ValidateState();
-                return state->Wait_Until(abs_time) ? future_status::ready : future_status::timeout;
+                return ValidateState()->Wait_Until(abs_time) ? future_status::ready : future_status::timeout;
+            }
+
+            template <class Clock, class Duration>
+            future_status wait_until(const std::chrono::time_point<Clock, Duration>& abs_time, const wait_strategy& strategy) const
+            {
+                return ValidateState()->Wait_Until(abs_time, strategy) ? future_status::ready : future_status::timeout;
             }
 
         protected:
@@ -1032,26 +2447,24 @@ namespace eventual
                 : BasicFuture(std::move(other._state))
             { }
 
-            SharedState ValidateState() const
+            // the returned reference is borrowed from (and only valid as long as) this future.
+            const SharedState& ValidateState() const
             {
-                auto state = _state;
-                if (!state)
+                if (!_state)
                     throw CreateFutureError(future_errc::no_state);
 
-                return state;
+                return _state;
             }
 
             decltype(auto) GetResult()
             {
-                auto state = ValidateState();
-                ResetState();
+                auto state = MoveState();
                 return state->GetResult();
             }
 
             decltype(auto) GetResult() const
             {
-                auto state = ValidateState();
-                const auto& stateRef = *state;
+                const auto& stateRef = *ValidateState();
                 return stateRef.GetResult();
             }
 
@@ -1065,38 +2478,51 @@ namespace eventual
                 return state;
             }
 
-            void CheckState()
+            void CheckState() const
             {
-                auto state = _state;
-
-                if (!state)
+                if (!_state)
                     throw CreateFutureError(future_errc::no_state);
             }
 
-            static shared_future<R> Share(future<R>&& future);
-
             template<class TContinuation, class TFuture>
             static decltype(auto) ThenMove(TContinuation&& continuation, TFuture& future)
             {
-                return ThenImpl(decay_copy(std::forward<TContinuation>(continuation)), std::move(future));
+                return ThenImpl(decay_copy(std::forward<TContinuation>(continuation)), std::move(future), InlineDispatch());
+            }
+
+            template<class TExecutor, class TContinuation, class TFuture>
+            static decltype(auto) ThenMove(TExecutor& executor, TContinuation&& continuation, TFuture& future)
+            {
+                return ThenImpl(decay_copy(std::forward<TContinuation>(continuation)), std::move(future), ExecutorDispatch<TExecutor>(executor));
             }
 
             template<class TContinuation, class TFuture>
             static decltype(auto) ThenShare(TContinuation&& continuation, const TFuture& future)
             {
-                return ThenImpl(decay_copy(std::forward<TContinuation>(continuation)), TFuture(future));
+                return ThenImpl(decay_copy(std::forward<TContinuation>(continuation)), TFuture(future), InlineDispatch());
             }
 
-            template<class TContinuation, class TFuture>
-            static decltype(auto) ThenImpl(TContinuation&& continuation, TFuture&& future);
+            template<class TExecutor, class TContinuation, class TFuture>
+            static decltype(auto) ThenShare(TExecutor& executor, TContinuation&& continuation, const TFuture& future)
+            {
+                return ThenImpl(decay_copy(std::forward<TContinuation>(continuation)), TFuture(future), ExecutorDispatch<TExecutor>(executor));
+            }
 
-        private:
+            template<class TContinuation, class TFuture, class TDispatch>
+            static decltype(auto) ThenImpl(TContinuation&& continuation, TFuture&& future, const TDispatch& dispatch);
 
-            decltype(auto) GetState()
+            bool HasException() const
             {
-                return _state;
+                return ValidateState()->HasException();
             }
 
+            std::exception_ptr GetException() const
+            {
+                return ValidateState()->GetException();
+            }
+
+        private:
+
             template<class TResult>
             static decltype(auto) GetUnwrappedFuture(const CommonPromise<TResult>& promise)
             {
@@ -1156,12 +2582,225 @@ namespace eventual
                     ]() mutable { task(std::move(argument)); };
             }
 
-            void ResetState()
+            SharedState _state;
+        };
+
+        // The base of future<R>, which is the only reference to its result; it may therefore hold a
+        // result that was known when it was created (e.g. by make_ready_future) in place of a State.
+        // The result moves to a State (is promoted) when it must be shared or outlive the future.
+        template<class R>
+        class UniqueFuture : public BasicFuture<R>
+        {
+            using Base = BasicFuture<R>;
+
+            template<class>
+            friend class UniqueFuture;
+            friend class FutureHelper;
+
+        protected:
+            using StateType = get_state_t<R>;
+            using SharedState = typename Base::SharedState;
+            using ReadyType = ReadyResult<unit_from_type_t<R>>;
+
+        public:
+            UniqueFuture() noexcept = default;
+            UniqueFuture(const UniqueFuture& other) = delete;
+            UniqueFuture(UniqueFuture&& other) noexcept = default;
+
+            UniqueFuture(const CommonPromise<R>& promise)
+                : Base(promise) { }
+
+            UniqueFuture(SharedState&& state) noexcept
+                : Base(std::forward<SharedState>(state)) { }
+
+            UniqueFuture(ReadyType&& ready) noexcept
+                : _ready(std::forward<ReadyType>(ready)) { }
+
+            UniqueFuture& operator=(const UniqueFuture& rhs) = delete;
+            UniqueFuture& operator=(UniqueFuture&& other) noexcept = default;
+
+            bool valid() const noexcept { return _ready.HasResult() || Base::valid(); }
+            bool is_ready() const noexcept { return _ready.HasResult() || Base::is_ready(); }
+
+            void wait() const
+            {
+                if (!_ready.HasResult())
+                    Base::wait();
+            }
+
+            void wait(const wait_strategy& strategy) const
             {
-                _state.reset();
+                if (!_ready.HasResult())
+                    Base::wait(strategy);
             }
 
-            SharedState _state;
+            template <class Rep, class Period>
+            future_status wait_for(const std::chrono::duration<Rep, Period>& rel_time) const
+            {
+                return _ready.HasResult() ? future_status::ready : Base::wait_for(rel_time);
+            }
+
+            template <class Rep, class Period>
+            future_status wait_for(const std::chrono::duration<Rep, Period>& rel_time, const wait_strategy& strategy) const
+            {
+                return _ready.HasResult() ? future_status::ready : Base::wait_for(rel_time, strategy);
+            }
+
+            template <class Clock, class Duration>
+            future_status wait_until(const std::chrono::time_point<Clock, Duration>& abs_time) const
+            {
+                return _ready.HasResult() ? future_status::ready : Base::wait_until(abs_time);
+            }
+
+            template <class Clock, class Duration>
+            future_status wait_until(const std::chrono::time_point<Clock, Duration>& abs_time, const wait_strategy& strategy) const
+            {
+                return _ready.HasResult() ? future_status::ready : Base::wait_until(abs_time, strategy);
+            }
+
+        protected:
+
+            template<template<typename> class NestedFuture>
+            UniqueFuture(UniqueFuture<NestedFuture<R>>&& other) noexcept
+                : Base(std::move(other))
+            {
+                if (!other._ready.HasResult())
+                    return;
+
+                // a ready outer future holds the nested future itself; there is no state to unwrap it.
+                if (other._ready.HasException())
+                {
+                    _ready.SetException(other._ready.GetException());
+                    other._ready.Reset();
+                    return;
+                }
+
+                auto nested = other._ready.Take();
+                if (!nested.valid())
+                {
+                    _ready.SetException(CreateFutureExceptionPtr(future_errc::broken_promise));
+                    return;
+                }
+
+                *this = std::move(nested);
+            }
+
+            decltype(auto) GetResult()
+            {
+                if (_ready.HasResult())
+                    return _ready.Take();
+
+                return Base::GetResult();
+            }
+
+            void CheckState() const
+            {
+                if (!valid())
+                    throw CreateFutureError(future_errc::no_state);
+            }
+
+            static shared_future<R> Share(future<R>&& future);
+
+            void Promote()
+            {
+                if (!_ready.HasResult())
+                    return;
+
+                auto state = StateType::MakeState();
+                state->SetRetrieved();
+                _ready.MoveTo(*state);
+
+                static_cast<Base&>(*this) = Base(std::move(state));
+            }
+
+            template<class TContinuation, class TFuture>
+            static decltype(auto) ThenMove(TContinuation&& continuation, TFuture& future)
+            {
+                // a ready future runs the continuation now, and returns its result without a State.
+                if (future._ready.HasResult())
+                    return ThenReady(decay_copy(std::forward<TContinuation>(continuation)), std::move(future));
+
+                return Base::ThenMove(std::forward<TContinuation>(continuation), future);
+            }
+
+            template<class TExecutor, class TContinuation, class TFuture>
+            static decltype(auto) ThenMove(TExecutor& executor, TContinuation&& continuation, TFuture& future)
+            {
+                future.Promote();
+                return Base::ThenMove(executor, std::forward<TContinuation>(continuation), future);
+            }
+
+        private:
+
+            bool HasException() const
+            {
+                return _ready.HasResult() ? _ready.HasException() : Base::HasException();
+            }
+
+            std::exception_ptr GetException() const
+            {
+                return _ready.HasResult() ? _ready.GetException() : Base::GetException();
+            }
+
+            template<class TContinuation, class TFuture>
+            static decltype(auto) ThenReady(TContinuation&& continuation, TFuture&& future)
+            {
+                using trait = get_continuation_result<TContinuation, TFuture>;
+                using result_t = typename trait::result_type;
+                using arg_t = typename trait::arg_value_t;
+
+                return ReadyFrom<result_t>([&continuation, &future]() -> result_t
+                {
+                    return continuation(static_cast<arg_t>(future));
+                });
+            }
+
+            template<class TResult, class TFunction>
+            static std::enable_if_t<!is_future<TResult>::value && !std::is_void<TResult>::value, future<TResult>>
+                ReadyFrom(TFunction&& function)
+            {
+                try
+                {
+                    return FutureFactory::CreateReady<TResult>(function());
+                }
+                catch (...)
+                {
+                    return FutureFactory::CreateExceptional<TResult>(std::current_exception());
+                }
+            }
+
+            template<class TResult, class TFunction>
+            static std::enable_if_t<std::is_void<TResult>::value, future<void>>
+                ReadyFrom(TFunction&& function)
+            {
+                try
+                {
+                    function();
+                    return FutureFactory::CreateReady<void>(Unit());
+                }
+                catch (...)
+                {
+                    return FutureFactory::CreateExceptional<void>(std::current_exception());
+                }
+            }
+
+            // a continuation that returns a future is unwrapped, as by then() on a State.
+            template<class TResult, class TFunction>
+            static enable_if_future_t<TResult> ReadyFrom(TFunction&& function)
+            {
+                using value_t = type_from_unit_t<typename get_future_unit<TResult>::type>;
+
+                try
+                {
+                    return function();
+                }
+                catch (...)
+                {
+                    return TResult(FutureFactory::CreateExceptional<value_t>(std::current_exception()));
+                }
+            }
+
+            ReadyType _ready;
         };
 
         template<class TResult, class T>
@@ -1171,15 +2810,52 @@ namespace eventual
         }
 
         template<class TResult, class T>
-        bool FutureHelper::TrySetValue(BasicPromise<TResult>& promise, const T& value)
+        void FutureHelper::SetCallback(UniqueFuture<TResult>& future, T&& callback)
+        {
+            // as for a State that is already complete, the callback runs immediately.
+            if (future._ready.HasResult())
+            {
+                callback();
+                return;
+            }
+
+            future._state->SetCallback(std::forward<T>(callback));
+        }
+
+        template<class TState, class T, class TResult>
+        void FutureHelper::SetCallback(TState& state, T&& callback, const BasicFuture<TResult>*)
+        {
+            state.SetCallback(std::forward<T>(callback));
+        }
+
+        template<class TState, class T, class TResult>
+        void FutureHelper::SetCallback(TState& state, T&& callback, const UniqueFuture<TResult>*)
+        {
+            state.SetSoleCallback(std::forward<T>(callback));
+        }
+
+        template<class TResult>
+        bool FutureHelper::HasException(const BasicFuture<TResult>& future)
+        {
+            return future.HasException();
+        }
+
+        template<class TResult>
+        bool FutureHelper::HasException(const UniqueFuture<TResult>& future)
+        {
+            return future.HasException();
+        }
+
+        template<class TResult>
+        std::exception_ptr FutureHelper::GetException(const BasicFuture<TResult>& future)
         {
-            return promise.TrySetValue(value);
+            return future.GetException();
         }
 
         template<class TResult>
-        decltype(auto) FutureHelper::GetState(BasicFuture<TResult>& future)
+        std::exception_ptr FutureHelper::GetException(const UniqueFuture<TResult>& future)
         {
-            return future.GetState();
+            return future.GetException();
         }
 
         template<class TResult>
@@ -1188,14 +2864,55 @@ namespace eventual
             return future.GetResult();
         }
 
-        template<class TPrimaryState, class TSecondaryState>
-        template<class TState, class T>
-        void CompositeState<TPrimaryState, TSecondaryState>::SetResultFromFuture(TState& state, BasicFuture<T>& future)
+        template<class TResult>
+        decltype(auto) FutureHelper::GetResult(UniqueFuture<TResult>& future)
+        {
+            return future.GetResult();
+        }
+
+        template<class TResult>
+        UniqueFuture<TResult>&& FutureHelper::Promote(UniqueFuture<TResult>&& future)
+        {
+            future.Promote();
+            return std::move(future);
+        }
+
+        template<class TResult, class TState>
+        void FutureHelper::Forward(BasicFuture<TResult>&& future, StatePtr<TState>&& target)
+        {
+            ForwardFromState(std::move(future), std::move(target));
+        }
+
+        template<class TResult, class TState>
+        void FutureHelper::Forward(UniqueFuture<TResult>&& future, StatePtr<TState>&& target)
+        {
+            if (future._ready.HasResult())
+            {
+                SetResultFromFuture(*target, future);
+                return;
+            }
+
+            ForwardFromState(std::move(future), std::move(target));
+        }
+
+        template<class TFuture, class TState>
+        void FutureHelper::ForwardFromState(TFuture&& future, StatePtr<TState>&& target)
+        {
+            // the callback owns the future (and so its State) until the State completes, and
+            // usually fits in the State's inline continuation slot.
+            auto& state = *future._state;
+            SetCallback(state, [target = std::move(target), future = std::move(future)]() mutable
+            {
+                SetResultFromFuture(*target, future);
+            }, static_cast<const std::decay_t<TFuture>*>(nullptr));
+        }
+
+        template<class TState, class TFuture>
+        void FutureHelper::SetResultFromFuture(TState& state, TFuture& future)
         {
-            auto innerState = FutureHelper::GetState(future);
-            if (innerState->HasException())
+            if (FutureHelper::HasException(future))
             {
-                state.SetException(innerState->GetException());
+                state.SetException(FutureHelper::GetException(future));
                 return;
             }
 
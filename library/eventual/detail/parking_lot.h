@@ -0,0 +1,111 @@
+#pragma once
+
+// The MIT License(MIT)
+// 
+// Copyright(c) 2016 Ryan Ferraro
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "allocation.h"
+
+namespace eventual
+{
+    namespace detail
+    {
+        // Blocking waits on States go through a fixed table of mutexes and condition variables,
+        // chosen by the address of the State, rather than through a pair embedded in every
+        // State: most States are only ever consumed by a continuation, and should not pay for
+        // them. A waiter locks its bucket, publishes that it is waiting (see StatusWaiting) and
+        // waits on the bucket's condition; the completing thread locks the same bucket before
+        // notifying, so that the notification cannot fall between a waiter's check and its wait.
+        // States that share a bucket wake each other's waiters, which then recheck their own.
+        class ParkingLot
+        {
+            static constexpr std::size_t BucketCount = 256;
+
+            struct Waiters
+            {
+                std::mutex Mutex;
+                std::condition_variable Condition;
+            };
+
+            using Bucket = CacheLinePadded<Waiters>;
+
+        public:
+
+            using unique_lock = std::unique_lock<std::mutex>;
+
+            // locks the bucket of 'address'.
+            static unique_lock Lock(const void* address)
+            {
+                return unique_lock(BucketOf(address).Mutex);
+            }
+
+            // 'lock' must be the lock of the bucket of 'address'.
+            template<class Predicate>
+            static void Wait(const void* address, unique_lock& lock, Predicate&& ready)
+            {
+                BucketOf(address).Condition.wait(lock, std::forward<Predicate>(ready));
+            }
+
+            template<class TDuration, class Predicate>
+            static bool Wait_For(const void* address, unique_lock& lock, const TDuration& rel_time, Predicate&& ready)
+            {
+                return BucketOf(address).Condition.wait_for(lock, rel_time, std::forward<Predicate>(ready));
+            }
+
+            template<class TTime, class Predicate>
+            static bool Wait_Until(const void* address, unique_lock& lock, const TTime& abs_time, Predicate&& ready)
+            {
+                return BucketOf(address).Condition.wait_until(lock, abs_time, std::forward<Predicate>(ready));
+            }
+
+            // wakes every thread waiting on the bucket of 'address'.
+            static void NotifyAll(const void* address)
+            {
+                auto& bucket = BucketOf(address);
+                {
+                    std::lock_guard<std::mutex> lock(bucket.Mutex);
+                }
+
+                bucket.Condition.notify_all();
+            }
+
+        private:
+
+            static Waiters& BucketOf(const void* address)
+            {
+                // never destroyed: a thread may wait on a State during static destruction
+                static Bucket* buckets = new Bucket[BucketCount];
+
+                // States are at least 16 byte aligned; mix the remaining bits (Fibonacci hashing)
+                auto key = reinterpret_cast<std::uintptr_t>(address) >> 4;
+                auto index = static_cast<std::size_t>((std::uint64_t(key) * 0x9E3779B97F4A7C15ull) >> 56);
+
+                return buckets[index % BucketCount].Value;
+            }
+        };
+    }
+}
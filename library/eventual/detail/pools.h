@@ -0,0 +1,253 @@
+#pragma once
+
+// The MIT License(MIT)
+// 
+// Copyright(c) 2016 Ryan Ferraro
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstddef>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "allocation.h"
+
+namespace eventual
+{
+    namespace detail
+    {
+        // The free lists behind the pool resources: one per size class, up to the largest pooled
+        // block. The classes are multiples of max_align_t's alignment (the Granule): the first four
+        // are 1 to 4 granules, and every power-of-two octave above them is split into four quarter
+        // steps (80, 96, 112, 128, 160, ... with a 16 byte granule), so a block larger than that
+        // wastes less than a fifth of itself: a State<int> of 144 bytes takes a 160 byte block
+        // rather than a 256 byte one. Each list is refilled with a chunk taken from upstream,
+        // holding twice as many blocks as the last one (up to a limit). Blocks that are larger, or
+        // more strictly aligned than max_align_t, go straight to upstream.
+        class SizeClassPools
+        {
+            using size_t = std::size_t;
+            using max_align_t = std::max_align_t;
+
+            struct Block
+            {
+                Block* Next;
+            };
+
+            struct Chunk
+            {
+                Chunk* Next;
+                size_t Size;
+            };
+
+            struct Pool
+            {
+                Block* Free;
+                Chunk* Chunks;
+                size_t NextBlockCount;
+            };
+
+            // the blocks of a chunk follow its header, at max_align_t alignment
+            static constexpr size_t HeaderSize =
+                (sizeof(Chunk) + alignof(max_align_t) - 1) / alignof(max_align_t) * alignof(max_align_t);
+
+            static constexpr size_t FirstBlockCount = 8;
+
+        public:
+
+            static constexpr size_t Granule = alignof(max_align_t);
+            static constexpr size_t MaxBlockSize = size_t(1) << 16;
+            static constexpr size_t MaxBlocksPerChunk = size_t(1) << 16;
+
+            static constexpr size_t DefaultLargestBlock = 1024;
+            static constexpr size_t DefaultBlocksPerChunk = 256;
+
+            // zero selects the default for either limit.
+            SizeClassPools(memory_resource* upstream, size_t largestBlock, size_t maxBlocksPerChunk)
+                : _upstream(upstream),
+                  _maxBlocksPerChunk(maxBlocksPerChunk ? maxBlocksPerChunk : size_t(DefaultBlocksPerChunk))
+            {
+                assert(_upstream);
+
+                largestBlock = largestBlock ? largestBlock : size_t(DefaultLargestBlock);
+                largestBlock = std::min(largestBlock, size_t(MaxBlockSize));
+
+                _largestBlock = BlockSize(ClassOf(largestBlock));
+
+                _maxBlocksPerChunk = std::min(_maxBlocksPerChunk, size_t(MaxBlocksPerChunk));
+
+                const Pool empty = { nullptr, nullptr, std::min(size_t(FirstBlockCount), _maxBlocksPerChunk) };
+                _pools.assign(ClassOf(_largestBlock) + 1, empty);
+            }
+
+            SizeClassPools(const SizeClassPools&) = delete;
+            SizeClassPools& operator=(const SizeClassPools&) = delete;
+
+            ~SizeClassPools()
+            {
+                Release();
+            }
+
+            memory_resource* Upstream() const { return _upstream; }
+            size_t LargestBlock() const { return _largestBlock; }
+            size_t BlocksPerChunk() const { return _maxBlocksPerChunk; }
+
+            bool IsPooled(size_t bytes, size_t alignment) const
+            {
+                return bytes <= _largestBlock && alignment <= alignof(max_align_t);
+            }
+
+            void* Allocate(size_t bytes, size_t alignment)
+            {
+                if (!IsPooled(bytes, alignment))
+                    return _upstream->allocate(bytes, alignment);
+
+                const auto index = ClassOf(bytes);
+                auto& pool = _pools[index];
+
+                if (!pool.Free)
+                    Refill(pool, BlockSize(index));
+
+                auto block = pool.Free;
+                pool.Free = block->Next;
+
+                return block;
+            }
+
+            void Deallocate(void* p, size_t bytes, size_t alignment) noexcept
+            {
+                if (!IsPooled(bytes, alignment))
+                {
+                    _upstream->deallocate(p, bytes, alignment);
+                    return;
+                }
+
+                auto& pool = _pools[ClassOf(bytes)];
+
+                auto block = static_cast<Block*>(p);
+                block->Next = pool.Free;
+                pool.Free = block;
+            }
+
+            // returns every chunk to upstream; blocks that went straight to upstream are not tracked.
+            void Release() noexcept
+            {
+                for (auto& pool : _pools)
+                {
+                    while (pool.Chunks)
+                    {
+                        auto chunk = pool.Chunks;
+                        pool.Chunks = chunk->Next;
+
+                        _upstream->deallocate(chunk, chunk->Size, alignof(max_align_t));
+                    }
+
+                    pool.Free = nullptr;
+                    pool.NextBlockCount = std::min(size_t(FirstBlockCount), _maxBlocksPerChunk);
+                }
+            }
+
+        private:
+
+            static_assert(Granule >= sizeof(Block) && (Granule & (Granule - 1)) == 0,
+                "A granule must hold a free list link, and be a power of two.");
+
+            // the octave of the first quarter-step classes: above 2^2 granules
+            static constexpr size_t FirstOctave = 2;
+
+            static size_t FloorLog2(size_t value)
+            {
+                assert(value > 0);
+
+#if defined(_MSC_VER)
+                unsigned long bit;
+    #if defined(_WIN64)
+                _BitScanReverse64(&bit, value);
+    #else
+                _BitScanReverse(&bit, static_cast<unsigned long>(value));
+    #endif
+                return bit;
+#else
+                return sizeof(unsigned long long) * CHAR_BIT - 1 - __builtin_clzll(value);
+#endif
+            }
+
+            static size_t BlockSize(size_t index)
+            {
+                if (index < 4)
+                    return (index + 1) * Granule;
+
+                const auto octave = FirstOctave + (index - 4) / 4;
+                const auto step = (index - 4) % 4 + 1;
+
+                return (Granule << octave) + step * (Granule << (octave - 2));
+            }
+
+            // the smallest class that holds 'bytes' (which also meets any alignment up to max_align_t).
+            static size_t ClassOf(size_t bytes)
+            {
+                const auto granules = (std::max(bytes, size_t(1)) + Granule - 1) / Granule;
+                if (granules <= 4)
+                    return granules - 1;
+
+                // 2^octave < granules <= 2^(octave + 1), in steps of 2^(octave - 2) granules
+                const auto octave = FloorLog2(granules - 1);
+                const auto offset = granules - (size_t(1) << octave);
+                const auto step = (offset + (size_t(1) << (octave - 2)) - 1) >> (octave - 2);
+
+                return 4 + (octave - FirstOctave) * 4 + (step - 1);
+            }
+
+            // chunks are aligned to max_align_t, and every class is a multiple of it, so every
+            // block is aligned to max_align_t.
+            void Refill(Pool& pool, size_t blockSize)
+            {
+                const auto count = pool.NextBlockCount;
+                const auto size = HeaderSize + count * blockSize;
+
+                auto chunk = static_cast<Chunk*>(_upstream->allocate(size, alignof(max_align_t)));
+                chunk->Next = pool.Chunks;
+                chunk->Size = size;
+                pool.Chunks = chunk;
+
+                auto blocks = reinterpret_cast<char*>(chunk) + HeaderSize;
+                for (auto i = count; i > 0; --i)
+                {
+                    auto block = reinterpret_cast<Block*>(blocks + (i - 1) * blockSize);
+                    block->Next = pool.Free;
+                    pool.Free = block;
+                }
+
+                pool.NextBlockCount = std::min(count * 2, _maxBlocksPerChunk);
+            }
+
+            memory_resource* _upstream;
+            size_t _largestBlock;
+            size_t _maxBlocksPerChunk;
+            std::vector<Pool> _pools;
+        };
+    }
+}
@@ -0,0 +1,465 @@
+#pragma once
+
+// The MIT License(MIT)
+// 
+// Copyright(c) 2016 Ryan Ferraro
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "allocation.h"
+
+namespace eventual
+{
+    namespace detail
+    {
+        // The pools behind thread_caching_resource. Each thread that uses the pools gets a cache
+        // of its own, holding a free list per size class (one class per max_align_t multiple, so
+        // each State<T> has a list for its exact size). A block is carved from a chunk owned by
+        // the cache that allocated it; the chunks are ChunkSize aligned, so a block's owner is
+        // found by masking its address.
+        //
+        // A block freed by its owner's thread goes straight back on that thread's free list. One
+        // freed by another thread is gathered into a batch, and the whole batch is pushed onto
+        // the owner's inbound list (a lock-free stack) with a single CAS; the owner takes the
+        // stack whenever its own list runs dry. The cache of a thread that exits is orphaned,
+        // and adopted by the next thread to use the pools.
+        //
+        // A thread may still use the pools after its registry of caches is destroyed (e.g. when
+        // another thread_local releases a State on exit). It then goes through the lock: a block
+        // is pushed straight onto its owner's inbound list, and one is allocated from a cache
+        // kept by the pools for such threads.
+        class ThreadCachingPools
+        {
+            using size_t = std::size_t;
+            using max_align_t = std::max_align_t;
+
+        public:
+
+            static constexpr size_t Granularity = alignof(max_align_t);
+            static constexpr size_t LargestBlock = 1024;
+            static constexpr size_t ClassCount = LargestBlock / Granularity;
+            static constexpr size_t BatchSize = 32;
+
+            static constexpr size_t ChunkSize = 16 * 1024;
+            static constexpr size_t ChunksPerSlab = 16;
+
+        private:
+
+            class Cache;
+
+            struct Block
+            {
+                Block* Next;
+            };
+
+            struct Chunk
+            {
+                Cache* Owner;
+                Chunk* Next;
+            };
+
+            // the blocks of a chunk follow its header, on a cache line of their own
+            static constexpr size_t HeaderSize = CacheLineSize;
+
+            // blocks freed by this thread that are owned by another cache
+            struct Batch
+            {
+                Cache* Owner;
+                Block* Head;
+                Block* Tail;
+                size_t Count;
+            };
+
+            // only ever touched by the thread that holds the cache
+            struct SizeClass
+            {
+                Block* Free;
+                char* Next;
+                char* End;
+                Batch Pending;
+            };
+
+            class Cache
+            {
+            public:
+
+                Cache() : Orphaned(false)
+                {
+                    for (auto& sizeClass : Classes)
+                        sizeClass = { nullptr, nullptr, nullptr, { nullptr, nullptr, nullptr, 0 } };
+
+                    for (auto& inbound : Inbound)
+                        inbound.Value.store(nullptr, std::memory_order_relaxed);
+                }
+
+                SizeClass Classes[ClassCount];
+
+                // pushed to by other threads; each on a line of its own
+                CacheLinePadded<std::atomic<Block*>> Inbound[ClassCount];
+
+                // guarded by the pools' mutex
+                bool Orphaned;
+            };
+
+            // shared with the thread-local registry, so that a thread that outlives the pools
+            // can see that they are gone.
+            struct Shared
+            {
+                explicit Shared(memory_resource* upstream)
+                    : Upstream(upstream), Alive(true), FreeChunks(nullptr)
+                { }
+
+                std::mutex Mutex;
+                memory_resource* Upstream;
+                std::atomic<bool> Alive;
+                std::vector<std::unique_ptr<Cache>> Caches;
+                std::vector<void*> Slabs;
+                Chunk* FreeChunks;
+
+                // used, under the mutex, by threads whose registry is gone
+                std::unique_ptr<Cache> Unregistered;
+            };
+
+            // the caches held by the current thread, released when it exits.
+            class Registry
+            {
+                struct Entry
+                {
+                    std::shared_ptr<Shared> Pools;
+                    Cache* Held;
+                };
+
+            public:
+
+                ~Registry()
+                {
+                    Destroyed() = true;
+
+                    for (auto& entry : _entries)
+                        Detach(*entry.Pools, entry.Held);
+                }
+
+                // set once the thread's registry is destroyed; being trivially destructible, it
+                // can still be read by whatever runs after it on thread exit.
+                static bool& Destroyed()
+                {
+                    static thread_local bool destroyed = false;
+                    return destroyed;
+                }
+
+                Cache* Find(const Shared* pools)
+                {
+                    if (!_entries.empty() && _entries.front().Pools.get() == pools)
+                        return _entries.front().Held;
+
+                    for (auto& entry : _entries)
+                    {
+                        if (entry.Pools.get() == pools)
+                        {
+                            std::swap(entry, _entries.front());
+                            return _entries.front().Held;
+                        }
+                    }
+
+                    return nullptr;
+                }
+
+                Cache* Attach(const std::shared_ptr<Shared>& pools)
+                {
+                    _entries.erase(std::remove_if(_entries.begin(), _entries.end(),
+                        [](const Entry& entry) { return !entry.Pools->Alive.load(std::memory_order_acquire); }),
+                        _entries.end());
+
+                    _entries.reserve(_entries.size() + 1);
+
+                    auto held = ThreadCachingPools::Attach(*pools);
+                    _entries.insert(_entries.begin(), { pools, held });
+
+                    return held;
+                }
+
+            private:
+                std::vector<Entry> _entries;
+            };
+
+        public:
+
+            explicit ThreadCachingPools(memory_resource* upstream)
+                : _shared(std::make_shared<Shared>(upstream))
+            {
+                assert(upstream);
+            }
+
+            ThreadCachingPools(const ThreadCachingPools&) = delete;
+            ThreadCachingPools& operator=(const ThreadCachingPools&) = delete;
+
+            // returns every slab to upstream; threads that still hold a cache let go of it on exit.
+            ~ThreadCachingPools()
+            {
+                std::lock_guard<std::mutex> lock(_shared->Mutex);
+
+                _shared->Alive.store(false, std::memory_order_release);
+
+                for (auto slab : _shared->Slabs)
+                    _shared->Upstream->deallocate(slab, ChunkSize * ChunksPerSlab, ChunkSize);
+
+                _shared->Slabs.clear();
+                _shared->FreeChunks = nullptr;
+            }
+
+            memory_resource* Upstream() const { return _shared->Upstream; }
+
+            void* Allocate(size_t bytes, size_t alignment)
+            {
+                if (!IsPooled(bytes, alignment))
+                {
+                    std::lock_guard<std::mutex> lock(_shared->Mutex);
+                    return _shared->Upstream->allocate(bytes, alignment);
+                }
+
+                const auto index = ClassOf(bytes);
+                if (auto cache = GetCache())
+                    return Take(*cache, index, false);
+
+                std::lock_guard<std::mutex> lock(_shared->Mutex);
+                if (!_shared->Unregistered)
+                    _shared->Unregistered = std::make_unique<Cache>();
+
+                return Take(*_shared->Unregistered, index, true);
+            }
+
+            void Deallocate(void* p, size_t bytes, size_t alignment)
+            {
+                if (!IsPooled(bytes, alignment))
+                {
+                    std::lock_guard<std::mutex> lock(_shared->Mutex);
+                    _shared->Upstream->deallocate(p, bytes, alignment);
+                    return;
+                }
+
+                const auto index = ClassOf(bytes);
+                auto owner = ChunkOf(p)->Owner;
+                auto cache = GetCache();
+                auto block = static_cast<Block*>(p);
+
+                if (!cache)
+                {
+                    // a batch of one, pushed without waiting for more
+                    Batch single = { owner, block, block, 1 };
+                    Flush(single, index);
+                    return;
+                }
+
+                if (owner == cache)
+                {
+                    auto& sizeClass = cache->Classes[index];
+                    block->Next = sizeClass.Free;
+                    sizeClass.Free = block;
+                    return;
+                }
+
+                auto& batch = cache->Classes[index].Pending;
+                if (batch.Owner != owner)
+                {
+                    Flush(batch, index);
+                    batch.Owner = owner;
+                }
+
+                block->Next = batch.Head;
+                batch.Head = block;
+                if (!batch.Tail)
+                    batch.Tail = block;
+
+                if (++batch.Count == BatchSize)
+                    Flush(batch, index);
+            }
+
+        private:
+
+            static size_t BlockSize(size_t index)
+            {
+                return (index + 1) * Granularity;
+            }
+
+            static size_t ClassOf(size_t bytes)
+            {
+                return (std::max<size_t>(bytes, 1) + Granularity - 1) / Granularity - 1;
+            }
+
+            static bool IsPooled(size_t bytes, size_t alignment)
+            {
+                return bytes <= LargestBlock && alignment <= Granularity;
+            }
+
+            static Chunk* ChunkOf(void* p)
+            {
+                return reinterpret_cast<Chunk*>(reinterpret_cast<std::uintptr_t>(p) & ~std::uintptr_t(ChunkSize - 1));
+            }
+
+            static Registry& GetRegistry()
+            {
+                static thread_local Registry registry;
+                return registry;
+            }
+
+            // null once the thread's registry is destroyed.
+            Cache* GetCache()
+            {
+                if (Registry::Destroyed())
+                    return nullptr;
+
+                auto& registry = GetRegistry();
+                if (auto cache = registry.Find(_shared.get()))
+                    return cache;
+
+                return registry.Attach(_shared);
+            }
+
+            // adopts an orphaned cache, or creates one.
+            static Cache* Attach(Shared& pools)
+            {
+                std::lock_guard<std::mutex> lock(pools.Mutex);
+
+                for (auto& cache : pools.Caches)
+                {
+                    if (cache->Orphaned)
+                    {
+                        cache->Orphaned = false;
+                        return cache.get();
+                    }
+                }
+
+                pools.Caches.reserve(pools.Caches.size() + 1);
+                pools.Caches.push_back(std::make_unique<Cache>());
+
+                return pools.Caches.back().get();
+            }
+
+            // sends the thread's pending batches on, and leaves its cache for the next thread.
+            static void Detach(Shared& pools, Cache* cache)
+            {
+                std::lock_guard<std::mutex> lock(pools.Mutex);
+
+                if (!pools.Alive.load(std::memory_order_relaxed))
+                    return;
+
+                for (size_t index = 0; index < ClassCount; ++index)
+                    Flush(cache->Classes[index].Pending, index);
+
+                cache->Orphaned = true;
+            }
+
+            static void Flush(Batch& batch, size_t index)
+            {
+                if (!batch.Head)
+                    return;
+
+                auto& inbound = batch.Owner->Inbound[index].Value;
+
+                auto head = inbound.load(std::memory_order_relaxed);
+                do
+                {
+                    batch.Tail->Next = head;
+                } while (!inbound.compare_exchange_weak(head, batch.Head, std::memory_order_release, std::memory_order_relaxed));
+
+                batch = { nullptr, nullptr, nullptr, 0 };
+            }
+
+            // 'locked' if the pools' mutex is already held.
+            void* Take(Cache& cache, size_t index, bool locked)
+            {
+                auto& sizeClass = cache.Classes[index];
+
+                if (!sizeClass.Free)
+                    sizeClass.Free = cache.Inbound[index].Value.exchange(nullptr, std::memory_order_acquire);
+
+                if (!sizeClass.Free)
+                    return Carve(cache, sizeClass, BlockSize(index), locked);
+
+                auto block = sizeClass.Free;
+                sizeClass.Free = block->Next;
+
+                return block;
+            }
+
+            void* Carve(Cache& cache, SizeClass& sizeClass, size_t blockSize, bool locked)
+            {
+                if (static_cast<size_t>(sizeClass.End - sizeClass.Next) < blockSize)
+                {
+                    auto chunk = locked ? TakeChunkLocked(cache) : TakeChunk(cache);
+                    sizeClass.Next = reinterpret_cast<char*>(chunk) + HeaderSize;
+                    sizeClass.End = reinterpret_cast<char*>(chunk) + ChunkSize;
+                }
+
+                auto block = sizeClass.Next;
+                sizeClass.Next += blockSize;
+
+                return block;
+            }
+
+            Chunk* TakeChunk(Cache& owner)
+            {
+                std::lock_guard<std::mutex> lock(_shared->Mutex);
+                return TakeChunkLocked(owner);
+            }
+
+            // lock must be held
+            Chunk* TakeChunkLocked(Cache& owner)
+            {
+                if (!_shared->FreeChunks)
+                    AddSlab();
+
+                auto chunk = _shared->FreeChunks;
+                _shared->FreeChunks = chunk->Next;
+                chunk->Owner = &owner;
+
+                return chunk;
+            }
+
+            // lock must be held
+            void AddSlab()
+            {
+                _shared->Slabs.reserve(_shared->Slabs.size() + 1);
+
+                auto slab = static_cast<char*>(_shared->Upstream->allocate(ChunkSize * ChunksPerSlab, ChunkSize));
+                _shared->Slabs.push_back(slab);
+
+                for (auto i = ChunksPerSlab; i > 0; --i)
+                {
+                    auto chunk = reinterpret_cast<Chunk*>(slab + (i - 1) * ChunkSize);
+                    chunk->Owner = nullptr;
+                    chunk->Next = _shared->FreeChunks;
+                    _shared->FreeChunks = chunk;
+                }
+            }
+
+            std::shared_ptr<Shared> _shared;
+        };
+    }
+}
@@ -41,6 +41,7 @@ namespace eventual
     namespace detail
     {
         template <class T> class State;
+        template <class TState> class StatePtr;
         template <class T> class StateNotificationShim;
 
         template<class TFunctor, class R, class... ArgTypes> class BasicTask;
@@ -62,6 +63,24 @@ namespace eventual
         template<class R>
         struct is_future<shared_future<R>> : std::true_type { };
 
+        template<class... R>
+        struct are_futures : std::true_type { };
+
+        template<class R, class... ROther>
+        struct are_futures<R, ROther...>
+            : std::integral_constant<bool, is_future<std::decay_t<R>>::value && are_futures<ROther...>::value>
+        { };
+
+        // see the description of the Executor concept in eventual.h
+        template<class E, class = void>
+        struct is_executor : std::false_type { };
+
+        template<class E>
+        struct is_executor<E, void_t<decltype(std::declval<E&>().execute(std::declval<void(*)()>()))>> : std::true_type { };
+
+        template<class E>
+        using enable_if_executor_t = std::enable_if_t<is_executor<E>::value>;
+
         template<class T>
         using enable_if_future_t = std::enable_if_t<is_future<T>::value, T>;
 
@@ -175,7 +194,7 @@ namespace eventual
         struct get_state
         {
             typedef State<unit_from_type_t<T>> state_type;
-            typedef std::shared_ptr<state_type> shared_type;
+            typedef StatePtr<state_type> shared_type;
         };
 
         template<template<typename> class TFuture, class T>
@@ -185,12 +204,19 @@ namespace eventual
             typedef typename get_state<T>::state_type child_state_type;
 
             typedef CompositeState<parent_state_type, child_state_type> state_type;
-            typedef std::shared_ptr<state_type> shared_type;
+            typedef StatePtr<state_type> shared_type;
         };
 
         template<class T>
         using get_state_t = typename get_state<T>::state_type;
 
+        // the future returned by each iteration of a loop (see repeat_until).
+        template<class Body>
+        using loop_future_t = std::decay_t<decltype(std::declval<std::decay_t<Body>&>()())>;
+
+        template<class Body>
+        using loop_unit_t = typename get_future_unit<loop_future_t<Body>>::type;
+
         template<class T>
         using get_composite_t = typename get_state<T>::composite_type;
 
@@ -24,6 +24,7 @@
 
 #include <type_traits>
 #include <tuple>
+#include <vector>
 #include <future>
 #include <exception>
 
@@ -54,6 +55,13 @@ namespace eventual
             //do nothing
         }
 
+        template<class T, class Alloc, typename Func>
+        void for_each(std::vector<T, Alloc>& sequence, Func&& func)
+        {
+            for (auto& item : sequence)
+                func(item);
+        }
+
         inline std::future_error CreateFutureError(std::future_errc error)
         {
             return std::future_error(error);
@@ -77,7 +85,7 @@ namespace eventual
         static detail::enable_if_uses_allocator_t<TFunctor, Allocator>
             CreateFunctor(const Allocator& alloc, TCallable&& function)
         {
-            //todo: C++ 17 removes erased allocators for std::function...
+            // e.g. a unique_function, which allocates a callable that does not fit in place
             return TFunctor(std::allocator_arg_t(), alloc, std::forward<TCallable>(function));
         }
 
@@ -85,8 +93,7 @@ namespace eventual
         static detail::enable_if_doesnt_use_allocator_t<TFunctor, Allocator>
             CreateFunctor(const Allocator&, TCallable&& function)
         {
-            //todo: C++ 17 removes erased allocators for std::function...
-            // because libstdc++'s std::function doesn't support custom allocation...
+            // e.g. the callable itself, held in place by the task
             return TFunctor(std::forward<TCallable>(function));
         }
     }
@@ -0,0 +1,150 @@
+#pragma once
+
+// The MIT License(MIT)
+// 
+// Copyright(c) 2016 Ryan Ferraro
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <thread>
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace eventual
+{
+    // How a thread waits for a future that is not yet ready: it spins for up to spin_time,
+    // then yields its time slice for up to yield_time, and only then blocks. A blocking wait
+    // costs two context switches (the waiter's sleep and its wake-up), which dwarf a result
+    // that is only microseconds away; spinning avoids them at the cost of a busy core.
+    class wait_strategy
+    {
+    public:
+
+        constexpr wait_strategy(std::chrono::nanoseconds spin_time, std::chrono::nanoseconds yield_time) noexcept
+            : _spinNanoseconds(Clamp(spin_time)), _yieldNanoseconds(Clamp(yield_time))
+        { }
+
+        // blocks straight away; the behavior of std::future.
+        static constexpr wait_strategy block() noexcept
+        {
+            return wait_strategy(std::chrono::nanoseconds(0), std::chrono::nanoseconds(0));
+        }
+
+        // yields for up to 'yield_time', then blocks.
+        static constexpr wait_strategy yield(std::chrono::nanoseconds yield_time) noexcept
+        {
+            return wait_strategy(std::chrono::nanoseconds(0), yield_time);
+        }
+
+        // spins for up to 'spin_time', then blocks.
+        static constexpr wait_strategy spin(std::chrono::nanoseconds spin_time) noexcept
+        {
+            return wait_strategy(spin_time, std::chrono::nanoseconds(0));
+        }
+
+        // spins briefly (unless there is a single hardware thread, where a spinning waiter
+        // only delays the thread it waits for), then yields, then blocks. The default.
+        static wait_strategy adaptive() noexcept
+        {
+            static const wait_strategy strategy(
+                std::thread::hardware_concurrency() > 1 ? std::chrono::nanoseconds(2000) : std::chrono::nanoseconds(0),
+                std::chrono::nanoseconds(20000));
+
+            return strategy;
+        }
+
+        constexpr std::chrono::nanoseconds spin_time() const noexcept { return std::chrono::nanoseconds(_spinNanoseconds); }
+        constexpr std::chrono::nanoseconds yield_time() const noexcept { return std::chrono::nanoseconds(_yieldNanoseconds); }
+
+        constexpr bool blocks_immediately() const noexcept { return _spinNanoseconds == 0 && _yieldNanoseconds == 0; }
+
+    private:
+
+        static constexpr std::uint32_t Clamp(std::chrono::nanoseconds time) noexcept
+        {
+            return time.count() <= 0 ? 0
+                : time.count() >= std::numeric_limits<std::uint32_t>::max() ? std::numeric_limits<std::uint32_t>::max()
+                : static_cast<std::uint32_t>(time.count());
+        }
+
+        std::uint32_t _spinNanoseconds;
+        std::uint32_t _yieldNanoseconds;
+    };
+
+    namespace detail
+    {
+        // tells the core that this is a spin loop, so that it yields its pipeline to a sibling
+        // hyper-thread and does not mispredict the loop's exit.
+        inline void CpuRelax() noexcept
+        {
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+            _mm_pause();
+#elif defined(__aarch64__)
+            asm volatile("yield" ::: "memory");
+#endif
+        }
+
+        // Runs the spinning and yielding phases of 'strategy' until 'ready' returns true, or the
+        // phases are over, or 'expired' returns true (a deadline of the wait); returns whether
+        // 'ready' returned true. The clock is only read every few iterations of the spin.
+        template<class Ready, class Expired>
+        bool SpinUntil(const wait_strategy& strategy, Ready&& ready, Expired&& expired)
+        {
+            using clock = std::chrono::steady_clock;
+
+            if (strategy.blocks_immediately())
+                return false;
+
+            auto start = clock::now();
+            auto spinEnd = start + strategy.spin_time();
+            auto yieldEnd = spinEnd + strategy.yield_time();
+
+            if (strategy.spin_time().count() != 0)
+            {
+                for (unsigned i = 1;; ++i)
+                {
+                    if (ready())
+                        return true;
+
+                    if ((i % 64) == 0 && (clock::now() >= spinEnd || expired()))
+                        break;
+
+                    CpuRelax();
+                }
+            }
+
+            while (clock::now() < yieldEnd && !expired())
+            {
+                std::this_thread::yield();
+                if (ready())
+                    return true;
+            }
+
+            return ready();
+        }
+    }
+}
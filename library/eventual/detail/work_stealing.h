@@ -0,0 +1,180 @@
+#pragma once
+
+// The MIT License(MIT)
+// 
+// Copyright(c) 2016 Ryan Ferraro
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "allocation.h"
+
+namespace eventual
+{
+    namespace detail
+    {
+        // A Chase-Lev work-stealing deque of pointers, after "Correct and Efficient Work-Stealing
+        // for Weak Memory Models" (Le, Pop, Cohen and Zappa Nardelli). Only the owning thread may
+        // Push and Pop (LIFO, at the bottom); any thread may Steal (FIFO, from the top). Pop and
+        // Steal return nullptr when the deque is empty, or when they lose the race for its last item.
+        template<class T>
+        class WorkStealingDeque
+        {
+            static_assert(std::is_pointer<T>::value, "WorkStealingDeque holds pointers.");
+
+            class Buffer
+            {
+            public:
+
+                explicit Buffer(std::int64_t capacity)
+                    : _mask(capacity - 1),
+                      _items(new std::atomic<T>[static_cast<std::size_t>(capacity)])
+                { }
+
+                std::int64_t Capacity() const { return _mask + 1; }
+
+                T Get(std::int64_t index) const
+                {
+                    return _items[index & _mask].load(std::memory_order_relaxed);
+                }
+
+                void Put(std::int64_t index, T item)
+                {
+                    _items[index & _mask].store(item, std::memory_order_relaxed);
+                }
+
+                std::unique_ptr<Buffer> Grow(std::int64_t top, std::int64_t bottom) const
+                {
+                    auto grown = std::make_unique<Buffer>(Capacity() * 2);
+                    for (auto index = top; index != bottom; ++index)
+                        grown->Put(index, Get(index));
+
+                    return grown;
+                }
+
+            private:
+                std::int64_t _mask;
+                std::unique_ptr<std::atomic<T>[]> _items;
+            };
+
+        public:
+
+            explicit WorkStealingDeque(std::int64_t capacity = 256)
+                : _buffer(nullptr)
+            {
+                _top.Value.store(0, std::memory_order_relaxed);
+                _bottom.Value.store(0, std::memory_order_relaxed);
+
+                assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+
+                _buffers.push_back(std::make_unique<Buffer>(capacity));
+                _buffer.store(_buffers.back().get(), std::memory_order_relaxed);
+            }
+
+            WorkStealingDeque(const WorkStealingDeque&) = delete;
+            WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+            // owner only
+            void Push(T item)
+            {
+                auto bottom = _bottom.Value.load(std::memory_order_relaxed);
+                auto top = _top.Value.load(std::memory_order_acquire);
+                auto buffer = _buffer.load(std::memory_order_relaxed);
+
+                if (bottom - top > buffer->Capacity() - 1)
+                {
+                    // a thief may still be reading a retired buffer; they are released with the deque.
+                    _buffers.push_back(buffer->Grow(top, bottom));
+                    buffer = _buffers.back().get();
+                    _buffer.store(buffer, std::memory_order_release);
+                }
+
+                buffer->Put(bottom, item);
+                _bottom.Value.store(bottom + 1, std::memory_order_release);
+            }
+
+            // owner only
+            T Pop()
+            {
+                auto bottom = _bottom.Value.load(std::memory_order_relaxed) - 1;
+                auto buffer = _buffer.load(std::memory_order_relaxed);
+                _bottom.Value.store(bottom, std::memory_order_relaxed);
+
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                auto top = _top.Value.load(std::memory_order_relaxed);
+
+                if (top > bottom)
+                {
+                    _bottom.Value.store(bottom + 1, std::memory_order_relaxed);
+                    return nullptr;
+                }
+
+                auto item = buffer->Get(bottom);
+                if (top == bottom)
+                {
+                    // the last item; the owner races the thieves for it.
+                    if (!_top.Value.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                        item = nullptr;
+
+                    _bottom.Value.store(bottom + 1, std::memory_order_relaxed);
+                }
+
+                return item;
+            }
+
+            T Steal()
+            {
+                auto top = _top.Value.load(std::memory_order_acquire);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                auto bottom = _bottom.Value.load(std::memory_order_acquire);
+
+                if (top >= bottom)
+                    return nullptr;
+
+                auto item = _buffer.load(std::memory_order_acquire)->Get(top);
+                if (!_top.Value.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    return nullptr;
+
+                return item;
+            }
+
+            // a snapshot; only exact when neither end is moving.
+            bool Empty() const
+            {
+                auto top = _top.Value.load(std::memory_order_acquire);
+                auto bottom = _bottom.Value.load(std::memory_order_acquire);
+                return bottom <= top;
+            }
+
+        private:
+
+            // the thieves' end and the owner's end live on separate cache lines.
+            CacheLinePadded<std::atomic<std::int64_t>> _top;
+            CacheLinePadded<std::atomic<std::int64_t>> _bottom;
+            std::atomic<Buffer*> _buffer;
+            std::vector<std::unique_ptr<Buffer>> _buffers;
+        };
+    }
+}
@@ -24,8 +24,11 @@
 
 #include <utility>
 #include <type_traits>
+#include <iterator>
+#include <vector>
 
 #include "detail/implementation.h"
+#include "unique_function.h"
 
 namespace eventual
 {
@@ -49,11 +52,36 @@ namespace eventual
         Sequence futures;
     };
 
+    // Executor
+    //
+    // An executor is an object 'e' for which 'e.execute(f)' accepts any nullary, move-only
+    // callable 'f' and arranges for 'f()' to be invoked exactly once (typically on another
+    // thread). then(executor, continuation), when_all(executor, ...) and when_any(executor, ...)
+    // post their continuation to 'executor' instead of running it on the thread that completes
+    // the future; the executor must outlive any continuation posted to it. An exception thrown
+    // by execute() propagates to the completing thread, as if thrown by the continuation.
+
+    template<class E>
+    struct is_executor : detail::is_executor<E> { };
+
+    // Runs each callable immediately, on the calling thread.
+    class inline_executor
+    {
+    public:
+
+        template<class F>
+        void execute(F&& f)
+        {
+            std::forward<F>(f)();
+        }
+    };
+
     template<class RType>
-    class future : public detail::BasicFuture<RType>
+    class future : public detail::UniqueFuture<RType>
     {
-        using Base = detail::BasicFuture<RType>;
+        using Base = detail::UniqueFuture<RType>;
         using SharedState = typename Base::SharedState;
+        using ReadyType = typename Base::ReadyType;
         
         friend class detail::FutureFactory;
 
@@ -72,6 +100,12 @@ namespace eventual
             return Base::ThenMove(std::forward<F>(continuation), *this);
         }
 
+        template<class Executor, class F, class = detail::enable_if_executor_t<Executor>>
+        decltype(auto) then(Executor& executor, F&& continuation)
+        {
+            return Base::ThenMove(executor, std::forward<F>(continuation), *this);
+        }
+
         RType get()
         {
             return Base::GetResult();
@@ -84,13 +118,20 @@ namespace eventual
         template<class TPromise>
         future(const TPromise& promise, detail::enable_if_not_same_t<future, TPromise, int> = 0)
             : Base(promise) { }
+
+        explicit future(SharedState&& state) noexcept
+            : Base(std::move(state)) { }
+
+        explicit future(ReadyType&& ready) noexcept
+            : Base(std::move(ready)) { }
     };
 
     template<class RType>
-    class future<RType&> : public detail::BasicFuture<RType&>
+    class future<RType&> : public detail::UniqueFuture<RType&>
     {
-        using Base = detail::BasicFuture<RType&>;
+        using Base = detail::UniqueFuture<RType&>;
         using SharedState = typename Base::SharedState;
+        using ReadyType = typename Base::ReadyType;
         
         friend class detail::FutureFactory;
 
@@ -109,6 +150,12 @@ namespace eventual
             return Base::ThenMove(std::forward<F>(continuation), *this);
         }
 
+        template<class Executor, class F, class = detail::enable_if_executor_t<Executor>>
+        decltype(auto) then(Executor& executor, F&& continuation)
+        {
+            return Base::ThenMove(executor, std::forward<F>(continuation), *this);
+        }
+
         RType& get()
         {
             return Base::GetResult();
@@ -121,13 +168,20 @@ namespace eventual
         template<class TPromise>
         future(const TPromise& promise, detail::enable_if_not_same_t<future, TPromise, int> = 0)
             : Base(promise) { }
+
+        explicit future(SharedState&& state) noexcept
+            : Base(std::move(state)) { }
+
+        explicit future(ReadyType&& ready) noexcept
+            : Base(std::move(ready)) { }
     };
 
     template<>
-    class future<void> : public detail::BasicFuture<void>
+    class future<void> : public detail::UniqueFuture<void>
     {
-        using Base = detail::BasicFuture<void>;
+        using Base = detail::UniqueFuture<void>;
         using SharedState = typename Base::SharedState;
+        using ReadyType = typename Base::ReadyType;
         
         friend class detail::FutureFactory;
 
@@ -146,6 +200,12 @@ namespace eventual
             return Base::ThenMove(std::forward<F>(continuation), *this);
         }
 
+        template<class Executor, class F, class = detail::enable_if_executor_t<Executor>>
+        decltype(auto) then(Executor& executor, F&& continuation)
+        {
+            return Base::ThenMove(executor, std::forward<F>(continuation), *this);
+        }
+
         void get()
         {
             Base::GetResult();
@@ -158,6 +218,12 @@ namespace eventual
         template<class TPromise>
         future(const TPromise& promise, detail::enable_if_not_same_t<future, TPromise, int> = 0)
             : Base(promise) { }
+
+        explicit future(SharedState&& state) noexcept
+            : Base(std::move(state)) { }
+
+        explicit future(ReadyType&& ready) noexcept
+            : Base(std::move(ready)) { }
     };
 
     template<class R>
@@ -174,6 +240,11 @@ namespace eventual
         template<class Alloc>
         promise(std::allocator_arg_t arg, const Alloc& alloc) : Base(arg, alloc) { }
 
+        explicit promise(const wait_strategy& strategy) : Base(strategy) { }
+
+        template<class Alloc>
+        promise(std::allocator_arg_t arg, const Alloc& alloc, const wait_strategy& strategy) : Base(arg, alloc, strategy) { }
+
         promise& operator=(const promise& rhs) = delete;
         promise& operator=(promise&& other) noexcept = default;
 
@@ -199,6 +270,11 @@ namespace eventual
         template<class Alloc>
         promise(std::allocator_arg_t arg, const Alloc& alloc) : Base(arg, alloc) { }
 
+        explicit promise(const wait_strategy& strategy) : Base(strategy) { }
+
+        template<class Alloc>
+        promise(std::allocator_arg_t arg, const Alloc& alloc, const wait_strategy& strategy) : Base(arg, alloc, strategy) { }
+
         promise& operator=(const promise& rhs) = delete;
         promise& operator=(promise&& other) noexcept = default;
 
@@ -222,6 +298,11 @@ namespace eventual
         template<class Alloc>
         promise(std::allocator_arg_t arg, const Alloc& alloc) : Base(arg, alloc) { }
 
+        explicit promise(const wait_strategy& strategy) : Base(strategy) { }
+
+        template<class Alloc>
+        promise(std::allocator_arg_t arg, const Alloc& alloc, const wait_strategy& strategy) : Base(arg, alloc, strategy) { }
+
         promise& operator=(const promise& rhs) = delete;
         promise& operator=(promise&& other) noexcept = default;
 
@@ -231,6 +312,74 @@ namespace eventual
         void set_value_at_thread_exit() { Base::SetValueAtThreadExit(detail::Unit()); }
     };
 
+    // A promise for exactly one producer and one consumer: it must not be used by several
+    // threads at once (it may be moved between them), and has no set_value_at_thread_exit.
+    // Setting it is a single atomic exchange, with no claim against other setters; its future
+    // is an ordinary future<R>, whose continuation is registered with a single compare-exchange.
+    template<class R>
+    class spsc_promise : public detail::SolePromise<R>
+    {
+        using Base = detail::SolePromise<R>;
+
+    public:
+        spsc_promise() = default;
+        spsc_promise(spsc_promise&& other) noexcept = default;
+        spsc_promise(const spsc_promise& other) = delete;
+
+        template<class Alloc>
+        spsc_promise(std::allocator_arg_t arg, const Alloc& alloc) : Base(arg, alloc) { }
+
+        spsc_promise& operator=(const spsc_promise& rhs) = delete;
+        spsc_promise& operator=(spsc_promise&& other) noexcept = default;
+
+        void swap(spsc_promise& other) noexcept { Base::swap(other); }
+
+        void set_value(const R& value) { Base::SetValue(value); }
+        void set_value(R&& value) { Base::SetValue(std::forward<R>(value)); }
+    };
+
+    template<class R>
+    class spsc_promise<R&> : public detail::SolePromise<R&>
+    {
+        using Base = detail::SolePromise<R&>;
+
+    public:
+        spsc_promise() = default;
+        spsc_promise(spsc_promise&& other) noexcept = default;
+        spsc_promise(const spsc_promise& other) = delete;
+
+        template<class Alloc>
+        spsc_promise(std::allocator_arg_t arg, const Alloc& alloc) : Base(arg, alloc) { }
+
+        spsc_promise& operator=(const spsc_promise& rhs) = delete;
+        spsc_promise& operator=(spsc_promise&& other) noexcept = default;
+
+        void swap(spsc_promise& other) noexcept { Base::swap(other); }
+
+        void set_value(R& value) { Base::SetValue(value); }
+    };
+
+    template<>
+    class spsc_promise<void> : public detail::SolePromise<void>
+    {
+        using Base = detail::SolePromise<void>;
+
+    public:
+        spsc_promise() = default;
+        spsc_promise(spsc_promise&& other) noexcept = default;
+        spsc_promise(const spsc_promise& other) = delete;
+
+        template<class Alloc>
+        spsc_promise(std::allocator_arg_t arg, const Alloc& alloc) : Base(arg, alloc) { }
+
+        spsc_promise& operator=(const spsc_promise& rhs) = delete;
+        spsc_promise& operator=(spsc_promise&& other) noexcept = default;
+
+        void swap(spsc_promise& other) noexcept { Base::swap(other); }
+
+        void set_value() { Base::SetValue(detail::Unit()); }
+    };
+
     template<class R>
     class shared_future : public detail::BasicFuture<R>
     {
@@ -241,9 +390,9 @@ namespace eventual
 
         shared_future() noexcept = default;
         shared_future(const shared_future& other) = default;
-        shared_future(future<R>&& other) noexcept : Base(std::forward<future<R>>(other)) { }
+        shared_future(future<R>&& other) noexcept : Base(detail::FutureHelper::Promote(std::forward<future<R>>(other))) { }
         shared_future(shared_future&& other) noexcept = default;
-        shared_future(future<shared_future>&& other) noexcept : Base(std::forward<future<shared_future>>(other)) { }
+        shared_future(future<shared_future>&& other) noexcept : Base(detail::FutureHelper::Promote(std::forward<future<shared_future>>(other))) { }
 
         shared_future& operator=(const shared_future& other) = default;
         shared_future& operator=(shared_future&& other) noexcept = default;
@@ -254,6 +403,12 @@ namespace eventual
             return Base::ThenShare(std::forward<F>(continuation), *this);
         }
 
+        template<class Executor, class F, class = detail::enable_if_executor_t<Executor>>
+        decltype(auto) then(Executor& executor, F&& continuation)
+        {
+            return Base::ThenShare(executor, std::forward<F>(continuation), *this);
+        }
+
         const R& get() const
         {
             return Base::GetResult();
@@ -270,9 +425,9 @@ namespace eventual
 
         shared_future() noexcept = default;
         shared_future(const shared_future& other) = default;
-        shared_future(future<R&>&& other) noexcept : Base(std::forward<future<R&>>(other)) { }
+        shared_future(future<R&>&& other) noexcept : Base(detail::FutureHelper::Promote(std::forward<future<R&>>(other))) { }
         shared_future(shared_future&& other) noexcept = default;
-        shared_future(future<shared_future>&& other) noexcept : Base(std::forward<future<shared_future>>(other)) { }
+        shared_future(future<shared_future>&& other) noexcept : Base(detail::FutureHelper::Promote(std::forward<future<shared_future>>(other))) { }
 
         shared_future& operator=(const shared_future& other) = default;
         shared_future& operator=(shared_future&& other) noexcept = default;
@@ -283,6 +438,12 @@ namespace eventual
             return Base::ThenShare(std::forward<F>(continuation), *this);
         }
 
+        template<class Executor, class F, class = detail::enable_if_executor_t<Executor>>
+        decltype(auto) then(Executor& executor, F&& continuation)
+        {
+            return Base::ThenShare(executor, std::forward<F>(continuation), *this);
+        }
+
         R& get() const
         {
             return Base::GetResult();
@@ -299,10 +460,10 @@ namespace eventual
 
         shared_future() noexcept = default;
         shared_future(const shared_future& other) = default;
-        shared_future(future<void>&& other) noexcept : Base(std::forward<future<void>>(other)) { }
+        shared_future(future<void>&& other) noexcept : Base(detail::FutureHelper::Promote(std::forward<future<void>>(other))) { }
         shared_future(shared_future&& other) noexcept = default;
 
-        shared_future(future<shared_future>&& other) noexcept : Base(std::forward<future<shared_future>>(other)) { }
+        shared_future(future<shared_future>&& other) noexcept : Base(detail::FutureHelper::Promote(std::forward<future<shared_future>>(other))) { }
 
         shared_future& operator=(const shared_future& other) = default;
         shared_future& operator=(shared_future&& other) noexcept = default;
@@ -313,6 +474,12 @@ namespace eventual
             return Base::ThenShare(std::forward<F>(continuation), *this);
         }
 
+        template<class Executor, class F, class = detail::enable_if_executor_t<Executor>>
+        decltype(auto) then(Executor& executor, F&& continuation)
+        {
+            return Base::ThenShare(executor, std::forward<F>(continuation), *this);
+        }
+
         void get() const
         {
             Base::GetResult();
@@ -320,9 +487,9 @@ namespace eventual
     };
 
     template<class R, class... ArgTypes>
-    class packaged_task<R(ArgTypes...)> : public detail::BasicTask<std::function<R(ArgTypes...)>, R, ArgTypes...>
+    class packaged_task<R(ArgTypes...)> : public detail::BasicTask<unique_function<R(ArgTypes...)>, R, ArgTypes...>
     {
-        using Base = detail::BasicTask<std::function<R(ArgTypes...)>, R, ArgTypes...>;
+        using Base = detail::BasicTask<unique_function<R(ArgTypes...)>, R, ArgTypes...>;
         using Factory = detail::FutureFactory;
 
     public:
@@ -368,32 +535,24 @@ namespace eventual
         make_ready_future(T&& value)
     {
         using result_t = detail::decay_future_result_t<T>;
-        promise<result_t> promise;
-        promise.set_value(std::forward<result_t>(value));
-        return promise.get_future();
+        return detail::FutureFactory::CreateReady<result_t>(std::forward<T>(value));
     }
 
     inline future<void> make_ready_future()
     {
-        promise<void> promise;
-        promise.set_value();
-        return promise.get_future();
+        return detail::FutureFactory::CreateReady<void>(detail::Unit());
     }
 
     template<class T>
     future<T> make_exceptional_future(std::exception_ptr ex)
     {
-        promise<T> promise;
-        promise.set_exception(ex);
-        return promise.get_future();
+        return detail::FutureFactory::CreateExceptional<T>(ex);
     }
 
     template<class T, class E>
     future<T> make_exceptional_future(E ex)
     {
-        promise<T> promise;
-        promise.set_exception(std::make_exception_ptr(ex));
-        return promise.get_future();
+        return detail::FutureFactory::CreateExceptional<T>(std::make_exception_ptr(ex));
     }
 
     template<class InputIterator>
@@ -402,112 +561,133 @@ namespace eventual
     {
         using future_vector_t = std::vector<typename std::iterator_traits<InputIterator>::value_type>;
 
-        auto vectorfuture = make_ready_future(future_vector_t());
-
-        for (auto iterator = first; iterator != last; ++iterator)
-        {
-            auto& future = *iterator;
-            vectorfuture = vectorfuture.then(
-                [future = std::move(future)](auto& vf) mutable
-            {
-                return future.then(
-                    [vf = std::move(vf)](auto& future) mutable
-                {
-                    auto resultVector = vf.get();
-                    resultVector.emplace_back(std::move(future));
-                    return resultVector;
-                });
-            });
-        }
-
-        return vectorfuture;
+        return detail::WhenAllState<future_vector_t>::Create(
+            future_vector_t(std::make_move_iterator(first), std::make_move_iterator(last)));
     }
 
     template<class... Futures>
     detail::all_futures_tuple<Futures...>
         when_all(Futures&&... futures)
     {
-        return detail::When_All_(std::forward<Futures>(futures)...);
+        using future_tuple_t = std::tuple<std::decay_t<Futures>...>;
+
+        return detail::WhenAllState<future_tuple_t>::Create(future_tuple_t(std::forward<Futures>(futures)...));
     }
 
     template<class InputIterator>
     detail::any_future_result_vector<InputIterator>
         when_any(InputIterator first, InputIterator last)
     {
-        using namespace eventual::detail;
-        using future_t = typename std::iterator_traits<InputIterator>::value_type;
-        using result_t = when_any_result<std::vector<future_t>>;
+        using future_vector_t = std::vector<typename std::iterator_traits<InputIterator>::value_type>;
+        using state_t = detail::WhenAnyState<future_vector_t>;
 
-        constexpr auto noIdx = size_t(-1);
-        auto indexPromise = std::make_shared<promise<size_t>>();
-        auto indexfuture = indexPromise->get_future();
-        std::vector<future_t> futures;
+        return state_t::Create(detail::default_strong_allocator<state_t>(),
+            future_vector_t(std::make_move_iterator(first), std::make_move_iterator(last)));
+    }
 
-        size_t index = 0;
-        for (auto iterator = first; iterator != last; ++iterator)
-        {
-            futures.emplace_back(std::move(*iterator));
+    template<class Alloc, class InputIterator>
+    detail::any_future_result_vector<InputIterator>
+        when_any(std::allocator_arg_t, const Alloc& alloc, InputIterator first, InputIterator last)
+    {
+        using future_vector_t = std::vector<typename std::iterator_traits<InputIterator>::value_type>;
+        using state_t = detail::WhenAnyState<future_vector_t>;
 
-            FutureHelper::SetCallback(futures.back(),
-                        [indexPromise, index]()
-            {
-                FutureHelper::TrySetValue(*indexPromise, index);
-            });
+        return state_t::Create(detail::strong_polymorphic_allocator<state_t>(alloc),
+            future_vector_t(std::make_move_iterator(first), std::make_move_iterator(last)));
+    }
 
-            index++;
-        }
+    template<class... Futures>
+    detail::any_futures_result_tuple<Futures...>
+        when_any(Futures&&... futures)
+    {
+        using future_tuple_t = std::tuple<std::decay_t<Futures>...>;
+        using state_t = detail::WhenAnyState<future_tuple_t>;
 
-        if (futures.empty())
-            indexPromise->set_value(noIdx);
+        return state_t::Create(detail::default_strong_allocator<state_t>(),
+            future_tuple_t(std::forward<Futures>(futures)...));
+    }
 
-        return indexfuture.then(
-            [sequence = std::move(futures)](auto& firstIndex) mutable
-        {
-            result_t result;
-            result.index = firstIndex.get();
-            result.futures = std::move(sequence);
+    template<class Alloc, class... Futures>
+    detail::any_futures_result_tuple<Futures...>
+        when_any(std::allocator_arg_t, const Alloc& alloc, Futures&&... futures)
+    {
+        using future_tuple_t = std::tuple<std::decay_t<Futures>...>;
+        using state_t = detail::WhenAnyState<future_tuple_t>;
 
-            return result;
-        });
+        return state_t::Create(detail::strong_polymorphic_allocator<state_t>(alloc),
+            future_tuple_t(std::forward<Futures>(futures)...));
     }
 
-    template<class... Futures>
-    detail::any_futures_result_tuple<Futures...>
-        when_any(Futures&&... futures)
+    inline future<when_any_result<std::tuple<>>> when_any()
     {
-        using namespace eventual::detail;
-        using result_t = when_any_result<std::tuple<std::decay_t<Futures>...>>;
+        return make_ready_future(when_any_result<std::tuple<>>());
+    }
 
-        auto futuresSequence = std::make_tuple<std::decay_t<Futures>...>(std::forward<Futures>(futures)...);
-        auto indexPromise = std::make_shared<promise<size_t>>();
-        auto indexfuture = indexPromise->get_future();
+    // Calls 'body', which returns a future, and again each time that future completes, until
+    // 'predicate' accepts its result (it is called with the result, or with no arguments for a
+    // future<void>); returns a future of the accepted result. The iterations share a single
+    // State and are not nested in one another, so a loop runs in constant memory and stack
+    // depth however long it lasts. An exception from 'body', its future or 'predicate' ends
+    // the loop, and is stored in the returned future.
+    template<class Body, class Predicate>
+    detail::future_from_unit_t<detail::loop_unit_t<Body>>
+        repeat_until(Body&& body, Predicate&& predicate)
+    {
+        using state_t = detail::LoopState<Body, Predicate>;
 
-        size_t index = 0;
-        detail::for_each(futuresSequence, [indexPromise, &index](auto& future) mutable
-        {
-            FutureHelper::SetCallback(future,
-                        [indexPromise, index]()
-            {
-                FutureHelper::TrySetValue(*indexPromise, index);
-            });
+        return state_t::Create(std::forward<Body>(body), std::forward<Predicate>(predicate));
+    }
 
-            index++;
-        });
+    // While 'condition' returns true, calls 'body' and waits for the future<void> that it
+    // returns; as repeat_until, in constant memory.
+    template<class Condition, class Body>
+    future<void> async_while(Condition&& condition, Body&& body)
+    {
+        static_assert(std::is_same<detail::loop_future_t<Body>, future<void>>::value,
+            "The body of async_while must return a future<void>.");
 
-        return indexfuture.then(
-            [sequence = std::move(futuresSequence)](auto& firstIndex) mutable
+        try
+        {
+            if (!condition())
+                return make_ready_future();
+        }
+        catch (...)
         {
-            result_t result;
-            result.index = firstIndex.get();
-            result.futures = std::move(sequence);
+            return make_exceptional_future<void>(std::current_exception());
+        }
 
-            return result;
-        });
+        return repeat_until(std::forward<Body>(body),
+            [condition = std::forward<Condition>(condition)]() mutable { return !condition(); });
     }
 
-    inline future<when_any_result<std::tuple<>>> when_any()
+    // The overloads below complete the returned future from a continuation posted to 'executor'.
+
+    template<class Executor, class InputIterator, class = detail::enable_if_executor_t<Executor>>
+    detail::all_futures_vector<InputIterator>
+        when_all(Executor& executor, InputIterator first, InputIterator last)
     {
-        return make_ready_future(when_any_result<std::tuple<>>());
+        return when_all(first, last).then(executor, [](auto& all) { return all.get(); });
+    }
+
+    template<class Executor, class... Futures, class = detail::enable_if_executor_t<Executor>>
+    detail::all_futures_tuple<Futures...>
+        when_all(Executor& executor, Futures&&... futures)
+    {
+        return when_all(std::forward<Futures>(futures)...).then(executor, [](auto& all) { return all.get(); });
+    }
+
+    template<class Executor, class InputIterator, class = detail::enable_if_executor_t<Executor>>
+    detail::any_future_result_vector<InputIterator>
+        when_any(Executor& executor, InputIterator first, InputIterator last)
+    {
+        return when_any(first, last).then(executor, [](auto& any) { return any.get(); });
+    }
+
+    template<class Executor, class... Futures, class = detail::enable_if_executor_t<Executor>>
+    detail::any_futures_result_tuple<Futures...>
+        when_any(Executor& executor, Futures&&... futures)
+    {
+        return when_any(std::forward<Futures>(futures)...).then(executor, [](auto& any) { return any.get(); });
     }
 }
 
@@ -530,6 +710,12 @@ namespace std
     {
         lhs.swap(rhs);
     }
+
+    template<class RType>
+    void swap(eventual::spsc_promise<RType> &lhs, eventual::spsc_promise<RType> &rhs) noexcept
+    {
+        lhs.swap(rhs);
+    }
 }
 
 namespace eventual
@@ -543,26 +729,29 @@ namespace eventual
         }
 
         template<class R>
-        shared_future<R> detail::BasicFuture<R>::Share(future<R>&& future)
+        shared_future<R> detail::UniqueFuture<R>::Share(future<R>&& future)
         {
             future.CheckState();
             return shared_future<R>(std::forward<eventual::future<R>>(future));
         }
 
         template<class R>
-        template<class TContinuation, class TFuture>
-        decltype(auto) detail::BasicFuture<R>::ThenImpl(TContinuation&& continuation, TFuture&& future)
+        template<class TContinuation, class TFuture, class TDispatch>
+        decltype(auto) detail::BasicFuture<R>::ThenImpl(TContinuation&& continuation, TFuture&& future, const TDispatch& dispatch)
         {
             using task_t = get_continuation_task_t<TFuture, TContinuation>;
 
             auto current = std::forward<TFuture>(future);
+
+            // an owning copy: 'current' moves into the callback, which may run (and release it) immediately.
             auto state = current.ValidateState();
-            auto allocator = state->Get_Allocator();
+            const auto& allocator = state->Get_Allocator();
 
             task_t task(std::allocator_arg_t(), allocator, std::forward<TContinuation>(continuation));
             auto taskFuture = GetUnwrappedFuture(task);
 
-            state->SetCallback(CreateCallback(std::move(task), std::move(current)));
+            FutureHelper::SetCallback(*state, dispatch(CreateCallback(std::move(task), std::move(current))),
+                static_cast<const std::decay_t<TFuture>*>(nullptr));
 
             return taskFuture;
         }
@@ -570,22 +759,27 @@ namespace eventual
         template<class R>
         future<R> detail::CommonPromise<R>::get_future() { return FutureFactory::Create(*this); }
         
-        template<class Future, class... Futures>
-        decltype(auto) When_All_(Future&& head, Futures&&... others)
+        template<class TResult, class TState>
+        future<TResult> FutureFactory::Create(StatePtr<TState>&& state)
         {
-            return When_All_(std::forward<Futures>(others)...)
-               .then([head = std::forward<Future>(head)](auto&& tf) mutable
-               {
-                  return head.then([tf = std::forward<std::decay_t<decltype(tf)>>(tf)](auto&& h) mutable
-                  {
-                      return std::tuple_cat(std::make_tuple(std::forward<Future>(h)), tf.get());
-                  });
-               });
+            // converted first, so that the promise constructor of future cannot be chosen
+            return future<TResult>(get_shared_state_t<TResult>(std::move(state)));
         }
 
-        inline future<std::tuple<>> When_All_()
+        template<class TResult, class TValue>
+        future<TResult> FutureFactory::CreateReady(TValue&& value)
+        {
+            ReadyResult<unit_from_type_t<TResult>> ready;
+            ready.SetValue(std::forward<TValue>(value));
+            return future<TResult>(std::move(ready));
+        }
+
+        template<class TResult>
+        future<TResult> FutureFactory::CreateExceptional(std::exception_ptr ex)
         {
-            return make_ready_future(std::tuple<>());
+            ReadyResult<unit_from_type_t<TResult>> ready;
+            ready.SetException(ex);
+            return future<TResult>(std::move(ready));
         }
     }
 }
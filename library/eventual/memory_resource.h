@@ -0,0 +1,601 @@
+#pragma once
+
+// The MIT License(MIT)
+// 
+// Copyright(c) 2016 Ryan Ferraro
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+
+#include "detail/allocation.h"
+#include "detail/huge_pages.h"
+#include "detail/pools.h"
+#include "detail/thread_cache.h"
+
+namespace eventual
+{
+    using detail::memory_resource;
+    using detail::polymorphic_allocator;
+    using detail::new_delete_resource;
+    using detail::get_default_resource;
+    using detail::set_default_resource;
+
+    // A bump-pointer arena, modelled on std::pmr::monotonic_buffer_resource. Allocations are
+    // carved from an optional initial buffer and then from chunks of geometrically increasing
+    // size taken from an upstream resource; deallocate is a no-op, and all of the memory is
+    // returned at once by release() (or the destructor).
+    //
+    // Intended for a graph of promises and futures that die together: a promise constructed
+    // with polymorphic_allocator<T>(&arena) passes the arena on to every continuation chained
+    // from its future, so that each state costs one bump of a pointer. Like its std
+    // counterpart, a monotonic_buffer_resource is not synchronized; the arena must outlive
+    // (and only be allocated from by one thread at a time during) the graph that uses it.
+    class monotonic_buffer_resource
+        : public memory_resource
+    {
+        using size_t = std::size_t;
+        using max_align_t = std::max_align_t;
+
+        // the header of each chunk taken from upstream, linking it to the previous one.
+        struct Chunk
+        {
+            Chunk* Previous;
+            size_t Size;
+        };
+
+        static constexpr size_t DefaultChunkSize = 1024;
+        static constexpr size_t GrowthFactor = 2;
+
+    public:
+
+        monotonic_buffer_resource()
+            : monotonic_buffer_resource(get_default_resource())
+        { }
+
+        explicit monotonic_buffer_resource(memory_resource* upstream)
+            : monotonic_buffer_resource(DefaultChunkSize, upstream)
+        { }
+
+        explicit monotonic_buffer_resource(size_t initialSize, memory_resource* upstream = get_default_resource())
+            : _upstream(upstream),
+              _buffer(nullptr),
+              _bufferSize(0),
+              _initialChunkSize(std::max(initialSize, sizeof(Chunk))),
+              _nextChunkSize(_initialChunkSize),
+              _current(nullptr),
+              _remaining(0),
+              _chunks(nullptr)
+        {
+            assert(_upstream);
+        }
+
+        monotonic_buffer_resource(void* buffer, size_t bufferSize, memory_resource* upstream = get_default_resource())
+            : _upstream(upstream),
+              _buffer(buffer),
+              _bufferSize(bufferSize),
+              _initialChunkSize(std::max(bufferSize * GrowthFactor, size_t(DefaultChunkSize))),
+              _nextChunkSize(_initialChunkSize),
+              _current(static_cast<char*>(buffer)),
+              _remaining(bufferSize),
+              _chunks(nullptr)
+        {
+            assert(_upstream);
+            assert(buffer || bufferSize == 0);
+        }
+
+        monotonic_buffer_resource(const monotonic_buffer_resource&) = delete;
+        monotonic_buffer_resource& operator=(const monotonic_buffer_resource&) = delete;
+
+        virtual ~monotonic_buffer_resource()
+        {
+            release();
+        }
+
+        // returns every chunk to upstream, and starts again from the initial buffer.
+        void release() noexcept
+        {
+            while (_chunks)
+            {
+                auto chunk = _chunks;
+                _chunks = chunk->Previous;
+
+                _upstream->deallocate(chunk, chunk->Size, alignof(max_align_t));
+            }
+
+            _current = static_cast<char*>(_buffer);
+            _remaining = _bufferSize;
+            _nextChunkSize = _initialChunkSize;
+        }
+
+        memory_resource* upstream_resource() const
+        {
+            return _upstream;
+        }
+
+    protected:
+
+        virtual void* do_allocate(size_t bytes, size_t alignment) override
+        {
+            // check if alignment is a power of 2...
+            assert(alignment != 0);
+            assert((alignment & (alignment - 1)) == 0);
+
+            bytes = std::max<size_t>(bytes, 1);
+
+            if (auto p = Bump(bytes, alignment))
+                return p;
+
+            AddChunk(bytes, alignment);
+
+            auto p = Bump(bytes, alignment);
+            assert(p);
+
+            return p;
+        }
+
+        virtual void do_deallocate(void*, size_t, size_t) override
+        {
+            // memory is only returned by release()
+        }
+
+        virtual bool do_is_equal(const memory_resource& other) const noexcept override
+        {
+            return this == std::addressof(other);
+        }
+
+    private:
+
+        void* Bump(size_t bytes, size_t alignment) noexcept
+        {
+            void* p = _current;
+            if (!p || !std::align(alignment, bytes, p, _remaining))
+                return nullptr;
+
+            _current = static_cast<char*>(p) + bytes;
+            _remaining -= bytes;
+
+            return p;
+        }
+
+        void AddChunk(size_t bytes, size_t alignment)
+        {
+            // room for the header, and for rounding up to an alignment stricter than the header's
+            const auto required = sizeof(Chunk) + bytes + (alignment > alignof(max_align_t) ? alignment : 0);
+
+            auto size = _nextChunkSize;
+            while (size < required)
+                size *= GrowthFactor;
+
+            auto chunk = static_cast<Chunk*>(_upstream->allocate(size, alignof(max_align_t)));
+            chunk->Previous = _chunks;
+            chunk->Size = size;
+
+            _chunks = chunk;
+            _current = reinterpret_cast<char*>(chunk + 1);
+            _remaining = size - sizeof(Chunk);
+            _nextChunkSize = size * GrowthFactor;
+        }
+
+        memory_resource* _upstream;
+        void* _buffer;
+        size_t _bufferSize;
+        size_t _initialChunkSize;
+        size_t _nextChunkSize;
+        char* _current;
+        size_t _remaining;
+        Chunk* _chunks;
+    };
+
+    // as std::pmr::pool_options; zero selects a default, and larger values are capped.
+    struct pool_options
+    {
+        std::size_t max_blocks_per_chunk = 0;
+        std::size_t largest_required_pool_block = 0;
+    };
+
+    // A pool of blocks in size classes a quarter octave apart, modelled on std::pmr's. A
+    // deallocated block goes back on the free list of its class, for the next allocation of a
+    // similar size; the lists are refilled a chunk at a time from the upstream resource. Promise
+    // states, continuations and spilled callables come in a handful of sizes, so with a pool
+    // as the default resource (see set_default_resource) they are recycled without malloc.
+    //
+    // Not synchronized: allocate and deallocate must not be called concurrently. Use
+    // synchronized_pool_resource if states may be released on other threads.
+    class unsynchronized_pool_resource
+        : public memory_resource
+    {
+        using size_t = std::size_t;
+
+    public:
+
+        unsynchronized_pool_resource()
+            : unsynchronized_pool_resource(pool_options(), get_default_resource())
+        { }
+
+        explicit unsynchronized_pool_resource(memory_resource* upstream)
+            : unsynchronized_pool_resource(pool_options(), upstream)
+        { }
+
+        explicit unsynchronized_pool_resource(const pool_options& options, memory_resource* upstream = get_default_resource())
+            : _pools(upstream, options.largest_required_pool_block, options.max_blocks_per_chunk)
+        { }
+
+        unsynchronized_pool_resource(const unsynchronized_pool_resource&) = delete;
+        unsynchronized_pool_resource& operator=(const unsynchronized_pool_resource&) = delete;
+
+        // returns every chunk to upstream.
+        void release() noexcept
+        {
+            _pools.Release();
+        }
+
+        memory_resource* upstream_resource() const
+        {
+            return _pools.Upstream();
+        }
+
+        pool_options options() const
+        {
+            pool_options options;
+            options.max_blocks_per_chunk = _pools.BlocksPerChunk();
+            options.largest_required_pool_block = _pools.LargestBlock();
+
+            return options;
+        }
+
+    protected:
+
+        virtual void* do_allocate(size_t bytes, size_t alignment) override
+        {
+            return _pools.Allocate(bytes, alignment);
+        }
+
+        virtual void do_deallocate(void* p, size_t bytes, size_t alignment) override
+        {
+            _pools.Deallocate(p, bytes, alignment);
+        }
+
+        virtual bool do_is_equal(const memory_resource& other) const noexcept override
+        {
+            return this == std::addressof(other);
+        }
+
+    private:
+
+        detail::SizeClassPools _pools;
+    };
+
+    // An unsynchronized_pool_resource guarded by a mutex, so that a state may be released on
+    // a thread other than the one that allocated it.
+    class synchronized_pool_resource
+        : public memory_resource
+    {
+        using size_t = std::size_t;
+
+    public:
+
+        synchronized_pool_resource()
+            : synchronized_pool_resource(pool_options(), get_default_resource())
+        { }
+
+        explicit synchronized_pool_resource(memory_resource* upstream)
+            : synchronized_pool_resource(pool_options(), upstream)
+        { }
+
+        explicit synchronized_pool_resource(const pool_options& options, memory_resource* upstream = get_default_resource())
+            : _pools(upstream, options.largest_required_pool_block, options.max_blocks_per_chunk)
+        { }
+
+        synchronized_pool_resource(const synchronized_pool_resource&) = delete;
+        synchronized_pool_resource& operator=(const synchronized_pool_resource&) = delete;
+
+        // returns every chunk to upstream.
+        void release() noexcept
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _pools.Release();
+        }
+
+        memory_resource* upstream_resource() const
+        {
+            return _pools.Upstream();
+        }
+
+        pool_options options() const
+        {
+            pool_options options;
+            options.max_blocks_per_chunk = _pools.BlocksPerChunk();
+            options.largest_required_pool_block = _pools.LargestBlock();
+
+            return options;
+        }
+
+    protected:
+
+        virtual void* do_allocate(size_t bytes, size_t alignment) override
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _pools.Allocate(bytes, alignment);
+        }
+
+        virtual void do_deallocate(void* p, size_t bytes, size_t alignment) override
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _pools.Deallocate(p, bytes, alignment);
+        }
+
+        virtual bool do_is_equal(const memory_resource& other) const noexcept override
+        {
+            return this == std::addressof(other);
+        }
+
+    private:
+
+        std::mutex _mutex;
+        detail::SizeClassPools _pools;
+    };
+
+    // A pool resource with a cache per thread, for states that are created on one thread and
+    // released on another (e.g. a promise made by a producer, whose future is last held by a
+    // consumer). A block freed by the thread that allocated it is reused by that thread with
+    // no synchronization at all; a block freed elsewhere is returned to its owner in batches,
+    // rather than one remote free at a time. There is a free list for every multiple of
+    // max_align_t up to 1 KiB, so each State<T> is recycled at its exact size; larger blocks
+    // go straight to upstream.
+    //
+    // Upstream is only used under a lock, and a cache is only held by one thread at a time,
+    // so the resource may be shared by any number of threads (and set as the default). It must
+    // outlive every block allocated from it; all of the memory is returned by the destructor.
+    class thread_caching_resource
+        : public memory_resource
+    {
+        using size_t = std::size_t;
+
+    public:
+
+        thread_caching_resource()
+            : thread_caching_resource(get_default_resource())
+        { }
+
+        explicit thread_caching_resource(memory_resource* upstream)
+            : _pools(upstream)
+        { }
+
+        thread_caching_resource(const thread_caching_resource&) = delete;
+        thread_caching_resource& operator=(const thread_caching_resource&) = delete;
+
+        memory_resource* upstream_resource() const
+        {
+            return _pools.Upstream();
+        }
+
+    protected:
+
+        virtual void* do_allocate(size_t bytes, size_t alignment) override
+        {
+            return _pools.Allocate(bytes, alignment);
+        }
+
+        virtual void do_deallocate(void* p, size_t bytes, size_t alignment) override
+        {
+            _pools.Deallocate(p, bytes, alignment);
+        }
+
+        virtual bool do_is_equal(const memory_resource& other) const noexcept override
+        {
+            return this == std::addressof(other);
+        }
+
+    private:
+
+        detail::ThreadCachingPools _pools;
+    };
+
+    struct huge_page_options
+    {
+        // bytes mapped at a time, rounded up to a whole number of 2 MiB pages; zero for 64 MiB.
+        std::size_t region_size = 0;
+
+        // try the reserved huge pages (MAP_HUGETLB) before transparent huge pages.
+        bool use_hugetlb = true;
+
+        pool_options pools;
+    };
+
+    // A synchronized pool resource whose chunks are carved out of large regions mapped on huge
+    // pages, for processes holding millions of pending states at once: the states are packed
+    // into a few 2 MiB pages instead of being scattered over hundreds of thousands of 4 KiB
+    // ones, so walking them (completing, polling or cancelling) costs far fewer TLB misses.
+    // On Linux a region comes from MAP_HUGETLB if any huge pages are reserved, or else is
+    // aligned and advised with MADV_HUGEPAGE; elsewhere it is one plain allocation from the
+    // global operator new.
+    //
+    // Deallocated blocks are recycled by size class, but a region is only unmapped by release()
+    // or the destructor. Blocks too large or too aligned for the pools go to upstream.
+    class huge_page_resource
+        : public memory_resource
+    {
+        using size_t = std::size_t;
+
+    public:
+
+        static constexpr size_t default_region_size = size_t(64) * 1024 * 1024;
+
+        huge_page_resource()
+            : huge_page_resource(huge_page_options(), get_default_resource())
+        { }
+
+        explicit huge_page_resource(memory_resource* upstream)
+            : huge_page_resource(huge_page_options(), upstream)
+        { }
+
+        explicit huge_page_resource(const huge_page_options& options, memory_resource* upstream = get_default_resource())
+            : _upstream(upstream),
+              _arena(options.region_size ? options.region_size : default_region_size, options.use_hugetlb),
+              _pools(&_arena, options.pools.largest_required_pool_block, options.pools.max_blocks_per_chunk)
+        {
+            assert(_upstream);
+        }
+
+        huge_page_resource(const huge_page_resource&) = delete;
+        huge_page_resource& operator=(const huge_page_resource&) = delete;
+
+        // unmaps every region; blocks that went to upstream are not tracked.
+        void release() noexcept
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _pools.Release();
+            _arena.Release();
+        }
+
+        memory_resource* upstream_resource() const
+        {
+            return _upstream;
+        }
+
+        huge_page_options options() const
+        {
+            huge_page_options options;
+            options.region_size = _arena.RegionSize();
+            options.use_hugetlb = _arena.UsesHugeTlb();
+            options.pools.max_blocks_per_chunk = _pools.BlocksPerChunk();
+            options.pools.largest_required_pool_block = _pools.LargestBlock();
+
+            return options;
+        }
+
+        // the bytes of address space currently mapped for the pools.
+        size_t mapped_bytes() const
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _arena.MappedBytes();
+        }
+
+        // false if any region could be neither mapped on nor advised for huge pages (e.g. off
+        // Linux, or with transparent huge pages disabled); the memory is usable either way.
+        bool uses_huge_pages() const
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _arena.OnHugePages();
+        }
+
+    protected:
+
+        virtual void* do_allocate(size_t bytes, size_t alignment) override
+        {
+            if (!_pools.IsPooled(bytes, alignment))
+                return _upstream->allocate(bytes, alignment);
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _pools.Allocate(bytes, alignment);
+        }
+
+        virtual void do_deallocate(void* p, size_t bytes, size_t alignment) override
+        {
+            if (!_pools.IsPooled(bytes, alignment))
+            {
+                _upstream->deallocate(p, bytes, alignment);
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            _pools.Deallocate(p, bytes, alignment);
+        }
+
+        virtual bool do_is_equal(const memory_resource& other) const noexcept override
+        {
+            return this == std::addressof(other);
+        }
+
+    private:
+
+        mutable std::mutex _mutex;
+        memory_resource* _upstream;
+        detail::HugePageArena _arena;
+        detail::SizeClassPools _pools;
+    };
+
+    // Rounds every block up to whole cache lines, aligned to a line, and takes it from an
+    // upstream resource, so that no two blocks share a line. States allocated from it (and the
+    // continuations and states chained from them) do not falsely share: a producer completing
+    // one state does not invalidate the line a consumer is polling in its neighbour. It costs
+    // the padding, up to a line per block.
+    //
+    // Upstream must honor alignments beyond max_align_t, as the resources above do (the pools
+    // pass such blocks on to their own upstream). Synchronized if upstream is.
+    class cache_aligned_resource
+        : public memory_resource
+    {
+        using size_t = std::size_t;
+
+    public:
+
+        cache_aligned_resource()
+            : cache_aligned_resource(get_default_resource())
+        { }
+
+        explicit cache_aligned_resource(memory_resource* upstream)
+            : _upstream(upstream)
+        {
+            assert(_upstream);
+        }
+
+        cache_aligned_resource(const cache_aligned_resource&) = delete;
+        cache_aligned_resource& operator=(const cache_aligned_resource&) = delete;
+
+        memory_resource* upstream_resource() const
+        {
+            return _upstream;
+        }
+
+    protected:
+
+        virtual void* do_allocate(size_t bytes, size_t alignment) override
+        {
+            return _upstream->allocate(RoundUpToLines(bytes), std::max(alignment, detail::CacheLineSize));
+        }
+
+        virtual void do_deallocate(void* p, size_t bytes, size_t alignment) override
+        {
+            _upstream->deallocate(p, RoundUpToLines(bytes), std::max(alignment, detail::CacheLineSize));
+        }
+
+        virtual bool do_is_equal(const memory_resource& other) const noexcept override
+        {
+            return this == std::addressof(other);
+        }
+
+    private:
+
+        static size_t RoundUpToLines(size_t bytes) noexcept
+        {
+            return (bytes + detail::CacheLineSize - 1) & ~(detail::CacheLineSize - 1);
+        }
+
+        memory_resource* _upstream;
+    };
+}
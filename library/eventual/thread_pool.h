@@ -0,0 +1,334 @@
+#pragma once
+
+// The MIT License(MIT)
+// 
+// Copyright(c) 2016 Ryan Ferraro
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "eventual.h"
+#include "detail/work_stealing.h"
+
+namespace eventual
+{
+    // A fixed set of worker threads, each owning a work-stealing deque. Work submitted by a
+    // worker (e.g. a continuation posted with then(pool, ...) that completes on the pool) is
+    // pushed onto that worker's own deque and run newest first; idle workers steal the oldest
+    // work of their peers. Work submitted by any other thread goes through a shared queue.
+    //
+    // thread_pool models the Executor concept. Submitted callables must not throw; as with
+    // std::thread, an exception that escapes one terminates the program. The destructor waits
+    // for all submitted work, including any work that it submits in turn, to run. The pool may
+    // be destroyed by one of its own jobs: that worker then runs the rest of the work itself.
+    class thread_pool
+    {
+        using job_t = detail::Continuation;
+
+        // std::result_of is deprecated in C++17, and removed in C++20.
+        template<class F>
+        using result_t = decltype(std::declval<std::decay_t<F>&>()());
+
+        struct Worker
+        {
+            detail::WorkStealingDeque<job_t*> Jobs;
+            std::thread Thread;
+        };
+
+        struct CurrentWorker
+        {
+            const thread_pool* Pool;
+            std::size_t Index;
+        };
+
+    public:
+
+        explicit thread_pool(std::size_t threadCount = default_thread_count())
+            : _allocator(detail::get_default_resource()),
+              _injectedCount(0),
+              _sleeping(0),
+              _wakeups(0),
+              _stopping(false)
+        {
+            threadCount = std::max<std::size_t>(threadCount, 1);
+
+            for (std::size_t i = 0; i < threadCount; ++i)
+                _workers.push_back(std::make_unique<Worker>());
+
+            try
+            {
+                for (std::size_t i = 0; i < threadCount; ++i)
+                    _workers[i]->Thread = std::thread([this, i]() { Run(i); });
+            }
+            catch (...)
+            {
+                Stop();
+                throw;
+            }
+        }
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        ~thread_pool()
+        {
+            Stop();
+        }
+
+        static std::size_t default_thread_count()
+        {
+            return std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+        }
+
+        std::size_t thread_count() const { return _workers.size(); }
+
+        // true if called from one of this pool's worker threads.
+        bool running_in_this_thread() const
+        {
+            return GetCurrentWorker().Pool == this;
+        }
+
+        // 'f' may be any nullary, move-only callable (including a packaged_task<R()>).
+        template<class F>
+        void execute(F&& f)
+        {
+            using callable_t = std::decay_t<F>;
+            using job_impl_t = detail::AllocatedContinuation<callable_t>;
+
+            callable_t callable(std::forward<F>(f));
+            Submit(job_impl_t::Create(std::move(callable), _allocator));
+        }
+
+        // runs 'f' on the pool, returning a future for its result.
+        template<class F>
+        future<result_t<F>> submit(F&& f)
+        {
+            packaged_task<result_t<F>()> task(std::forward<F>(f));
+            auto result = task.get_future();
+            execute(std::move(task));
+
+            return result;
+        }
+
+    private:
+
+        static CurrentWorker& GetCurrentWorker()
+        {
+            static thread_local CurrentWorker current = { nullptr, 0 };
+            return current;
+        }
+
+        void Submit(job_t* job)
+        {
+            auto& current = GetCurrentWorker();
+            if (current.Pool == this)
+            {
+                _workers[current.Index]->Jobs.Push(job);
+            }
+            else
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _injected.push_back(job);
+                _injectedCount.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            WakeOne();
+        }
+
+        void WakeOne()
+        {
+            // pairs with the fence in WaitForWork: either the sleeper sees the job, or we see the sleeper.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (_sleeping.load(std::memory_order_relaxed) == 0)
+                return;
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            _wakeups++;
+            _wake.notify_one();
+        }
+
+        void Run(std::size_t index)
+        {
+            GetCurrentWorker() = { this, index };
+
+            do
+            {
+                while (auto job = FindWork(index))
+                {
+                    job->Invoke();
+
+                    // the job destroyed the pool, which this thread must no longer touch (see Stop)
+                    if (GetCurrentWorker().Pool != this)
+                        return;
+                }
+
+            } while (WaitForWork());
+
+            GetCurrentWorker() = { nullptr, 0 };
+        }
+
+        job_t* FindWork(std::size_t index)
+        {
+            if (auto job = _workers[index]->Jobs.Pop())
+                return job;
+
+            if (auto job = TakeInjected())
+                return job;
+
+            return Steal(index);
+        }
+
+        job_t* TakeInjected()
+        {
+            if (_injectedCount.load(std::memory_order_relaxed) == 0)
+                return nullptr;
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            return PopInjected();
+        }
+
+        // lock must be held
+        job_t* PopInjected()
+        {
+            if (_injected.empty())
+                return nullptr;
+
+            auto job = _injected.front();
+            _injected.pop_front();
+            _injectedCount.fetch_sub(1, std::memory_order_relaxed);
+
+            return job;
+        }
+
+        job_t* Steal(std::size_t thief)
+        {
+            const auto count = _workers.size();
+            for (std::size_t i = 1; i < count; ++i)
+            {
+                if (auto job = _workers[(thief + i) % count]->Jobs.Steal())
+                    return job;
+            }
+
+            return nullptr;
+        }
+
+        // lock must be held
+        bool HasWork() const
+        {
+            if (!_injected.empty())
+                return true;
+
+            for (const auto& worker : _workers)
+            {
+                if (!worker->Jobs.Empty())
+                    return true;
+            }
+
+            return false;
+        }
+
+        // returns false once the pool is stopping and all of its work has run.
+        bool WaitForWork()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            _sleeping.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            auto awake = true;
+            while (!HasWork())
+            {
+                if (_stopping)
+                {
+                    awake = false;
+                    break;
+                }
+
+                if (_wakeups > 0)
+                {
+                    _wakeups--;
+                    break;
+                }
+
+                _wake.wait(lock);
+            }
+
+            _sleeping.fetch_sub(1, std::memory_order_relaxed);
+            return awake;
+        }
+
+        void Stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stopping = true;
+            }
+
+            _wake.notify_all();
+
+            // a worker cannot join itself: when a job destroys the pool, its worker is detached,
+            // and runs what the others leave once they have stopped.
+            const auto self = std::this_thread::get_id();
+            Worker* current = nullptr;
+
+            for (auto& worker : _workers)
+            {
+                if (worker->Thread.get_id() == self)
+                    current = worker.get();
+                else if (worker->Thread.joinable())
+                    worker->Thread.join();
+            }
+
+            if (current)
+            {
+                const auto index = GetCurrentWorker().Index;
+                while (auto job = FindWork(index))
+                    job->Invoke();
+
+                current->Thread.detach();
+                GetCurrentWorker() = { nullptr, 0 };
+            }
+
+            // only reachable when a worker failed to start
+            while (auto job = PopInjected())
+                job->Discard();
+        }
+
+        detail::polymorphic_allocator<job_t> _allocator;
+        std::vector<std::unique_ptr<Worker>> _workers;
+
+        std::mutex _mutex;
+        std::condition_variable _wake;
+        std::deque<job_t*> _injected;
+        std::atomic<std::size_t> _injectedCount;
+        std::atomic<std::size_t> _sleeping;
+        std::size_t _wakeups;
+        bool _stopping;
+    };
+}
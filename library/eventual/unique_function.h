@@ -0,0 +1,210 @@
+#pragma once
+
+// The MIT License(MIT)
+// 
+// Copyright(c) 2016 Ryan Ferraro
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and / or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "detail/traits.h"
+#include "detail/allocation.h"
+#include "detail/function.h"
+
+namespace eventual
+{
+    // The default inline storage of a unique_function: room for the target's vtable pointer
+    // and five more pointers (e.g. a future and a few references).
+    constexpr std::size_t default_function_storage = 6 * sizeof(void*);
+
+    template<class Signature, std::size_t StorageSize = default_function_storage>
+    class unique_function; // undefined
+
+    // A move-only std::function. A callable that fits in StorageSize bytes (and can be moved
+    // without throwing) is held in place; a larger one is allocated from the allocator given
+    // on construction (or the default memory resource). Since it is never copied, a callable
+    // may own move-only state, such as a unique_ptr or a future.
+    template<class R, class... Args, std::size_t StorageSize>
+    class unique_function<R(Args...), StorageSize>
+    {
+        using target_t = detail::FunctionTarget<R, Args...>;
+        using storage_t = std::aligned_storage_t<StorageSize, alignof(std::max_align_t)>;
+
+        template<class F>
+        using enable_if_callable_t = std::enable_if_t<
+            !std::is_same<std::decay_t<F>, unique_function>::value &&
+            detail::is_callable<std::decay_t<F>&(Args...)>::value>;
+
+    public:
+
+        typedef R result_type;
+
+        unique_function() noexcept : _target(nullptr) { }
+
+        unique_function(std::nullptr_t) noexcept : _target(nullptr) { }
+
+        template<class F, class = enable_if_callable_t<F>>
+        unique_function(F&& function)
+            : unique_function(std::allocator_arg_t(), detail::polymorphic_allocator<char>(), std::forward<F>(function))
+        { }
+
+        template<class Alloc, class F, class = enable_if_callable_t<F>>
+        unique_function(std::allocator_arg_t, const Alloc& alloc, F&& function)
+            : _target(nullptr)
+        {
+            if (detail::IsNullFunction(function))
+                return;
+
+            _target = CreateTarget(detail::AsAllocator(alloc), std::forward<F>(function));
+        }
+
+        unique_function(unique_function&& other) noexcept
+            : _target(other.MoveTarget(&_storage))
+        { }
+
+        unique_function(const unique_function&) = delete;
+
+        ~unique_function()
+        {
+            Reset();
+        }
+
+        unique_function& operator=(unique_function&& other) noexcept
+        {
+            if (this != &other)
+            {
+                Reset();
+                _target = other.MoveTarget(&_storage);
+            }
+            return *this;
+        }
+
+        unique_function& operator=(const unique_function&) = delete;
+
+        unique_function& operator=(std::nullptr_t) noexcept
+        {
+            Reset();
+            return *this;
+        }
+
+        void swap(unique_function& other) noexcept
+        {
+            unique_function temp(std::move(other));
+            other = std::move(*this);
+            *this = std::move(temp);
+        }
+
+        explicit operator bool() const noexcept
+        {
+            return _target != nullptr;
+        }
+
+        R operator()(Args... args)
+        {
+            if (!_target)
+                throw std::bad_function_call();
+
+            return _target->Invoke(std::forward<Args>(args)...);
+        }
+
+    private:
+
+        template<class Alloc, class F>
+        std::enable_if_t<detail::fits_function_storage<std::decay_t<F>, storage_t, R, Args...>::value, target_t*>
+            CreateTarget(const Alloc&, F&& function)
+        {
+            using inline_t = detail::InlineFunctionTarget<std::decay_t<F>, R, Args...>;
+
+            return new(&_storage) inline_t(std::forward<F>(function));
+        }
+
+        template<class Alloc, class F>
+        std::enable_if_t<!detail::fits_function_storage<std::decay_t<F>, storage_t, R, Args...>::value, target_t*>
+            CreateTarget(const Alloc& alloc, F&& function)
+        {
+            using allocated_t = detail::AllocatedFunctionTarget<std::decay_t<F>, Alloc, R, Args...>;
+
+            return allocated_t::Create(std::forward<F>(function), alloc);
+        }
+
+        target_t* MoveTarget(void* storage) noexcept
+        {
+            if (!_target)
+                return nullptr;
+
+            auto target = _target->MoveTo(storage);
+            _target = nullptr;
+            return target;
+        }
+
+        void Reset() noexcept
+        {
+            if (!_target)
+                return;
+
+            _target->Destroy();
+            _target = nullptr;
+        }
+
+        storage_t _storage;
+        target_t* _target;
+    };
+
+    template<class Signature, std::size_t StorageSize>
+    void swap(unique_function<Signature, StorageSize>& a, unique_function<Signature, StorageSize>& b) noexcept
+    {
+        a.swap(b);
+    }
+
+    template<class Signature, std::size_t StorageSize>
+    bool operator==(const unique_function<Signature, StorageSize>& function, std::nullptr_t) noexcept
+    {
+        return !function;
+    }
+
+    template<class Signature, std::size_t StorageSize>
+    bool operator==(std::nullptr_t, const unique_function<Signature, StorageSize>& function) noexcept
+    {
+        return !function;
+    }
+
+    template<class Signature, std::size_t StorageSize>
+    bool operator!=(const unique_function<Signature, StorageSize>& function, std::nullptr_t) noexcept
+    {
+        return static_cast<bool>(function);
+    }
+
+    template<class Signature, std::size_t StorageSize>
+    bool operator!=(std::nullptr_t, const unique_function<Signature, StorageSize>& function) noexcept
+    {
+        return static_cast<bool>(function);
+    }
+}
+
+namespace std
+{
+    // unique_function allocates (only) the callables that do not fit in its inline storage.
+    template<class Signature, std::size_t StorageSize, class Alloc>
+    struct uses_allocator<eventual::unique_function<Signature, StorageSize>, Alloc> : true_type { };
+}
@@ -0,0 +1,176 @@
+#include "stdafx.h"
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <eventual/eventual.h>
+#include <eventual/memory_resource.h>
+
+using namespace eventual;
+
+namespace
+{
+   const std::size_t CacheLine = 64;
+
+   bool IsAligned(const void* p, std::size_t alignment)
+   {
+      return (reinterpret_cast<std::uintptr_t>(p) % alignment) == 0;
+   }
+
+   // forwards to the default resource, recording the size and alignment of every request.
+   class RecordingResource : public memory_resource
+   {
+   public:
+
+      struct Request
+      {
+         void* Address;
+         std::size_t Bytes;
+         std::size_t Alignment;
+      };
+
+      std::vector<Request> Allocations;
+      std::vector<Request> Deallocations;
+
+   protected:
+
+      virtual void* do_allocate(std::size_t bytes, std::size_t alignment) override
+      {
+         auto p = get_default_resource()->allocate(bytes, alignment);
+         Allocations.push_back({ p, bytes, alignment });
+         return p;
+      }
+
+      virtual void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+      {
+         Deallocations.push_back({ p, bytes, alignment });
+         get_default_resource()->deallocate(p, bytes, alignment);
+      }
+
+      virtual bool do_is_equal(const memory_resource& other) const noexcept override
+      {
+         return this == &other;
+      }
+   };
+}
+
+TEST(CacheAlignedResourceTest, Allocate_ReturnsLineAlignedBlocks)
+{
+   // Arrange
+   cache_aligned_resource resource;
+
+   // Act
+   auto first = resource.allocate(8, 8);
+   auto second = resource.allocate(100, 4);
+
+   // Assert
+   EXPECT_TRUE(IsAligned(first, CacheLine));
+   EXPECT_TRUE(IsAligned(second, CacheLine));
+
+   resource.deallocate(first, 8, 8);
+   resource.deallocate(second, 100, 4);
+}
+
+TEST(CacheAlignedResourceTest, Allocate_RoundsUpToWholeLines)
+{
+   // Arrange
+   RecordingResource upstream;
+   cache_aligned_resource resource(&upstream);
+
+   // Act
+   auto p = resource.allocate(144, 8);
+
+   // Assert
+   ASSERT_EQ(1U, upstream.Allocations.size());
+   EXPECT_EQ(p, upstream.Allocations[0].Address);
+   EXPECT_EQ(192U, upstream.Allocations[0].Bytes);
+   EXPECT_EQ(CacheLine, upstream.Allocations[0].Alignment);
+
+   resource.deallocate(p, 144, 8);
+}
+
+TEST(CacheAlignedResourceTest, Allocate_WholeLines_AreNotPadded)
+{
+   // Arrange
+   RecordingResource upstream;
+   cache_aligned_resource resource(&upstream);
+
+   // Act
+   auto p = resource.allocate(128, 8);
+
+   // Assert
+   EXPECT_EQ(128U, upstream.Allocations[0].Bytes);
+
+   resource.deallocate(p, 128, 8);
+}
+
+TEST(CacheAlignedResourceTest, Allocate_StricterAlignment_IsKept)
+{
+   // Arrange
+   RecordingResource upstream;
+   cache_aligned_resource resource(&upstream);
+
+   // Act
+   auto p = resource.allocate(10, 256);
+
+   // Assert
+   EXPECT_EQ(256U, upstream.Allocations[0].Alignment);
+   EXPECT_TRUE(IsAligned(p, 256));
+
+   resource.deallocate(p, 10, 256);
+}
+
+TEST(CacheAlignedResourceTest, Deallocate_ReturnsTheRoundedBlockToUpstream)
+{
+   // Arrange
+   RecordingResource upstream;
+   cache_aligned_resource resource(&upstream);
+   auto p = resource.allocate(144, 8);
+
+   // Act
+   resource.deallocate(p, 144, 8);
+
+   // Assert
+   ASSERT_EQ(1U, upstream.Deallocations.size());
+   EXPECT_EQ(p, upstream.Deallocations[0].Address);
+   EXPECT_EQ(192U, upstream.Deallocations[0].Bytes);
+   EXPECT_EQ(CacheLine, upstream.Deallocations[0].Alignment);
+}
+
+TEST(CacheAlignedResourceTest, IsEqual_OnlyToItself)
+{
+   // Arrange
+   cache_aligned_resource first;
+   cache_aligned_resource second;
+
+   // Assert
+   EXPECT_TRUE(first.is_equal(first));
+   EXPECT_FALSE(first.is_equal(second));
+   EXPECT_EQ(get_default_resource(), first.upstream_resource());
+}
+
+TEST(CacheAlignedResourceTest, Promise_StatesAreLineAlignedWholeLines)
+{
+   // Arrange
+   RecordingResource upstream;
+   cache_aligned_resource resource(&upstream);
+
+   {
+      promise<int> promise(std::allocator_arg_t(), &resource);
+      auto future = promise.get_future().then([](eventual::future<int>& f) { return f.get() + 1; });
+
+      // Act
+      promise.set_value(1);
+
+      // Assert
+      EXPECT_EQ(2, future.get());
+   }
+
+   EXPECT_GE(upstream.Allocations.size(), 2U) << "The continuation's state should come from the same resource.";
+   for (auto& allocation : upstream.Allocations)
+   {
+      EXPECT_TRUE(IsAligned(allocation.Address, CacheLine));
+      EXPECT_EQ(0U, allocation.Bytes % CacheLine);
+   }
+
+   EXPECT_EQ(upstream.Allocations.size(), upstream.Deallocations.size());
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+#include <eventual/eventual.h>
+
+// forwards to the default resource, counting every allocation made through it.
+class CountingResource : public eventual::detail::memory_resource
+{
+    using size_t = std::size_t;
+
+public:
+
+    CountingResource() 
+        : _upstream(eventual::detail::get_default_resource()), 
+          _allocations(0),
+          _deallocations(0)
+    { }
+
+    int GetAllocations() const { return _allocations; }
+    int GetDeallocations() const { return _deallocations; }
+    int GetOutstanding() const { return _allocations - _deallocations; }
+
+protected:
+
+    virtual void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        auto p = _upstream->allocate(bytes, alignment);
+        _allocations++;
+        return p;
+    }
+
+    virtual void do_deallocate(void* p, size_t bytes, size_t alignment) override
+    {
+        _upstream->deallocate(p, bytes, alignment);
+        _deallocations++;
+    }
+
+    virtual bool do_is_equal(const memory_resource& other) const noexcept override
+    {
+        return this == std::addressof(other);
+    }
+
+private:
+    eventual::detail::memory_resource* _upstream;
+    int _allocations;
+    int _deallocations;
+};
@@ -1,9 +1,11 @@
 #include "stdafx.h"
 #include <exception>
 #include <memory>
+#include <thread>
 #include <vector>
 #include <eventual/eventual.h>
 #include "NonCopyable.h"
+#include "BasicAllocator.h"
 
 using namespace eventual;
 
@@ -550,6 +552,76 @@ TEST(EventualTest_WhenAll, WhenAllVeradic_MaintainsResultOrderInTuple)
    EXPECT_EQ(4, std::get<4>(results).get());
 }
 
+TEST(EventualTest_WhenAll, WhenAllIterator_CompletesOnlyAfterLastInput_WithManyInputs)
+{
+   // Arrange
+   const int count = 10000;
+   std::vector<promise<int>> promises(count);
+   std::vector<future<int>> futures;
+   futures.reserve(count);
+   for (auto& promise : promises)
+      futures.emplace_back(promise.get_future());
+
+   // Act
+   auto allFuture = when_all(futures.begin(), futures.end());
+   for (int i = count - 1; i > 0; i--)
+      promises[i].set_value(i);
+
+   EXPECT_FALSE(allFuture.is_ready());
+   promises[0].set_value(0);
+
+   // Assert
+   ASSERT_TRUE(allFuture.is_ready());
+   auto results = allFuture.get();
+   ASSERT_EQ(static_cast<std::size_t>(count), results.size());
+   for (int i = 0; i < count; i++)
+      EXPECT_EQ(i, results[i].get());
+}
+
+TEST(EventualTest_WhenAll, WhenAllIterator_CompletesOnce_WhenInputsCompleteConcurrently)
+{
+   // Arrange
+   const int count = 64;
+   std::vector<promise<int>> promises(count);
+   std::vector<future<int>> futures;
+   for (auto& promise : promises)
+      futures.emplace_back(promise.get_future());
+
+   int invocations = 0;
+   auto allFuture = when_all(futures.begin(), futures.end())
+      .then([&invocations](future<std::vector<future<int>>>& all)
+      {
+         invocations++;
+         return all.get().size();
+      });
+
+   // Act
+   std::vector<std::thread> threads;
+   for (int i = 0; i < count; i++)
+      threads.emplace_back([&promises, i]() { promises[i].set_value(i); });
+   for (auto& thread : threads)
+      thread.join();
+
+   // Assert
+   EXPECT_EQ(static_cast<std::size_t>(count), allFuture.get());
+   EXPECT_EQ(1, invocations);
+}
+
+TEST(EventualTest_WhenAll, WhenAllIterator_ThrowsNoState_WhenAnInputIsInvalid)
+{
+   // Arrange
+   promise<int> promise;
+   std::vector<future<int>> futures;
+   futures.emplace_back(promise.get_future());
+   futures.emplace_back();
+
+   // Act/Assert
+   EXPECT_THROW(when_all(futures.begin(), futures.end()), future_error);
+
+   // the valid input may still complete after the join has been abandoned
+   EXPECT_NO_THROW(promise.set_value(1));
+}
+
 TEST(EventualTest_WhenAny, WhenAnyIterator_MaintainsResultOrderInVector)
 {
    // Arrange
@@ -600,6 +672,194 @@ TEST(EventualTest_WhenAny, WhenAnyVeradic_MaintainsResultOrderInTuple)
    EXPECT_EQ(4, std::get<4>(results.futures).get());
 }
 
+TEST(EventualTest_WhenAny, WhenAnyIterator_IgnoresLosers_WhenTheyCompleteAfterTheWinner)
+{
+   // Arrange
+   std::vector<promise<int>> promises(3);
+   std::vector<future<int>> futures;
+   for (auto& promise : promises)
+      futures.emplace_back(promise.get_future());
+
+   auto anyFuture = when_any(futures.begin(), futures.end());
+
+   // Act
+   promises[1].set_value(1);
+   promises[0].set_value(0);
+   promises[2].set_exception(std::make_exception_ptr(EventualTestException()));
+
+   // Assert
+   auto result = anyFuture.get();
+   EXPECT_EQ(1u, result.index);
+   EXPECT_EQ(0, result.futures[0].get());
+   EXPECT_EQ(1, result.futures[1].get());
+   EXPECT_THROW(result.futures[2].get(), EventualTestException);
+}
+
+TEST(EventualTest_WhenAny, WhenAnyVeradic_LoserThen_RunsWhenTheLoserCompletes)
+{
+   // Arrange
+   promise<int> promise1;
+   promise<int> promise2;
+   auto anyFuture = when_any(promise1.get_future(), promise2.get_future());
+   promise1.set_value(1);
+
+   // Act
+   int invocations = 0;
+   auto loser = std::get<1>(anyFuture.get().futures);
+   auto continued = loser.then([&invocations](future<int> f) { invocations++; return f.get() + 1; });
+   promise2.set_value(41);
+
+   // Assert
+   EXPECT_EQ(1, invocations);
+   EXPECT_EQ(42, continued.get());
+}
+
+TEST(EventualTest_WhenAny, WhenAnyVeradic_LoserReturnedFromAContinuation_IsUnwrapped)
+{
+   // Arrange
+   promise<int> promise1;
+   promise<int> promise2;
+   auto anyFuture = when_any(promise1.get_future(), promise2.get_future());
+
+   // Act
+   auto unwrapped = anyFuture.then([](auto f) { return std::move(std::get<1>(f.get().futures)); });
+   promise1.set_value(1);
+   promise2.set_value(42);
+
+   // Assert
+   EXPECT_EQ(42, unwrapped.get());
+}
+
+TEST(EventualTest_WhenAny, WhenAnyVeradic_LoserJoinedByWhenAll_CompletesTheJoin)
+{
+   // Arrange
+   promise<int> promise1;
+   promise<int> promise2;
+   auto anyFuture = when_any(promise1.get_future(), promise2.get_future());
+   promise1.set_value(1);
+
+   // Act
+   auto result = anyFuture.get();
+   auto allFuture = when_all(std::move(std::get<1>(result.futures)));
+   promise2.set_value(42);
+
+   // Assert
+   ASSERT_TRUE(allFuture.is_ready());
+   EXPECT_EQ(42, std::get<0>(allFuture.get()).get());
+}
+
+TEST(EventualTest_WhenAny, WhenAnyIterator_LoserThen_RunsWhenLosersCompleteAfterTheWinner)
+{
+   // Arrange
+   std::vector<promise<int>> promises(3);
+   std::vector<future<int>> futures;
+   for (auto& promise : promises)
+      futures.emplace_back(promise.get_future());
+
+   auto anyFuture = when_any(futures.begin(), futures.end());
+   promises[0].set_value(0);
+   auto result = anyFuture.get();
+
+   // Act
+   int invocations = 0;
+   std::vector<future<int>> continued;
+   for (std::size_t i = 1; i < result.futures.size(); i++)
+      continued.emplace_back(result.futures[i].then([&invocations](future<int> f) { invocations++; return f.get() * 2; }));
+
+   promises[2].set_value(2);
+   promises[1].set_value(1);
+
+   // Assert
+   EXPECT_EQ(0u, result.index);
+   EXPECT_EQ(2, invocations);
+   EXPECT_EQ(2, continued[0].get());
+   EXPECT_EQ(4, continued[1].get());
+}
+
+TEST(EventualTest_WhenAny, WhenAnyIterator_ClaimsOneWinner_WhenInputsCompleteConcurrently)
+{
+   // Arrange
+   const int count = 64;
+   std::vector<promise<int>> promises(count);
+   std::vector<future<int>> futures;
+   for (auto& promise : promises)
+      futures.emplace_back(promise.get_future());
+
+   auto anyFuture = when_any(futures.begin(), futures.end());
+
+   // Act
+   std::vector<std::thread> threads;
+   for (int i = 0; i < count; i++)
+      threads.emplace_back([&promises, i]() { promises[i].set_value(i); });
+   for (auto& thread : threads)
+      thread.join();
+
+   // Assert
+   auto result = anyFuture.get();
+   ASSERT_LT(result.index, static_cast<std::size_t>(count));
+   ASSERT_EQ(static_cast<std::size_t>(count), result.futures.size());
+   EXPECT_EQ(static_cast<int>(result.index), result.futures[result.index].get());
+}
+
+TEST(EventualTest_WhenAny, WhenAnyIterator_ThrowsNoState_WhenAnInputIsInvalid)
+{
+   // Arrange
+   promise<int> promise;
+   std::vector<future<int>> futures;
+   futures.emplace_back(promise.get_future());
+   futures.emplace_back();
+
+   // Act/Assert
+   EXPECT_THROW(when_any(futures.begin(), futures.end()), future_error);
+   EXPECT_NO_THROW(promise.set_value(1));
+}
+
+TEST(EventualTest_WhenAny, WhenAnyIterator_UsesTheProvidedAllocator)
+{
+   // Arrange
+   auto alloc = BasicAllocator<int>();
+   promise<int> promise;
+   std::vector<future<int>> futures;
+   futures.emplace_back(promise.get_future());
+
+   {
+      // Act
+      auto anyFuture = when_any(std::allocator_arg_t(), alloc, futures.begin(), futures.end());
+      EXPECT_GT(alloc.GetCount(), 0) << "Custom allocator did not detect any heap creation.";
+
+      promise.set_value(7);
+      auto result = anyFuture.get();
+
+      EXPECT_EQ(0u, result.index);
+      EXPECT_EQ(7, result.futures[0].get());
+   }
+
+   // Assert
+   EXPECT_EQ(0, alloc.GetCount()) << "Custom allocator did not deallocate all the objects it created.";
+}
+
+TEST(EventualTest_WhenAny, WhenAnyVeradic_UsesTheProvidedAllocator)
+{
+   // Arrange
+   auto alloc = BasicAllocator<int>();
+   promise<void> promise;
+
+   {
+      // Act
+      auto anyFuture = when_any(std::allocator_arg_t(), alloc, promise.get_future(), make_ready_future(2));
+      EXPECT_GT(alloc.GetCount(), 0) << "Custom allocator did not detect any heap creation.";
+
+      auto result = anyFuture.get();
+
+      EXPECT_EQ(1u, result.index);
+      EXPECT_EQ(2, std::get<1>(result.futures).get());
+   }
+
+   // Assert (the pending loser still holds its registration until it completes)
+   promise.set_value();
+   EXPECT_EQ(0, alloc.GetCount()) << "Custom allocator did not deallocate all the objects it created.";
+}
+
 TEST(EventualTest_Value, MakeReadyFuture_ReturnsACompleteFuture)
 {
    // Act
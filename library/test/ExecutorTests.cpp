@@ -0,0 +1,275 @@
+#include "stdafx.h"
+#include <thread>
+#include <vector>
+#include <eventual/eventual.h>
+#include "ManualExecutor.h"
+
+using namespace eventual;
+
+namespace
+{
+   class TestException { };
+
+   struct NotAnExecutor { };
+
+   template<class R>
+   struct Complete
+   {
+      static void Promise(promise<R>& promise) { promise.set_value(R()); }
+   };
+
+   template<>
+   struct Complete<int&>
+   {
+      static void Promise(promise<int&>& promise)
+      {
+         static int value = 0;
+         promise.set_value(value);
+      }
+   };
+
+   template<>
+   struct Complete<void>
+   {
+      static void Promise(promise<void>& promise) { promise.set_value(); }
+   };
+}
+
+// Typed Tests
+template<typename T>
+class ExecutorTest : public testing::Test { };
+typedef testing::Types<void, int, int&> ExecutorReturnTypes;
+TYPED_TEST_CASE(ExecutorTest, ExecutorReturnTypes); // ignore intellisense warning
+
+TEST(ExecutorTest, IsExecutor_DetectsExecuteMember)
+{
+   // Assert
+   EXPECT_TRUE(is_executor<inline_executor>::value);
+   EXPECT_TRUE(is_executor<ManualExecutor>::value);
+   EXPECT_FALSE(is_executor<NotAnExecutor>::value);
+   EXPECT_FALSE(is_executor<future<int>>::value);
+}
+
+TYPED_TEST(ExecutorTest, Then_PostsContinuationToExecutor)
+{
+   // Arrange
+   ManualExecutor executor;
+   promise<TypeParam> promise;
+   auto invoked = false;
+
+   auto continuation = promise.get_future().then(executor, [&invoked](auto&) { invoked = true; });
+
+   // Act
+   Complete<TypeParam>::Promise(promise);
+
+   // Assert
+   EXPECT_FALSE(invoked) << "The continuation should not run on the completing thread.";
+   EXPECT_FALSE(continuation.is_ready());
+   EXPECT_EQ(1U, executor.GetPending());
+
+   executor.RunAll();
+
+   EXPECT_TRUE(invoked);
+   EXPECT_TRUE(continuation.is_ready());
+}
+
+TYPED_TEST(ExecutorTest, Then_OnReadyFuture_PostsContinuationToExecutor)
+{
+   // Arrange
+   ManualExecutor executor;
+   promise<TypeParam> promise;
+   Complete<TypeParam>::Promise(promise);
+   auto invoked = false;
+
+   // Act
+   promise.get_future().then(executor, [&invoked](auto&) { invoked = true; });
+
+   // Assert
+   EXPECT_FALSE(invoked);
+   EXPECT_EQ(1U, executor.RunAll());
+   EXPECT_TRUE(invoked);
+}
+
+TYPED_TEST(ExecutorTest, SharedFutureThen_PostsEachContinuationToExecutor)
+{
+   // Arrange
+   ManualExecutor executor;
+   promise<TypeParam> promise;
+   auto shared = promise.get_future().share();
+   auto invocations = 0;
+
+   shared.then(executor, [&invocations](auto&) { invocations++; });
+   shared.then(executor, [&invocations](auto&) { invocations++; });
+
+   // Act
+   Complete<TypeParam>::Promise(promise);
+
+   // Assert
+   EXPECT_EQ(0, invocations);
+   EXPECT_EQ(2U, executor.RunAll());
+   EXPECT_EQ(2, invocations);
+}
+
+TYPED_TEST(ExecutorTest, Then_RunsContinuationOnExecutorThread)
+{
+   // Arrange
+   ManualExecutor executor;
+   promise<TypeParam> promise;
+   std::thread::id ranOn;
+
+   auto continuation = promise.get_future().then(executor, [&ranOn](auto&) { ranOn = std::this_thread::get_id(); });
+   Complete<TypeParam>::Promise(promise);
+
+   // Act
+   std::thread worker([&executor]() { executor.RunAll(); });
+   auto workerId = worker.get_id();
+   worker.join();
+
+   // Assert
+   EXPECT_EQ(workerId, ranOn);
+   EXPECT_TRUE(continuation.is_ready());
+}
+
+TEST(ExecutorTest, Then_PropagatesContinuationResultAndException)
+{
+   // Arrange
+   ManualExecutor executor;
+   promise<int> promise;
+   auto shared = promise.get_future().share();
+
+   auto doubled = shared.then(executor, [](auto& f) { return f.get() * 2; });
+   auto failed = shared.then(executor, [](auto&) -> int { throw TestException(); });
+
+   // Act
+   promise.set_value(21);
+   executor.RunAll();
+
+   // Assert
+   EXPECT_EQ(42, doubled.get());
+   EXPECT_THROW(failed.get(), TestException);
+}
+
+TEST(ExecutorTest, Then_UnwrapsReturnedFuture)
+{
+   // Arrange
+   ManualExecutor executor;
+   promise<int> outer;
+   eventual::promise<int> inner;
+
+   auto result = outer.get_future().then(executor, [&inner](auto&) { return inner.get_future(); });
+
+   // Act
+   outer.set_value(1);
+   executor.RunAll();
+   inner.set_value(7);
+
+   // Assert
+   EXPECT_EQ(7, result.get());
+}
+
+TEST(ExecutorTest, Then_ExecutorDestroyedWithPendingWork_BreaksPromise)
+{
+   // Arrange
+   future<void> continuation;
+   {
+      ManualExecutor executor;
+      promise<void> promise;
+      continuation = promise.get_future().then(executor, [](auto&) { });
+      promise.set_value();
+   }
+
+   // Assert
+   EXPECT_THROW(continuation.get(), future_error);
+}
+
+TEST(ExecutorTest, WhenAll_CompletesOnExecutor)
+{
+   // Arrange
+   ManualExecutor executor;
+   std::vector<promise<int>> promises(3);
+   std::vector<future<int>> futures;
+   for (auto& promise : promises)
+      futures.emplace_back(promise.get_future());
+
+   eventual::promise<int> first;
+   auto all = when_all(executor, futures.begin(), futures.end());
+   auto tuple = when_all(executor, first.get_future().share(), make_ready_future(2));
+
+   // Act
+   for (auto& promise : promises)
+      promise.set_value(1);
+   first.set_value(1);
+
+   // Assert
+   EXPECT_FALSE(all.is_ready());
+   EXPECT_FALSE(tuple.is_ready());
+
+   executor.RunAll();
+
+   ASSERT_TRUE(all.is_ready());
+   EXPECT_EQ(3U, all.get().size());
+   EXPECT_EQ(2, std::get<1>(tuple.get()).get());
+}
+
+TEST(ExecutorTest, WhenAny_CompletesOnExecutor)
+{
+   // Arrange
+   ManualExecutor executor;
+   std::vector<promise<int>> promises(3);
+   std::vector<future<int>> futures;
+   for (auto& promise : promises)
+      futures.emplace_back(promise.get_future());
+
+   eventual::promise<int> first;
+   auto any = when_any(executor, futures.begin(), futures.end());
+   auto tuple = when_any(executor, first.get_future(), make_ready_future(2));
+
+   // Act
+   promises[1].set_value(1);
+
+   // Assert
+   EXPECT_FALSE(any.is_ready());
+   EXPECT_FALSE(tuple.is_ready());
+
+   executor.RunAll();
+
+   ASSERT_TRUE(any.is_ready());
+   EXPECT_EQ(1U, any.get().index);
+   EXPECT_EQ(1U, tuple.get().index);
+}
+
+TEST(ExecutorTest, InlineExecutor_RunsContinuationOnCompletingThread)
+{
+   // Arrange
+   inline_executor executor;
+   promise<int> promise;
+   auto invoked = false;
+
+   promise.get_future().then(executor, [&invoked](auto&) { invoked = true; });
+
+   // Act
+   promise.set_value(1);
+
+   // Assert
+   EXPECT_TRUE(invoked);
+}
+
+TEST(ExecutorTest, Then_PostsContinuationOfAReadyFuture)
+{
+   // Arrange
+   ManualExecutor executor;
+   auto invoked = false;
+
+   // Act
+   auto continuation = make_ready_future(1).then(executor, [&invoked](future<int>& f)
+   {
+      invoked = true;
+      return f.get() + 1;
+   });
+
+   // Assert
+   EXPECT_FALSE(invoked) << "A ready future should not run an executor's continuation inline.";
+   EXPECT_EQ(1u, executor.RunAll());
+   EXPECT_TRUE(invoked);
+   EXPECT_EQ(2, continuation.get());
+}
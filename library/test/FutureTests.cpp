@@ -4,9 +4,11 @@
 #include <thread>
 #include <chrono>
 #include <atomic>
+#include <vector>
 #include <eventual/eventual.h>
 #include "FutureTestPatterns.h"
 #include "NonCopyable.h"
+#include "CountingResource.h"
 
 using namespace eventual;
 
@@ -93,6 +95,21 @@ TYPED_TEST(FutureTest, Then_InvalidatesFuture)
    EXPECT_FALSE(future.valid()) << "Future::then failed to invalidate the future.";
 }
 
+TYPED_TEST(FutureTest, Then_OnPendingFuture_OnlyAllocatesTheContinuationState)
+{
+   // Arrange
+   CountingResource resource;
+   promise<TypeParam> promise { std::allocator_arg_t(), eventual::detail::polymorphic_allocator<int>(&resource) };
+   auto future = promise.get_future();
+   auto allocations = resource.GetAllocations();
+
+   // Act
+   auto continuation = future.then([](auto&) { });
+
+   // Assert
+   EXPECT_EQ(1, resource.GetAllocations() - allocations) << "Registering a continuation should not allocate.";
+}
+
 TYPED_TEST(FutureTest, Get_InvalidatesFuture)
 {
    // Arrange
@@ -233,6 +250,64 @@ TEST(FutureTest_Value, Get_BlocksUntilReady)
    EXPECT_TRUE(actual.load());
 }
 
+TEST(FutureTest_Value, Wait_ManyWaitersOnManyStates_AllWake)
+{
+   // Arrange
+   const auto count = 300;
+   std::vector<eventual::promise<int>> promises(count);
+   std::vector<std::thread> waiters;
+   std::atomic<int> woken(0);
+
+   for (auto& promise : promises)
+   {
+      waiters.emplace_back([future = promise.get_future(), &woken]() mutable
+      {
+         future.wait();
+         woken++;
+      });
+   }
+
+   // Act
+   for (auto i = 0; i < count; ++i)
+      promises[i].set_value(i);
+
+   for (auto& waiter : waiters)
+      waiter.join();
+
+   // Assert
+   EXPECT_EQ(count, woken.load());
+}
+
+TEST(FutureTest_Value, WaitFor_TimesOut_WhenOtherStatesComplete)
+{
+   // Arrange
+   const auto count = 300;
+   std::vector<eventual::promise<int>> promises(count);
+   std::vector<std::thread> waiters;
+   std::atomic<int> timedOut(0);
+
+   // more states than there are parking lot buckets, so some waiters share a bucket with a
+   // state that completes.
+   for (auto i = 1; i < count; i += 2)
+   {
+      waiters.emplace_back([future = promises[i].get_future(), &timedOut]()
+      {
+         if (future.wait_for(std::chrono::milliseconds(200)) == future_status::timeout)
+            timedOut++;
+      });
+   }
+
+   // Act
+   for (auto i = 0; i < count; i += 2)
+      promises[i].set_value(i);
+
+   for (auto& waiter : waiters)
+      waiter.join();
+
+   // Assert
+   EXPECT_EQ(count / 2, timedOut.load());
+}
+
 TEST(FutureTest_Reference, Get_BlocksUntilReady)
 {
    // Arrange
@@ -433,6 +508,158 @@ TEST(FutureTest_Value, Then_UnwrapsAndReturnsNestedResultWhenComplete)
    EXPECT_EQ(expected, actual) << "Future::then failed to return the expected value of the unwrapped continuation.";
 }
 
+TEST(FutureTest_Value, Then_UnwrapsAPendingFuture_WithoutAllocating)
+{
+   // Arrange
+   CountingResource resource;
+   eventual::promise<int> outer(std::allocator_arg_t(), &resource);
+   eventual::promise<int> inner(std::allocator_arg_t(), &resource);
+   auto unwrapped = outer.get_future().then([&inner](auto&) { return inner.get_future(); });
+   auto allocations = resource.GetAllocations();
+
+   // Act
+   outer.set_value(1);
+   inner.set_value(2);
+
+   // Assert
+   EXPECT_EQ(allocations, resource.GetAllocations()) << "The inner future should complete the unwrapped future directly.";
+   EXPECT_EQ(2, unwrapped.get());
+}
+
+TEST(FutureTest_Value, Then_UnwrapsAnExceptionalInnerFuture)
+{
+   // Arrange
+   eventual::promise<int> outer;
+   eventual::promise<int> inner;
+   auto unwrapped = outer.get_future().then([&inner](auto&) { return inner.get_future(); });
+
+   // Act
+   outer.set_value(1);
+   inner.set_exception(std::make_exception_ptr(TestException()));
+
+   // Assert
+   EXPECT_THROW(unwrapped.get(), TestException);
+}
+
+TEST(FutureTest_Value, Then_LongPendingChain_CompletesWithoutRecursion)
+{
+   // Arrange
+   const auto links = 100000;
+   eventual::promise<int> promise;
+   auto chain = promise.get_future();
+
+   for (auto i = 0; i < links; ++i)
+      chain = chain.then([](auto& f) { return f.get() + 1; });
+
+   // Act
+   promise.set_value(0);
+
+   // Assert
+   ASSERT_TRUE(chain.is_ready()) << "The chain should complete before set_value returns.";
+   EXPECT_EQ(links, chain.get());
+}
+
+TEST(FutureTest_Value, Then_NestedCompletion_RunsAfterTheRunningContinuation)
+{
+   // Arrange
+   eventual::promise<int> first;
+   eventual::promise<int> second;
+   std::vector<int> order;
+
+   auto nested = second.get_future().then([&order](auto&) { order.push_back(3); });
+   auto outer = first.get_future().then([&order, &second](auto&)
+   {
+      order.push_back(1);
+      second.set_value(0);
+      order.push_back(2);
+   });
+
+   // Act
+   first.set_value(0);
+
+   // Assert
+   EXPECT_EQ((std::vector<int> { 1, 2, 3 }), order);
+   EXPECT_TRUE(nested.is_ready());
+}
+
+TEST(FutureTest_Value, Then_ContinuationBlockingOnANestedCompletion_DoesNotDeadlock)
+{
+   // Arrange
+   eventual::promise<int> first;
+   eventual::promise<int> second;
+   auto nested = second.get_future().then([](auto& f) { return f.get() + 1; });
+
+   auto outer = first.get_future().then([&second, &nested](auto&)
+   {
+      second.set_value(5);
+      return nested.get();
+   });
+
+   // Act
+   first.set_value(0);
+
+   // Assert
+   EXPECT_EQ(6, outer.get());
+}
+
+TEST(FutureTest_Value, Then_ContinuationBlockingOnALaterOne_RunsThePendingOnesInOrder)
+{
+   // Arrange
+   eventual::promise<int> first;
+   eventual::promise<int> second;
+   eventual::promise<int> gate;
+   auto shared = first.get_future().share();
+   auto gateFuture = gate.get_future();
+   std::vector<int> order;
+
+   auto nested = second.get_future().then([&order](auto&) { order.push_back(4); });
+   auto blocking = shared.then([&order, &second, &gateFuture](auto&)
+   {
+      order.push_back(1);
+      second.set_value(0);
+      gateFuture.get();
+      order.push_back(5);
+   });
+   auto pending = shared.then([&order](auto&) { order.push_back(2); });
+   auto completing = shared.then([&order, &gate](auto&)
+   {
+      order.push_back(3);
+      gate.set_value(0);
+   });
+
+   // Act
+   first.set_value(0);
+
+   // Assert (the blocking get() runs the rest of the first State's continuations, then the
+   // nested completion, as the outermost call would have)
+   EXPECT_EQ((std::vector<int> { 1, 2, 3, 4, 5 }), order);
+   EXPECT_TRUE(nested.is_ready());
+   EXPECT_TRUE(blocking.is_ready());
+}
+
+TEST(FutureTest_Value, Then_DeferredOnAnUnwrappedFuture_KeepsItsStateAlive)
+{
+   // Arrange
+   eventual::promise<int> outer;
+   eventual::future<int> continued;
+
+   auto running = outer.get_future().then([&continued](auto&)
+   {
+      eventual::promise<eventual::future<int>> inner;
+      auto unwrapped = inner.get_future();
+      inner.set_value(eventual::make_ready_future(1));
+
+      // queued behind the running continuation, with the only reference to the unwrapped state
+      continued = unwrapped.then([](eventual::future<int> f) { return f.get() + 1; });
+   });
+
+   // Act
+   outer.set_value(0);
+
+   // Assert
+   EXPECT_EQ(2, continued.get());
+}
+
 TEST(FutureTest_Reference, Then_UnwrapsAndReturnsNestedResultWhenComplete)
 {
    // Arrange
@@ -501,3 +728,100 @@ TEST(FutureTest_Void, Then_UnwrapsAndReturnsDeeplyNestedFutureWhenComplete)
     // Assert
     EXPECT_TRUE(continuationCalled) << "Future::then failed to return the unwrapped continuation..";
 }
+
+TEST(FutureTest_Value, MakeReadyFuture_Then_RunsContinuationImmediately)
+{
+   // Arrange
+   auto future = make_ready_future(1);
+
+   // Act
+   auto next = future.then([](eventual::future<int>& f) { return f.get() + 1; });
+
+   // Assert
+   EXPECT_FALSE(future.valid());
+   ASSERT_TRUE(next.is_ready()) << "A continuation of a ready future should run inside then().";
+   EXPECT_EQ(2, next.get());
+   EXPECT_FALSE(next.valid());
+}
+
+TEST(FutureTest_Value, MakeReadyFuture_Then_ReturnsExceptionalFuture_WhenContinuationThrows)
+{
+   // Arrange
+   auto future = make_ready_future(1);
+
+   // Act
+   auto next = future.then([](eventual::future<int>&) -> int { throw TestException(); });
+
+   // Assert
+   ASSERT_TRUE(next.is_ready());
+   EXPECT_THROW(next.get(), TestException);
+}
+
+TEST(FutureTest_Value, MakeReadyFuture_Then_UnwrapsReturnedFuture)
+{
+   // Arrange
+   promise<int> inner;
+   auto future = make_ready_future(1);
+
+   // Act
+   auto next = future.then([&inner](eventual::future<int>&) { return inner.get_future(); });
+
+   // Assert
+   EXPECT_FALSE(next.is_ready());
+   inner.set_value(3);
+   EXPECT_EQ(3, next.get());
+}
+
+TEST(FutureTest_Value, MakeReadyFuture_Share_SharesTheValue)
+{
+   // Arrange
+   auto future = make_ready_future(4);
+
+   // Act
+   auto shared = future.share();
+   auto copy = shared;
+
+   // Assert
+   EXPECT_FALSE(future.valid());
+   EXPECT_EQ(4, shared.get());
+   EXPECT_EQ(&shared.get(), &copy.get()) << "Copies of a shared future should share one result.";
+}
+
+TEST(FutureTest_Value, MakeExceptionalFuture_WaitAndGet_ThrowWithoutBlocking)
+{
+   // Arrange
+   auto future = make_exceptional_future<int>(TestException());
+
+   // Act/Assert
+   EXPECT_TRUE(future.valid());
+   EXPECT_TRUE(future.is_ready());
+   EXPECT_EQ(future_status::ready, future.wait_for(std::chrono::seconds(0)));
+   EXPECT_THROW(future.get(), TestException);
+   EXPECT_FALSE(future.valid());
+}
+
+TEST(FutureTest_Value, MakeReadyFuture_IsUnwrapped_WhenSetOnAPromiseOfAFuture)
+{
+   // Arrange
+   promise<eventual::future<int>> promise;
+   eventual::future<int> future = promise.get_future();
+
+   // Act
+   promise.set_value(make_ready_future(5));
+
+   // Assert
+   EXPECT_EQ(5, future.get());
+}
+
+TEST(FutureTest_Value, MakeReadyFuture_OfAFuture_UnwrapsWithoutAState)
+{
+   // Arrange
+   auto nested = make_ready_future(make_ready_future(6));
+
+   // Act
+   eventual::future<int> future(std::move(nested));
+
+   // Assert
+   EXPECT_TRUE(future.is_ready());
+   EXPECT_EQ(6, future.get());
+}
@@ -0,0 +1,195 @@
+#include "stdafx.h"
+#include <cstdint>
+#include <cstddef>
+#include <thread>
+#include <vector>
+#include <eventual/eventual.h>
+#include <eventual/memory_resource.h>
+#include "CountingResource.h"
+
+using namespace eventual;
+
+namespace
+{
+   const std::size_t HugePage = 2 * 1024 * 1024;
+
+   bool IsAligned(void* p, std::size_t alignment)
+   {
+      return (reinterpret_cast<std::uintptr_t>(p) % alignment) == 0;
+   }
+
+   huge_page_options SmallRegions()
+   {
+      huge_page_options options;
+      options.region_size = HugePage;
+      return options;
+   }
+}
+
+TEST(HugePageResourceTest, Construct_MapsNothingUntilTheFirstAllocation)
+{
+   // Arrange
+   huge_page_resource resource(SmallRegions());
+
+   // Assert
+   EXPECT_EQ(0U, resource.mapped_bytes());
+}
+
+TEST(HugePageResourceTest, Allocate_MapsAWholeRegion)
+{
+   // Arrange
+   huge_page_resource resource(SmallRegions());
+
+   // Act
+   for (auto i = 0; i < 1000; ++i)
+      EXPECT_NE(nullptr, resource.allocate(248));
+
+   // Assert
+   EXPECT_EQ(HugePage, resource.mapped_bytes()) << "1000 states should fit in one huge page.";
+}
+
+TEST(HugePageResourceTest, Allocate_WhenTheRegionIsFull_MapsAnother)
+{
+   // Arrange
+   huge_page_resource resource(SmallRegions());
+
+   // Act
+   for (auto i = 0; i < 10000; ++i)
+      EXPECT_NE(nullptr, resource.allocate(256));
+
+   // Assert
+   EXPECT_EQ(2 * HugePage, resource.mapped_bytes());
+}
+
+TEST(HugePageResourceTest, Allocate_ShouldRespectAlignment)
+{
+   // Arrange
+   huge_page_resource resource(SmallRegions());
+
+   // Act
+   auto p = resource.allocate(24, 8);
+   auto q = resource.allocate(40, alignof(std::max_align_t));
+
+   // Assert
+   EXPECT_TRUE(IsAligned(p, 8));
+   EXPECT_TRUE(IsAligned(q, alignof(std::max_align_t)));
+}
+
+TEST(HugePageResourceTest, Deallocate_ShouldRecycleTheBlock)
+{
+   // Arrange
+   huge_page_resource resource(SmallRegions());
+   auto p = resource.allocate(248);
+
+   // Act
+   resource.deallocate(p, 248);
+   auto q = resource.allocate(248);
+
+   // Assert
+   EXPECT_EQ(p, q);
+}
+
+TEST(HugePageResourceTest, Allocate_LargerThanLargestBlock_GoesToUpstream)
+{
+   // Arrange
+   CountingResource upstream;
+   huge_page_resource resource(SmallRegions(), &upstream);
+
+   // Act
+   auto p = resource.allocate(64 * 1024);
+   resource.deallocate(p, 64 * 1024);
+
+   // Assert
+   EXPECT_EQ(1, upstream.GetAllocations());
+   EXPECT_EQ(0, upstream.GetOutstanding());
+   EXPECT_EQ(0U, resource.mapped_bytes());
+}
+
+TEST(HugePageResourceTest, Release_ShouldUnmapEveryRegion)
+{
+   // Arrange
+   huge_page_resource resource(SmallRegions());
+   for (auto i = 0; i < 10000; ++i)
+      EXPECT_NE(nullptr, resource.allocate(256));
+
+   // Act
+   resource.release();
+
+   // Assert
+   EXPECT_EQ(0U, resource.mapped_bytes());
+   EXPECT_NE(nullptr, resource.allocate(256)) << "The resource should be usable after a release.";
+}
+
+TEST(HugePageResourceTest, Options_AreRoundedToHugePages)
+{
+   // Arrange
+   huge_page_options options;
+   options.region_size = 1;
+   options.use_hugetlb = false;
+
+   huge_page_resource resource(options);
+   huge_page_resource defaults;
+
+   // Assert
+   EXPECT_EQ(HugePage, resource.options().region_size);
+   EXPECT_FALSE(resource.options().use_hugetlb);
+   EXPECT_EQ(std::size_t(huge_page_resource::default_region_size), defaults.options().region_size);
+}
+
+TEST(HugePageResourceTest, UsesHugePages_IsTrueBeforeAnyRegionIsMapped)
+{
+   // Arrange
+   huge_page_resource resource(SmallRegions());
+
+   // Assert
+   EXPECT_TRUE(resource.uses_huge_pages());
+}
+
+TEST(HugePageResourceTest, PolymorphicAllocator_PendingStatesShareTheRegion)
+{
+   // Arrange
+   huge_page_resource resource(SmallRegions());
+   std::vector<promise<int>> promises;
+   std::vector<future<int>> futures;
+
+   // Act
+   for (auto i = 0; i < 1000; ++i)
+   {
+      promises.emplace_back(std::allocator_arg_t(), &resource);
+      futures.emplace_back(promises.back().get_future());
+   }
+
+   for (auto i = 0; i < 1000; ++i)
+      promises[i].set_value(i);
+
+   // Assert
+   EXPECT_EQ(HugePage, resource.mapped_bytes());
+   EXPECT_EQ(999, futures.back().get());
+}
+
+TEST(HugePageResourceTest, Allocate_FromManyThreads)
+{
+   // Arrange
+   huge_page_resource resource(SmallRegions());
+   std::vector<std::thread> threads;
+
+   // Act
+   for (auto i = 0; i < 4; ++i)
+   {
+      threads.emplace_back([&resource]()
+      {
+         std::vector<void*> blocks;
+         for (auto i = 0; i < 1000; ++i)
+            blocks.push_back(resource.allocate(16 << (i % 4)));
+
+         for (auto i = 0; i < 1000; ++i)
+            resource.deallocate(blocks[i], 16 << (i % 4));
+      });
+   }
+
+   for (auto& thread : threads)
+      thread.join();
+
+   // Assert
+   EXPECT_GT(resource.mapped_bytes(), 0U);
+}
@@ -0,0 +1,302 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <eventual/eventual.h>
+#include <eventual/memory_resource.h>
+#include "CountingResource.h"
+#include "ManualExecutor.h"
+
+using namespace eventual;
+
+namespace
+{
+   class TestException { };
+
+   // restores the default resource when a test ends
+   class DefaultResourceScope
+   {
+   public:
+      explicit DefaultResourceScope(memory_resource* resource) : _previous(set_default_resource(resource)) { }
+      ~DefaultResourceScope() { set_default_resource(_previous); }
+
+   private:
+      memory_resource* _previous;
+   };
+
+   // a future of 'value' that is completed when 'executor' runs
+   template<class T>
+   future<T> Later(ManualExecutor& executor, T value)
+   {
+      auto promise = std::make_shared<eventual::promise<T>>();
+      executor.execute([promise, value]() { promise->set_value(value); });
+      return promise->get_future();
+   }
+
+   // completes promises on its own thread, in the order they are queued
+   class Worker
+   {
+   public:
+      Worker() : _stopped(false), _thread([this]() { Run(); }) { }
+
+      ~Worker()
+      {
+         {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopped = true;
+         }
+
+         _condition.notify_one();
+         _thread.join();
+      }
+
+      future<int> Complete(int value)
+      {
+         promise<int> promise;
+         auto future = promise.get_future();
+         {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _queue.emplace_back(std::move(promise), value);
+         }
+
+         _condition.notify_one();
+         return future;
+      }
+
+   private:
+      void Run()
+      {
+         std::unique_lock<std::mutex> lock(_mutex);
+         for (;;)
+         {
+            _condition.wait(lock, [this]() { return _stopped || !_queue.empty(); });
+            if (_queue.empty())
+               return;
+
+            auto next = std::move(_queue.front());
+            _queue.pop_front();
+
+            lock.unlock();
+            next.first.set_value(next.second);
+            lock.lock();
+         }
+      }
+
+      std::mutex _mutex;
+      std::condition_variable _condition;
+      std::deque<std::pair<promise<int>, int>> _queue;
+      bool _stopped;
+      std::thread _thread;
+   };
+}
+
+TEST(LoopTest, RepeatUntil_ReturnsTheAcceptedResult)
+{
+   // Arrange
+   auto calls = 0;
+
+   // Act
+   auto result = repeat_until([&calls]() { return make_ready_future(++calls); }, [](int value) { return value == 5; });
+
+   // Assert
+   ASSERT_TRUE(result.is_ready());
+   EXPECT_EQ(5, result.get());
+   EXPECT_EQ(5, calls);
+}
+
+TEST(LoopTest, RepeatUntil_ManyReadyIterations_DoNotGrowTheStack)
+{
+   // Arrange
+   const auto iterations = 1000000;
+   auto calls = 0;
+
+   // Act
+   auto result = repeat_until([&calls]() { return make_ready_future(++calls); }, [](int value) { return value == iterations; });
+
+   // Assert
+   EXPECT_EQ(iterations, result.get());
+}
+
+TEST(LoopTest, RepeatUntil_PendingIterations_ResumeWhenTheyComplete)
+{
+   // Arrange
+   ManualExecutor executor;
+   auto calls = 0;
+
+   // Act
+   auto result = repeat_until([&executor, &calls]() { return Later(executor, ++calls); }, [](int value) { return value == 1000; });
+
+   // Assert
+   EXPECT_FALSE(result.is_ready());
+   EXPECT_EQ(1, calls) << "The next iteration should wait for the current one.";
+
+   EXPECT_EQ(1000U, executor.RunAll());
+   ASSERT_TRUE(result.is_ready());
+   EXPECT_EQ(1000, result.get());
+}
+
+TEST(LoopTest, RepeatUntil_PendingIterations_RunInConstantMemory)
+{
+   // Arrange
+   CountingResource resource;
+   DefaultResourceScope scope(&resource);
+   ManualExecutor executor;
+   auto calls = 0;
+   auto mostOutstanding = 0;
+
+   auto result = repeat_until([&executor, &calls]() { return Later(executor, ++calls); }, [](int value) { return value == 10000; });
+
+   // Act
+   while (executor.RunOne())
+      mostOutstanding = std::max(mostOutstanding, resource.GetOutstanding());
+
+   // Assert
+   EXPECT_EQ(10000, result.get());
+   EXPECT_LE(mostOutstanding, 3) << "Only the loop and the current iteration should be allocated.";
+}
+
+TEST(LoopTest, RepeatUntil_IterationsCompletedOnAnotherThread)
+{
+   // Arrange
+   Worker worker;
+   auto calls = 0;
+
+   // Act
+   auto result = repeat_until([&worker, &calls]() { return worker.Complete(++calls); }, [](int value) { return value == 10000; });
+
+   // Assert
+   EXPECT_EQ(10000, result.get());
+   EXPECT_EQ(10000, calls);
+}
+
+TEST(LoopTest, RepeatUntil_Void_CallsThePredicateWithoutArguments)
+{
+   // Arrange
+   auto calls = 0;
+
+   // Act
+   future<void> result = repeat_until([&calls]() { ++calls; return make_ready_future(); }, [&calls]() { return calls == 3; });
+
+   // Assert
+   EXPECT_TRUE(result.is_ready());
+   EXPECT_NO_THROW(result.get());
+   EXPECT_EQ(3, calls);
+}
+
+TEST(LoopTest, RepeatUntil_Reference_ReturnsTheAcceptedReference)
+{
+   // Arrange
+   int values[3] = { 1, 2, 3 };
+   auto index = 0;
+
+   // Act
+   future<int&> result = repeat_until([&values, &index]() { return make_ready_future(std::ref(values[index++])); }, [](int& value) { return value == 2; });
+
+   // Assert
+   EXPECT_EQ(&values[1], &result.get());
+}
+
+TEST(LoopTest, RepeatUntil_BodyThrows_EndsTheLoopWithTheException)
+{
+   // Arrange
+   auto calls = 0;
+
+   // Act
+   auto result = repeat_until([&calls]() -> future<int>
+   {
+      if (++calls == 3)
+         throw TestException();
+
+      return make_ready_future(calls);
+   }, [](int) { return false; });
+
+   // Assert
+   EXPECT_THROW(result.get(), TestException);
+   EXPECT_EQ(3, calls);
+}
+
+TEST(LoopTest, RepeatUntil_ExceptionalIteration_EndsTheLoopWithTheException)
+{
+   // Arrange
+   ManualExecutor executor;
+   promise<int> failing;
+   auto calls = 0;
+
+   auto result = repeat_until([&executor, &failing, &calls]()
+   {
+      return ++calls < 3 ? Later(executor, calls) : failing.get_future();
+   }, [](int) { return false; });
+
+   executor.RunAll();
+
+   // Act
+   failing.set_exception(std::make_exception_ptr(TestException()));
+
+   // Assert
+   EXPECT_THROW(result.get(), TestException);
+   EXPECT_EQ(3, calls);
+}
+
+TEST(LoopTest, RepeatUntil_PredicateThrows_EndsTheLoopWithTheException)
+{
+   // Act
+   auto result = repeat_until([]() { return make_ready_future(1); }, [](int) -> bool { throw TestException(); });
+
+   // Assert
+   EXPECT_THROW(result.get(), TestException);
+}
+
+TEST(LoopTest, RepeatUntil_InvalidFuture_EndsTheLoopWithNoState)
+{
+   // Act
+   auto result = repeat_until([]() { return future<int>(); }, [](int) { return true; });
+
+   // Assert
+   EXPECT_THROW(result.get(), future_error);
+}
+
+TEST(LoopTest, AsyncWhile_FalseCondition_DoesNotCallTheBody)
+{
+   // Arrange
+   auto calls = 0;
+
+   // Act
+   auto result = async_while([]() { return false; }, [&calls]() { ++calls; return make_ready_future(); });
+
+   // Assert
+   EXPECT_TRUE(result.is_ready());
+   EXPECT_EQ(0, calls);
+}
+
+TEST(LoopTest, AsyncWhile_RunsTheBodyWhileTheConditionHolds)
+{
+   // Arrange
+   ManualExecutor executor;
+   auto calls = 0;
+
+   // Act
+   auto result = async_while([&calls]() { return calls < 100; }, [&executor, &calls]()
+   {
+      ++calls;
+      return Later(executor, 0).then([](auto&) { });
+   });
+
+   executor.RunAll();
+
+   // Assert
+   ASSERT_TRUE(result.is_ready());
+   EXPECT_NO_THROW(result.get());
+   EXPECT_EQ(100, calls);
+}
+
+TEST(LoopTest, AsyncWhile_ConditionThrows_ReturnsTheException)
+{
+   // Act
+   auto result = async_while([]() -> bool { throw TestException(); }, []() { return make_ready_future(); });
+
+   // Assert
+   EXPECT_THROW(result.get(), TestException);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+// an executor that queues each callable until the test runs it.
+class ManualExecutor
+{
+public:
+
+    ManualExecutor() : _posted(0) { }
+
+    template<class F>
+    void execute(F&& f)
+    {
+        // std::function requires a copyable target; the callables posted by eventual are move-only.
+        auto shared = std::make_shared<std::decay_t<F>>(std::forward<F>(f));
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queue.emplace_back([shared]() { (*shared)(); });
+        _posted++;
+    }
+
+    // runs the queued callables, including any they post, until the queue is empty.
+    std::size_t RunAll()
+    {
+        std::size_t ran = 0;
+        while (RunOne())
+            ran++;
+
+        return ran;
+    }
+
+    bool RunOne()
+    {
+        std::function<void()> next;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_queue.empty())
+                return false;
+
+            next = std::move(_queue.front());
+            _queue.pop_front();
+        }
+
+        next();
+        return true;
+    }
+
+    std::size_t GetPending() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _queue.size();
+    }
+
+    std::size_t GetPosted() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _posted;
+    }
+
+private:
+    mutable std::mutex _mutex;
+    std::deque<std::function<void()>> _queue;
+    std::size_t _posted;
+};
@@ -0,0 +1,162 @@
+#include "stdafx.h"
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <eventual/eventual.h>
+#include <eventual/memory_resource.h>
+#include "CountingResource.h"
+
+using namespace eventual;
+
+namespace
+{
+   bool IsAligned(void* p, std::size_t alignment)
+   {
+      return (reinterpret_cast<std::uintptr_t>(p) % alignment) == 0;
+   }
+}
+
+TEST(MonotonicBufferResourceTest, Allocate_FromInitialBuffer_DoesNotUseUpstream)
+{
+   // Arrange
+   CountingResource upstream;
+   alignas(std::max_align_t) char buffer[256];
+   monotonic_buffer_resource arena(buffer, sizeof(buffer), &upstream);
+
+   // Act
+   auto first = arena.allocate(32);
+   auto second = arena.allocate(32);
+
+   // Assert
+   EXPECT_EQ(0, upstream.GetAllocations());
+   EXPECT_GE(static_cast<char*>(first), buffer);
+   EXPECT_LT(static_cast<char*>(second), buffer + sizeof(buffer));
+   EXPECT_NE(first, second);
+}
+
+TEST(MonotonicBufferResourceTest, Allocate_ShouldRespectAlignment)
+{
+   // Arrange
+   monotonic_buffer_resource arena;
+   EXPECT_NE(nullptr, arena.allocate(1, 1));
+
+   // Act/Assert
+   for (std::size_t alignment = 1; alignment <= 256; alignment *= 2)
+      EXPECT_TRUE(IsAligned(arena.allocate(3, alignment), alignment)) << "alignment " << alignment;
+}
+
+TEST(MonotonicBufferResourceTest, Allocate_BeyondBuffer_GrowsGeometrically)
+{
+   // Arrange
+   CountingResource upstream;
+   monotonic_buffer_resource arena(64, &upstream);
+
+   // Act
+   for (auto i = 0; i < 1000; ++i)
+      EXPECT_NE(nullptr, arena.allocate(64));
+
+   // Assert
+   EXPECT_LE(upstream.GetAllocations(), 12) << "Each chunk should be larger than the last.";
+}
+
+TEST(MonotonicBufferResourceTest, Allocate_LargerThanNextChunk_Succeeds)
+{
+   // Arrange
+   CountingResource upstream;
+   monotonic_buffer_resource arena(64, &upstream);
+
+   // Act
+   auto p = static_cast<char*>(arena.allocate(4096));
+   p[0] = p[4095] = 1;
+
+   // Assert
+   EXPECT_EQ(1, upstream.GetAllocations());
+}
+
+TEST(MonotonicBufferResourceTest, Deallocate_ShouldNotReturnMemory)
+{
+   // Arrange
+   CountingResource upstream;
+   monotonic_buffer_resource arena(&upstream);
+   auto p = arena.allocate(16);
+
+   // Act
+   arena.deallocate(p, 16);
+
+   // Assert
+   EXPECT_EQ(0, upstream.GetDeallocations());
+   EXPECT_NE(p, arena.allocate(16)) << "Memory should not be reused before release.";
+}
+
+TEST(MonotonicBufferResourceTest, Release_ShouldReturnEveryChunkAndReuseTheBuffer)
+{
+   // Arrange
+   CountingResource upstream;
+   alignas(std::max_align_t) char buffer[64];
+   monotonic_buffer_resource arena(buffer, sizeof(buffer), &upstream);
+
+   auto first = arena.allocate(48);
+   for (auto i = 0; i < 100; ++i)
+      EXPECT_NE(nullptr, arena.allocate(48));
+
+   // Act
+   arena.release();
+
+   // Assert
+   EXPECT_GT(upstream.GetAllocations(), 0);
+   EXPECT_EQ(0, upstream.GetOutstanding());
+   EXPECT_EQ(first, arena.allocate(48));
+}
+
+TEST(MonotonicBufferResourceTest, Destructor_ShouldReturnEveryChunk)
+{
+   // Arrange
+   CountingResource upstream;
+
+   // Act
+   {
+      monotonic_buffer_resource arena(&upstream);
+      for (auto i = 0; i < 100; ++i)
+         EXPECT_NE(nullptr, arena.allocate(100));
+   }
+
+   // Assert
+   EXPECT_EQ(0, upstream.GetOutstanding());
+}
+
+TEST(MonotonicBufferResourceTest, IsEqual_OnlyToItself)
+{
+   // Arrange
+   monotonic_buffer_resource first;
+   monotonic_buffer_resource second;
+
+   // Act/Assert
+   EXPECT_TRUE(first == first);
+   EXPECT_FALSE(first == second);
+   EXPECT_EQ(get_default_resource(), first.upstream_resource());
+}
+
+TEST(MonotonicBufferResourceTest, Promise_PassesArenaToEveryContinuation)
+{
+   // Arrange
+   CountingResource upstream;
+   monotonic_buffer_resource arena(&upstream);
+   promise<int> promise { std::allocator_arg_t(), polymorphic_allocator<int>(&arena) };
+
+   // the arena takes its first chunk for the promise's state
+   auto chunks = upstream.GetAllocations();
+
+   // Act
+   auto result = promise.get_future()
+      .then([](auto& f) { return f.get() + 1; })
+      .then([](auto& f) { return f.get() * 2; })
+      .then([](auto& f) { return std::vector<int>(3, f.get()); });
+
+   promise.set_value(1);
+
+   // Assert
+   EXPECT_EQ(1, chunks);
+   EXPECT_EQ(std::vector<int>(3, 4), result.get());
+   EXPECT_EQ(1, upstream.GetAllocations()) << "Every continuation should come from the arena's first chunk.";
+   EXPECT_EQ(0, upstream.GetDeallocations());
+}
@@ -28,7 +28,7 @@ protected:
         (void)p;
     }
 
-    virtual bool do_is_equal(const memory_resource& other) const override
+    virtual bool do_is_equal(const memory_resource& other) const noexcept override
     {
         return this == std::addressof(other);
     }
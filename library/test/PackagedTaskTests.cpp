@@ -1,14 +1,19 @@
 #include "stdafx.h"
+#include <array>
 #include <thread>
 #include <cstdint>
+#include <memory>
 #include <eventual/eventual.h>
 #include "BasicAllocator.h"
+#include "CountingResource.h"
 
 using namespace eventual;
 
 namespace
 {
    class PackagedTaskTestException { };
+
+   int Return2() { return 2; }
 }
 
 TEST(PackagedTaskTest, DefaultConstructorCreatesInvalidTask)
@@ -536,6 +541,65 @@ TEST(PackagedTaskTest, Reset_ResetsPromiseState)
    EXPECT_FALSE(future.is_ready());
 }
 
+TEST(PackagedTaskTest, Reset_OnlyReference_ReusesTheState)
+{
+   // Arrange
+   CountingResource resource;
+   packaged_task<int(int)> task(std::allocator_arg_t(), &resource, [](int i) { return i; });
+   auto allocations = resource.GetAllocations();
+
+   // Act
+   for (int i = 0; i < 10; ++i)
+   {
+      auto future = task.get_future();
+      task(i);
+      EXPECT_EQ(i, future.get());
+
+      future = eventual::future<int>();
+      task.reset();
+   }
+
+   // Assert
+   EXPECT_EQ(allocations, resource.GetAllocations());
+}
+
+TEST(PackagedTaskTest, Reset_Unsatisfied_BreaksThePromise)
+{
+   // Arrange
+   packaged_task<int(int)> task([](int i) { return i; });
+   auto future = task.get_future();
+
+   // Act
+   task.reset();
+   task(1);
+
+   // Assert
+   EXPECT_THROW(future.get(), std::future_error);
+   EXPECT_EQ(1, task.get_future().get());
+}
+
+TEST(PackagedTaskTest, Reset_NestedFutureFromItsContinuation_StartsAgain)
+{
+   // Arrange
+   packaged_task<future<int>(int)> task([](int i) { return make_ready_future(i); });
+   int sum = 0;
+
+   // Act
+   for (int i = 1; i <= 3; ++i)
+   {
+      task.get_future().then([&task, &sum](future<int> f)
+      {
+         sum += f.get();
+         task.reset();
+      });
+
+      task(i);
+   }
+
+   // Assert
+   EXPECT_EQ(6, sum);
+}
+
 TEST(PackagedTaskTest, Reset_ThrowsIfTaskIsInvalid)
 {
    // Arrange
@@ -544,3 +608,46 @@ TEST(PackagedTaskTest, Reset_ThrowsIfTaskIsInvalid)
    // Act/Assert
    EXPECT_THROW(task.reset(), std::future_error);
 }
+
+TEST(PackagedTaskTest, Constructor_AcceptsMoveOnlyCallables)
+{
+   // Arrange
+   auto value = std::make_unique<int>(8);
+   packaged_task<int(int)> task([value = std::move(value)](int i) { return *value + i; });
+   auto future = task.get_future();
+
+   // Act
+   task(1);
+
+   // Assert
+   EXPECT_EQ(9, future.get());
+}
+
+TEST(PackagedTaskTest, ConstructorWithAllocator_HoldsSmallCallableInTheTask)
+{
+   // Arrange
+   auto baseline = BasicAllocator<int>();
+   auto alloc = BasicAllocator<int>();
+   auto value = std::make_unique<int>(2);
+
+   packaged_task<int()> plain(std::allocator_arg_t(), baseline, &Return2);
+
+   // Act
+   packaged_task<int()> task(std::allocator_arg_t(), alloc, [value = std::move(value)]() { return *value; });
+
+   // Assert
+   EXPECT_EQ(baseline.GetCount(), alloc.GetCount()) << "A small callable should not need an allocation of its own.";
+}
+
+TEST(PackagedTaskTest, ConstructorWithAllocator_AcceptsAMemoryResource)
+{
+   // Arrange
+   CountingResource resource;
+   std::array<char, 2 * default_function_storage> block{};
+
+   // Act
+   packaged_task<int()> task(std::allocator_arg_t(), &resource, [block]() { return static_cast<int>(block.size()); });
+
+   // Assert
+   EXPECT_EQ(2, resource.GetAllocations()) << "The state and the spilled callable should come from the resource.";
+}
@@ -0,0 +1,262 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <eventual/eventual.h>
+#include <eventual/memory_resource.h>
+#include "CountingResource.h"
+
+using namespace eventual;
+
+namespace
+{
+   bool IsAligned(void* p, std::size_t alignment)
+   {
+      return (reinterpret_cast<std::uintptr_t>(p) % alignment) == 0;
+   }
+
+   // restores the default resource when a test ends
+   class DefaultResourceScope
+   {
+   public:
+      explicit DefaultResourceScope(memory_resource* resource) : _previous(set_default_resource(resource)) { }
+      ~DefaultResourceScope() { set_default_resource(_previous); }
+
+   private:
+      memory_resource* _previous;
+   };
+}
+
+// Typed Tests
+template<typename T>
+class PoolResourceTest : public testing::Test { };
+typedef testing::Types<unsynchronized_pool_resource, synchronized_pool_resource> PoolResourceTypes;
+TYPED_TEST_CASE(PoolResourceTest, PoolResourceTypes); // ignore intellisense warning
+
+TYPED_TEST(PoolResourceTest, Allocate_SmallBlocks_RefillsFromUpstreamInChunks)
+{
+   // Arrange
+   CountingResource upstream;
+   TypeParam pool(&upstream);
+
+   // Act
+   for (auto i = 0; i < 1000; ++i)
+      EXPECT_NE(nullptr, pool.allocate(48));
+
+   // Assert
+   EXPECT_LE(upstream.GetAllocations(), 10) << "Blocks should be taken from upstream a chunk at a time.";
+}
+
+TYPED_TEST(PoolResourceTest, Deallocate_ShouldRecycleTheBlock)
+{
+   // Arrange
+   CountingResource upstream;
+   TypeParam pool(&upstream);
+   auto p = pool.allocate(100);
+   auto allocations = upstream.GetAllocations();
+
+   // Act
+   pool.deallocate(p, 100);
+
+   // Assert
+   EXPECT_EQ(p, pool.allocate(100));
+   EXPECT_EQ(0, upstream.GetDeallocations());
+   EXPECT_EQ(allocations, upstream.GetAllocations());
+}
+
+TYPED_TEST(PoolResourceTest, Allocate_StateSizedBlocks_UseAQuarterStepClass)
+{
+   // Arrange
+   TypeParam pool;
+
+   // Act (a State<int> is about 144 bytes; its class is 160, not 256)
+   auto first = static_cast<char*>(pool.allocate(144));
+   auto second = static_cast<char*>(pool.allocate(144));
+   pool.deallocate(second, 144);
+
+   // Assert
+   EXPECT_EQ(160, second - first) << "Consecutive blocks of a chunk should be one class apart.";
+   EXPECT_EQ(second, pool.allocate(160)) << "A block should be recycled for any size of its class.";
+
+   auto next = pool.allocate(161);
+   EXPECT_NE(second + 160, next);
+
+   pool.deallocate(next, 161);
+   pool.deallocate(second, 160);
+   pool.deallocate(first, 144);
+}
+
+TYPED_TEST(PoolResourceTest, Allocate_EverySize_IsAlignedAndDoesNotOverlap)
+{
+   // Arrange
+   TypeParam pool;
+   std::vector<std::pair<unsigned char*, std::size_t>> blocks;
+
+   // Act
+   for (std::size_t bytes = 1; bytes <= 1024; bytes += 3)
+   {
+      auto p = static_cast<unsigned char*>(pool.allocate(bytes));
+      std::fill(p, p + bytes, static_cast<unsigned char>(bytes));
+      blocks.emplace_back(p, bytes);
+   }
+
+   // Assert
+   for (auto& block : blocks)
+   {
+      EXPECT_TRUE(IsAligned(block.first, alignof(std::max_align_t))) << block.second << " bytes";
+      for (std::size_t i = 0; i < block.second; ++i)
+         ASSERT_EQ(static_cast<unsigned char>(block.second), block.first[i]) << block.second << " bytes overlap another block";
+
+      pool.deallocate(block.first, block.second);
+   }
+}
+
+TYPED_TEST(PoolResourceTest, Allocate_ShouldRespectAlignment)
+{
+   // Arrange
+   TypeParam pool;
+
+   // Act/Assert
+   for (std::size_t alignment = 1; alignment <= 256; alignment *= 2)
+   {
+      for (std::size_t bytes = 1; bytes <= 64; bytes += 7)
+      {
+         auto p = pool.allocate(bytes, alignment);
+         EXPECT_TRUE(IsAligned(p, alignment)) << bytes << " bytes, alignment " << alignment;
+         pool.deallocate(p, bytes, alignment);
+      }
+   }
+}
+
+TYPED_TEST(PoolResourceTest, Allocate_LargerThanLargestBlock_GoesToUpstream)
+{
+   // Arrange
+   CountingResource upstream;
+   TypeParam pool(&upstream);
+   const auto bytes = pool.options().largest_required_pool_block + 1;
+
+   // Act
+   auto p = pool.allocate(bytes);
+   pool.deallocate(p, bytes);
+
+   // Assert
+   EXPECT_EQ(1, upstream.GetAllocations());
+   EXPECT_EQ(0, upstream.GetOutstanding());
+}
+
+TYPED_TEST(PoolResourceTest, Release_ShouldReturnEveryChunk)
+{
+   // Arrange
+   CountingResource upstream;
+   TypeParam pool(&upstream);
+
+   for (std::size_t bytes = 8; bytes <= 512; bytes *= 2)
+   {
+      for (auto i = 0; i < 100; ++i)
+         EXPECT_NE(nullptr, pool.allocate(bytes));
+   }
+
+   // Act
+   pool.release();
+
+   // Assert
+   EXPECT_GT(upstream.GetAllocations(), 0);
+   EXPECT_EQ(0, upstream.GetOutstanding());
+}
+
+TYPED_TEST(PoolResourceTest, Options_AreRoundedToTheSizeClasses)
+{
+   // Arrange
+   pool_options options;
+   options.largest_required_pool_block = 100;
+   options.max_blocks_per_chunk = 32;
+
+   // Act
+   TypeParam pool(options);
+
+   // Assert
+   EXPECT_EQ(112U, pool.options().largest_required_pool_block);
+   EXPECT_EQ(32U, pool.options().max_blocks_per_chunk);
+   EXPECT_EQ(get_default_resource(), pool.upstream_resource());
+}
+
+TYPED_TEST(PoolResourceTest, IsEqual_OnlyToItself)
+{
+   // Arrange
+   TypeParam first;
+   TypeParam second;
+
+   // Act/Assert
+   EXPECT_TRUE(first == first);
+   EXPECT_FALSE(first == second);
+}
+
+TYPED_TEST(PoolResourceTest, SetDefaultResource_RecyclesStatesThroughThePool)
+{
+   // Arrange
+   CountingResource upstream;
+   TypeParam pool(&upstream);
+   DefaultResourceScope scope(&pool);
+
+   // Act
+   for (auto i = 0; i < 100; ++i)
+   {
+      promise<int> promise;
+      auto result = promise.get_future().then([](auto& f) { return f.get() + 1; });
+      promise.set_value(i);
+
+      EXPECT_EQ(i + 1, result.get());
+   }
+
+   // Assert
+   EXPECT_GT(upstream.GetAllocations(), 0);
+   EXPECT_LE(upstream.GetAllocations(), 4) << "States should be recycled rather than allocated anew.";
+}
+
+TEST(PoolResourceTest, SynchronizedPool_AllowsConcurrentAllocation)
+{
+   // Arrange
+   synchronized_pool_resource pool;
+   std::vector<std::thread> threads;
+
+   // Act
+   for (auto i = 0; i < 4; ++i)
+   {
+      threads.emplace_back([&pool]()
+      {
+         std::vector<void*> blocks;
+         for (auto i = 0; i < 1000; ++i)
+            blocks.push_back(pool.allocate(16 << (i % 4)));
+
+         for (auto i = 0; i < 1000; ++i)
+            pool.deallocate(blocks[i], 16 << (i % 4));
+      });
+   }
+
+   for (auto& thread : threads)
+      thread.join();
+
+   // Assert
+   SUCCEED();
+}
+
+TEST(DefaultResourceTest, SetDefaultResource_ReturnsThePreviousResource)
+{
+   // Arrange
+   unsynchronized_pool_resource pool;
+
+   // Act
+   auto previous = set_default_resource(&pool);
+   auto replaced = get_default_resource();
+   auto restored = set_default_resource(nullptr);
+
+   // Assert
+   EXPECT_EQ(new_delete_resource(), previous);
+   EXPECT_EQ(&pool, replaced);
+   EXPECT_EQ(&pool, restored);
+   EXPECT_EQ(new_delete_resource(), get_default_resource());
+   EXPECT_EQ(new_delete_resource(), polymorphic_allocator<int>().resource());
+}
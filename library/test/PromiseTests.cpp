@@ -1,8 +1,11 @@
 #include "stdafx.h"
 #include <exception>
 #include <thread>
+#include <atomic>
+#include <vector>
 #include <eventual/eventual.h>
 #include "BasicAllocator.h"
+#include "CountingResource.h"
 #include "NonCopyable.h"
 
 using namespace eventual;
@@ -70,6 +73,31 @@ TYPED_TEST(PromiseTest, CustomAllocatorConstructorCreatesValidState)
    EXPECT_GT(alloc.GetCount(), 0) << "Custom allocator did not detect any heap creation.";
 }
 
+TYPED_TEST(PromiseTest, CustomAllocatorConstructor_AllocatesOnce)
+{
+   // Arrange
+   auto alloc = BasicAllocator<int>();
+
+   // Act
+   promise<TypeParam> promise(std::allocator_arg_t(), alloc);
+
+   // Assert
+   EXPECT_EQ(1, alloc.GetCount()) << "The state should share its allocation with the allocator's adapter.";
+}
+
+TEST(PromiseTest, CustomAllocatorConstructor_AcceptsAMemoryResource)
+{
+   // Arrange
+   CountingResource resource;
+
+   // Act
+   promise<int> promise(std::allocator_arg_t(), &resource);
+   auto continuation = promise.get_future().then([](auto& f) { return f.get(); });
+
+   // Assert
+   EXPECT_EQ(2, resource.GetAllocations()) << "The state and its continuation should come from the resource.";
+}
+
 TYPED_TEST(PromiseTest, IsMoveConstructable)
 {
    // Arrange
@@ -386,6 +414,87 @@ TYPED_TEST(PromiseTest, SetValue_ReleasesContinuations)
     EXPECT_EQ(1, shared_data.use_count());
 }
 
+TYPED_TEST(PromiseTest, SetValue_InvokesContinuationsInRegistrationOrder)
+{
+    // Arrange
+    std::vector<int> order;
+
+    promise<TypeParam> promise{};
+    auto future = promise.get_future().share();
+
+    for (auto i = 0; i < 4; i++)
+        future.then([&order, i](auto&) { order.push_back(i); });
+
+    // Act
+    CompletePromise(promise);
+
+    // Assert
+    EXPECT_EQ((std::vector<int>{ 0, 1, 2, 3 }), order);
+}
+
+TYPED_TEST(PromiseTest, SetValue_RacingContinuations_InvokesEachContinuationOnce)
+{
+    // Arrange
+    constexpr auto iterations = 1000;
+    std::vector<promise<TypeParam>> promises(iterations);
+    std::vector<future<TypeParam>> futures;
+    std::atomic<int> invocations(0);
+
+    for (auto& promise : promises)
+        futures.emplace_back(promise.get_future());
+
+    // Act
+    std::thread producer([&promises]()
+    {
+        for (auto& promise : promises)
+            CompletePromise(promise);
+    });
+
+    for (auto& future : futures)
+        future.then([&invocations](auto&) { invocations++; });
+
+    producer.join();
+
+    // Assert
+    EXPECT_EQ(iterations, invocations.load());
+}
+
+TYPED_TEST(PromiseTest, SetValue_ContinuationReplacesPromise_CompletesSafely)
+{
+    // Arrange
+    promise<TypeParam> completing;
+    auto invoked = false;
+
+    completing.get_future().then([&completing, &invoked](auto& f)
+    {
+        // releases the reference of the promise that is still completing the state
+        completing = promise<TypeParam>();
+        invoked = f.is_ready();
+    });
+
+    // Act
+    CompletePromise(completing);
+
+    // Assert
+    EXPECT_TRUE(invoked);
+}
+
+TEST(PromiseTest_Future, SetValue_ContinuationResetsPromise_CompletesSafely)
+{
+   // Arrange
+   promise<future<int>> completing;
+   auto unwrapped = completing.get_future();
+
+   // the nested future's state is embedded in the one that the promise releases here
+   auto continued = unwrapped.then([&completing](auto&&) { completing.reset(); return 5; });
+
+   // Act
+   completing.set_value(make_ready_future(1));
+
+   // Assert
+   EXPECT_EQ(5, continued.get());
+}
+
 TEST(PromiseTest_Value, SetValue_CopiesValueIntoState)
 {
    // Arrange
@@ -943,3 +1052,261 @@ TEST(PromiseTest, CanCreateDeeplyNestedFutures)
     // Assert
     SUCCEED();
 }
+
+namespace
+{
+   // counts the instances that are alive
+   struct Tracked
+   {
+      static int& Alive() { static int alive = 0; return alive; }
+
+      Tracked() { ++Alive(); }
+      Tracked(const Tracked&) { ++Alive(); }
+      Tracked(Tracked&&) { ++Alive(); }
+      ~Tracked() { --Alive(); }
+   };
+
+   // counts the instances that are destroyed
+   struct ThrowsOnCopy
+   {
+      static int& Destroyed() { static int destroyed = 0; return destroyed; }
+
+      ThrowsOnCopy() = default;
+      ThrowsOnCopy(const ThrowsOnCopy&) { throw PromiseTestException(); }
+      ~ThrowsOnCopy() { ++Destroyed(); }
+   };
+}
+
+TEST(PromiseTest, SetValue_TheValueIsDestroyedWithTheState)
+{
+   {
+      promise<Tracked> promise;
+      auto future = promise.get_future();
+      promise.set_value(Tracked());
+      auto value = future.get();
+
+      EXPECT_EQ(2, Tracked::Alive()) << "The state should still hold the moved-from value.";
+   }
+
+   EXPECT_EQ(0, Tracked::Alive());
+}
+
+TEST(PromiseTest, SetException_NoValueIsDestroyed)
+{
+   {
+      promise<Tracked> promise;
+      auto future = promise.get_future();
+      promise.set_exception(std::make_exception_ptr(PromiseTestException()));
+
+      EXPECT_THROW(future.get(), PromiseTestException);
+   }
+
+   EXPECT_EQ(0, Tracked::Alive());
+}
+
+TEST(PromiseTest, SetValue_ThrowingConstructor_NoValueIsDestroyed)
+{
+   ThrowsOnCopy source;
+   {
+      promise<ThrowsOnCopy> promise;
+      auto future = promise.get_future();
+
+      EXPECT_THROW(promise.set_value(source), PromiseTestException);
+   }
+
+   EXPECT_EQ(0, ThrowsOnCopy::Destroyed());
+}
+
+TEST(PromiseTest, Reset_OnlyReference_ReusesTheState)
+{
+   // Arrange
+   CountingResource resource;
+   promise<int> promise(std::allocator_arg_t(), &resource);
+
+   // Act
+   for (int i = 0; i < 10; ++i)
+   {
+      auto future = promise.get_future();
+      promise.set_value(i);
+      EXPECT_EQ(i, future.get());
+
+      future = eventual::future<int>();
+      promise.reset();
+   }
+
+   // Assert
+   EXPECT_EQ(1, resource.GetAllocations());
+}
+
+TEST(PromiseTest, Reset_OnlyReference_DestroysTheValue)
+{
+   {
+      promise<Tracked> promise;
+      promise.set_value(Tracked());
+
+      // Act
+      promise.reset();
+
+      // Assert
+      EXPECT_EQ(0, Tracked::Alive());
+   }
+
+   EXPECT_EQ(0, Tracked::Alive());
+}
+
+TEST(PromiseTest, Reset_ContinuationRan_ReusesTheState)
+{
+   // Arrange
+   CountingResource resource;
+   promise<int> promise(std::allocator_arg_t(), &resource);
+   int sum = 0;
+
+   // Act
+   for (int i = 1; i <= 10; ++i)
+   {
+      promise.get_future().then([&sum](future<int>& f) { sum += f.get(); });
+      promise.set_value(i);
+      promise.reset();
+   }
+
+   // Assert
+   EXPECT_EQ(55, sum);
+   EXPECT_EQ(11, resource.GetAllocations()) << "Only the continuations' futures should be allocated after the first State.";
+}
+
+TEST(PromiseTest, Reset_FutureStillHeld_AllocatesANewState)
+{
+   // Arrange
+   CountingResource resource;
+   promise<int> promise(std::allocator_arg_t(), &resource);
+   auto first = promise.get_future();
+   promise.set_value(1);
+
+   // Act
+   promise.reset();
+   auto second = promise.get_future();
+   promise.set_value(2);
+
+   // Assert
+   EXPECT_EQ(2, resource.GetAllocations());
+   EXPECT_EQ(1, first.get());
+   EXPECT_EQ(2, second.get());
+}
+
+TEST(PromiseTest, Reset_Unsatisfied_BreaksThePromise)
+{
+   // Arrange
+   promise<int> promise;
+   auto future = promise.get_future();
+
+   // Act
+   promise.reset();
+
+   // Assert
+   try
+   {
+      future.get();
+      FAIL() << "The abandoned future should be broken.";
+   }
+   catch (const future_error& error)
+   {
+      EXPECT_EQ(make_error_code(future_errc::broken_promise), error.code());
+   }
+}
+
+TEST(PromiseTest, Reset_UnsatisfiedWithContinuation_RunsItWithABrokenPromise)
+{
+   // Arrange
+   CountingResource resource;
+   promise<int> promise(std::allocator_arg_t(), &resource);
+   bool broken = false;
+   auto continued = promise.get_future().then([&broken](future<int> f)
+   {
+      try
+      {
+         f.get();
+      }
+      catch (const future_error& error)
+      {
+         broken = (error.code() == make_error_code(future_errc::broken_promise));
+      }
+   });
+
+   // Act
+   promise.reset();
+
+   // Assert
+   EXPECT_TRUE(broken) << "The pending continuation should observe the broken promise.";
+   EXPECT_NO_THROW(continued.get());
+
+   auto future = promise.get_future();
+   promise.set_value(1);
+   EXPECT_EQ(1, future.get());
+}
+
+TEST(PromiseTest, Reset_DroppedWhenAnyLoser_ReusesTheState)
+{
+   // Arrange
+   CountingResource resource;
+   promise<int> winner;
+   promise<int> loser(std::allocator_arg_t(), &resource);
+   when_any(winner.get_future(), loser.get_future()).then([](auto) { });
+   winner.set_value(0);
+
+   // Act
+   loser.reset();
+   EXPECT_EQ(1, resource.GetAllocations()) << "The loser's callback should be discarded and its State reused.";
+
+   auto continued = loser.get_future().then([](future<int> f) { return f.get() + 1; });
+   loser.set_value(41);
+
+   // Assert
+   EXPECT_EQ(42, continued.get());
+}
+
+TEST(PromiseTest, Reset_NestedFuture_StartsAgain)
+{
+   // Arrange
+   promise<future<int>> promise;
+   promise.set_value(make_ready_future(1));
+
+   // Act
+   promise.reset();
+   future<int> future(promise.get_future());
+   promise.set_value(make_ready_future(2));
+
+   // Assert
+   EXPECT_EQ(2, future.get());
+}
+
+TEST(PromiseTest, Reset_NestedFutureFromItsContinuation_StartsAgain)
+{
+   // Arrange
+   promise<future<int>> promise;
+   int sum = 0;
+
+   // Act
+   for (int i = 1; i <= 3; ++i)
+   {
+      promise.get_future().then([&promise, &sum](future<int> f)
+      {
+         sum += f.get();
+         promise.reset();
+      });
+
+      promise.set_value(make_ready_future(i));
+   }
+
+   // Assert
+   EXPECT_EQ(6, sum);
+}
+
+TEST(PromiseTest, Reset_NoState_Throws)
+{
+   // Arrange
+   promise<int> promise;
+   auto moved = std::move(promise);
+
+   // Act, Assert
+   EXPECT_THROW(promise.reset(), future_error);
+}
@@ -5,6 +5,7 @@
 #include <eventual/eventual.h>
 
 #include "BasicAllocator.h"
+#include "CountingResource.h"
 
 namespace
 {
@@ -205,3 +206,74 @@ TEST(ResourceAdapterTest, OperatorNotEqual_Should_ReturnFalse_IfImplementationsA
     EXPECT_FALSE(first != second);
 }
 
+TEST(ResourceAdapterTest, IsEqual_Should_ReturnFalse_ForAnotherKindOfResource)
+{
+    // Arrange
+    resource_adapter<BasicAllocator<int>> adapter { };
+    CountingResource other;
+
+    // Act/Assert
+    EXPECT_FALSE(adapter.is_equal(other));
+#if !EVENTUAL_STD_PMR
+    EXPECT_NE(adapter.type_key(), other.type_key());
+#endif
+}
+
+TEST(ResourceAdapterTest, IsEqual_Should_ReturnFalse_ForAnAdapterWithABlockOfTheSameAllocator)
+{
+    // Arrange
+    resource_adapter<BasicAllocator<int>> first { };
+    resource_adapter_with_block<BasicAllocator<int>, double> second(BasicAllocator<char>{});
+
+    // Act/Assert
+    EXPECT_FALSE(first.is_equal(second));
+    EXPECT_FALSE(second.is_equal(first));
+}
+
+TEST(ResourceAdapterWithBlockTest, IsEqual_Should_ReturnTrue_OnlyForItself)
+{
+    // Arrange
+    resource_adapter_with_block<BasicAllocator<int>, double> first(BasicAllocator<char>{});
+    resource_adapter_with_block<BasicAllocator<int>, double> second(BasicAllocator<char>{});
+
+    // Act/Assert
+    EXPECT_TRUE(first.is_equal(first));
+    EXPECT_FALSE(first.is_equal(second));
+}
+
+TEST(ResourceAdapterWithBlockTest, Allocate_Should_ServeTheBlockToOneRequestAtATime)
+{
+    // Arrange
+    BasicAllocator<char> allocator;
+    auto adapter = resource_adapter_with_block<BasicAllocator<char>, double>::create_shared(allocator);
+    const auto adapterOnly = allocator.GetCount();
+
+    // Act
+    auto first = adapter->allocate(sizeof(double), alignof(double));
+    auto second = adapter->allocate(sizeof(double), alignof(double));
+
+    // Assert
+    EXPECT_EQ(1, adapterOnly);
+    EXPECT_EQ(2, allocator.GetCount()) << "Only the second request should go to the allocator.";
+
+    adapter->deallocate(first, sizeof(double), alignof(double));
+    adapter->deallocate(second, sizeof(double), alignof(double));
+
+    EXPECT_EQ(1, allocator.GetCount());
+    EXPECT_EQ(first, adapter->allocate(sizeof(double), alignof(double))) << "The block should be reused once released.";
+}
+
+TEST(ResourceAdapterWithBlockTest, Allocate_Should_NotServeTheBlockToALargerRequest)
+{
+    // Arrange
+    BasicAllocator<char> allocator;
+    auto adapter = resource_adapter_with_block<BasicAllocator<char>, int>::create_shared(allocator);
+
+    // Act
+    auto p = adapter->allocate(2 * sizeof(int), alignof(int));
+
+    // Assert
+    EXPECT_EQ(2, allocator.GetCount());
+
+    adapter->deallocate(p, 2 * sizeof(int), alignof(int));
+}
@@ -47,6 +47,32 @@ TYPED_TEST(SharedFutureTest, SharedFuture_IsCopyConstructable)
    EXPECT_TRUE(copy.valid()) << "Copied shared future is not valid.";
 }
 
+TYPED_TEST(SharedFutureTest, SharedFuture_IsASinglePointer)
+{
+   // Assert
+   EXPECT_EQ(sizeof(void*), sizeof(shared_future<TypeParam>)) << "Shared future should only hold a pointer to its state.";
+}
+
+TYPED_TEST(SharedFutureTest, SharedFuture_CopiesShareOneState)
+{
+   // Arrange
+   promise<TypeParam> promise;
+   auto future = promise.get_future().share();
+   auto invocations = 0;
+
+   // Act
+   {
+      auto copy = future;
+      copy.then([&invocations](auto&) { invocations++; });
+   }
+   future.then([&invocations](auto&) { invocations++; });
+   promise.set_exception(std::make_exception_ptr(std::exception()));
+
+   // Assert
+   EXPECT_EQ(2, invocations);
+   EXPECT_TRUE(future.valid());
+}
+
 TYPED_TEST(SharedFutureTest, SharedFuture_ConstructorUnwrapsNestedFutures)
 {
    // Arrange
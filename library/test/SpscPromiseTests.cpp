@@ -0,0 +1,321 @@
+#include "stdafx.h"
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <eventual/eventual.h>
+#include "CountingResource.h"
+
+using namespace eventual;
+
+namespace
+{
+   class TestException { };
+
+   // the error code of the future_error thrown by 'function', if any.
+   template<class F>
+   std::error_code ErrorOf(F&& function)
+   {
+      try
+      {
+         function();
+      }
+      catch (const future_error& error)
+      {
+         return error.code();
+      }
+
+      return std::error_code();
+   }
+
+   struct ThrowsOnCopy
+   {
+      ThrowsOnCopy() = default;
+      ThrowsOnCopy(const ThrowsOnCopy&) { throw TestException(); }
+   };
+}
+
+TEST(SpscPromiseTest, SetValue_GetReturnsTheValue)
+{
+   // Arrange
+   spsc_promise<std::string> promise;
+   auto future = promise.get_future();
+
+   // Act
+   promise.set_value("value");
+
+   // Assert
+   EXPECT_TRUE(future.is_ready());
+   EXPECT_EQ("value", future.get());
+}
+
+TEST(SpscPromiseTest, SetValue_Reference_GetReturnsTheReference)
+{
+   // Arrange
+   int value = 0;
+   spsc_promise<int&> promise;
+   auto future = promise.get_future();
+
+   // Act
+   promise.set_value(value);
+
+   // Assert
+   EXPECT_EQ(&value, &future.get());
+}
+
+TEST(SpscPromiseTest, SetValue_Void_CompletesTheFuture)
+{
+   // Arrange
+   spsc_promise<void> promise;
+   auto future = promise.get_future();
+
+   // Act
+   promise.set_value();
+
+   // Assert
+   EXPECT_TRUE(future.is_ready());
+   EXPECT_NO_THROW(future.get());
+}
+
+TEST(SpscPromiseTest, SetValue_Twice_Throws)
+{
+   // Arrange
+   spsc_promise<int> promise;
+   auto future = promise.get_future();
+   promise.set_value(1);
+
+   // Act, Assert
+   EXPECT_EQ(make_error_code(future_errc::promise_already_satisfied), ErrorOf([&]() { promise.set_value(2); }));
+   EXPECT_EQ(make_error_code(future_errc::promise_already_satisfied), ErrorOf([&]() { promise.set_exception(std::make_exception_ptr(TestException())); }));
+   EXPECT_EQ(1, future.get());
+}
+
+TEST(SpscPromiseTest, SetException_GetThrows)
+{
+   // Arrange
+   spsc_promise<int> promise;
+   auto future = promise.get_future();
+
+   // Act
+   promise.set_exception(std::make_exception_ptr(TestException()));
+
+   // Assert
+   EXPECT_THROW(future.get(), TestException);
+}
+
+TEST(SpscPromiseTest, SetValue_ThrowingConstructor_LeavesThePromiseUnsatisfied)
+{
+   // Arrange
+   spsc_promise<ThrowsOnCopy> promise;
+   auto future = promise.get_future();
+   ThrowsOnCopy value;
+
+   // Act
+   EXPECT_THROW(promise.set_value(value), TestException);
+   promise.set_exception(std::make_exception_ptr(TestException()));
+
+   // Assert
+   EXPECT_THROW(future.get(), TestException);
+}
+
+TEST(SpscPromiseTest, Destroy_Unsatisfied_BreaksThePromise)
+{
+   // Arrange
+   future<int> future;
+   {
+      spsc_promise<int> promise;
+      future = promise.get_future();
+   }
+
+   // Assert
+   EXPECT_EQ(make_error_code(future_errc::broken_promise), ErrorOf([&]() { future.get(); }));
+}
+
+TEST(SpscPromiseTest, Destroy_Satisfied_KeepsTheValue)
+{
+   // Arrange
+   future<int> future;
+   {
+      spsc_promise<int> promise;
+      future = promise.get_future();
+      promise.set_value(1);
+   }
+
+   // Assert
+   EXPECT_EQ(1, future.get()) << "Abandoning a kept promise should not break it.";
+}
+
+TEST(SpscPromiseTest, MoveAssign_Unsatisfied_BreaksThePromise)
+{
+   // Arrange
+   spsc_promise<int> promise;
+   auto future = promise.get_future();
+
+   // Act
+   promise = spsc_promise<int>();
+
+   // Assert
+   EXPECT_EQ(make_error_code(future_errc::broken_promise), ErrorOf([&]() { future.get(); }));
+}
+
+TEST(SpscPromiseTest, Move_CarriesTheSatisfiedState)
+{
+   // Arrange
+   spsc_promise<int> promise;
+   auto future = promise.get_future();
+   promise.set_value(1);
+
+   // Act
+   auto moved = std::move(promise);
+
+   // Assert
+   EXPECT_EQ(make_error_code(future_errc::promise_already_satisfied), ErrorOf([&]() { moved.set_value(2); }));
+   EXPECT_EQ(make_error_code(future_errc::no_state), ErrorOf([&]() { promise.set_value(2); }));
+   EXPECT_EQ(1, future.get());
+}
+
+TEST(SpscPromiseTest, GetFuture_Twice_Throws)
+{
+   // Arrange
+   spsc_promise<int> promise;
+   auto future = promise.get_future();
+
+   // Act, Assert
+   EXPECT_EQ(make_error_code(future_errc::future_already_retrieved), ErrorOf([&]() { promise.get_future(); }));
+}
+
+TEST(SpscPromiseTest, Then_RegisteredBeforeSet_RunsWhenSet)
+{
+   // Arrange
+   spsc_promise<int> promise;
+   auto future = promise.get_future().then([](eventual::future<int>& f) { return f.get() * 2; });
+
+   // Act
+   promise.set_value(21);
+
+   // Assert
+   EXPECT_EQ(42, future.get());
+}
+
+TEST(SpscPromiseTest, Then_RegisteredAfterSet_RunsImmediately)
+{
+   // Arrange
+   spsc_promise<int> promise;
+   auto future = promise.get_future();
+   promise.set_value(21);
+
+   // Act
+   auto result = future.then([](eventual::future<int>& f) { return f.get() * 2; });
+
+   // Assert
+   EXPECT_TRUE(result.is_ready());
+   EXPECT_EQ(42, result.get());
+}
+
+TEST(SpscPromiseTest, WhenAll_CombinesSpscAndOrdinaryFutures)
+{
+   // Arrange
+   spsc_promise<int> first;
+   promise<int> second;
+   auto all = when_all(first.get_future(), second.get_future());
+
+   // Act
+   second.set_value(2);
+   first.set_value(1);
+
+   // Assert
+   auto results = all.get();
+   EXPECT_EQ(1, std::get<0>(results).get());
+   EXPECT_EQ(2, std::get<1>(results).get());
+}
+
+TEST(SpscPromiseTest, Share_EveryContinuationRuns)
+{
+   // Arrange
+   spsc_promise<int> promise;
+   auto shared = promise.get_future().share();
+   auto first = shared.then([](const shared_future<int>& f) { return f.get() + 1; });
+   auto second = shared.then([](const shared_future<int>& f) { return f.get() + 2; });
+
+   // Act
+   promise.set_value(1);
+
+   // Assert
+   EXPECT_EQ(2, first.get());
+   EXPECT_EQ(3, second.get());
+}
+
+TEST(SpscPromiseTest, SetValue_NestedFuture_IsUnwrapped)
+{
+   // Arrange
+   spsc_promise<future<int>> outer;
+   promise<int> inner;
+   future<int> unwrapped(outer.get_future());
+
+   // Act
+   outer.set_value(inner.get_future());
+   inner.set_value(7);
+
+   // Assert
+   EXPECT_EQ(7, unwrapped.get());
+}
+
+TEST(SpscPromiseTest, Allocator_StateComesFromTheAllocator)
+{
+   // Arrange
+   CountingResource resource;
+   {
+      spsc_promise<int> promise(std::allocator_arg_t(), &resource);
+      auto future = promise.get_future();
+
+      // Act
+      promise.set_value(1);
+
+      // Assert
+      EXPECT_EQ(1, future.get());
+   }
+
+   EXPECT_GT(resource.GetAllocations(), 0);
+   EXPECT_EQ(0, resource.GetOutstanding());
+}
+
+TEST(SpscPromiseTest, SetValue_OnAnotherThread_EveryValueArrives)
+{
+   // Arrange
+   const int count = 10000;
+   std::vector<spsc_promise<int>> promises(count);
+   std::vector<future<int>> futures;
+   for (auto& promise : promises)
+      futures.push_back(promise.get_future());
+
+   // Act
+   std::thread producer([&promises]()
+   {
+      for (int i = 0; i < count; ++i)
+         promises[i].set_value(i);
+   });
+
+   // Assert
+   for (int i = 0; i < count; ++i)
+      EXPECT_EQ(i, futures[i].get());
+
+   producer.join();
+}
+
+TEST(SpscPromiseTest, Then_RacingSetOnAnotherThread_RunsOnce)
+{
+   for (int i = 0; i < 1000; ++i)
+   {
+      // Arrange
+      spsc_promise<int> promise;
+      auto future = promise.get_future();
+      std::thread producer([&promise, i]() { promise.set_value(i); });
+
+      // Act
+      auto result = future.then([](eventual::future<int>& f) { return f.get() + 1; });
+
+      // Assert
+      EXPECT_EQ(i + 1, result.get());
+      producer.join();
+   }
+}
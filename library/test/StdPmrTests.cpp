@@ -0,0 +1,149 @@
+#include "stdafx.h"
+#include <eventual/eventual.h>
+#include <eventual/memory_resource.h>
+
+// Only built with EVENTUAL_STD_PMR (C++17 or later), where the library's memory_resource is std::pmr's.
+#if EVENTUAL_STD_PMR
+
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+using namespace eventual;
+
+namespace
+{
+   // a std::pmr resource that knows nothing of the library
+   class StdCountingResource : public std::pmr::memory_resource
+   {
+   public:
+      int GetAllocations() const { return _allocations; }
+      int GetOutstanding() const { return _outstanding; }
+
+   private:
+      void* do_allocate(std::size_t bytes, std::size_t alignment) override
+      {
+         _allocations++;
+         _outstanding++;
+         return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+      }
+
+      void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+      {
+         _outstanding--;
+         std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+      }
+
+      bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+      {
+         return this == &other;
+      }
+
+      int _allocations = 0;
+      int _outstanding = 0;
+   };
+}
+
+TEST(StdPmrTest, Promise_WithStdPolymorphicAllocator_AllocatesOnlyTheState)
+{
+   // Arrange
+   StdCountingResource resource;
+
+   // Act
+   promise<int> promise { std::allocator_arg_t(), std::pmr::polymorphic_allocator<int>(&resource) };
+
+   // Assert
+   EXPECT_EQ(1, resource.GetAllocations()) << "The state should be allocated from the resource, without an adapter.";
+}
+
+TEST(StdPmrTest, Then_AllocatesEveryContinuationFromTheStdResource)
+{
+   // Arrange
+   StdCountingResource resource;
+
+   {
+      promise<int> promise { std::allocator_arg_t(), std::pmr::polymorphic_allocator<int>(&resource) };
+
+      // Act
+      auto result = promise.get_future()
+         .then([](auto& f) { return f.get() + 1; })
+         .then([](auto& f) { return f.get() * 2; });
+
+      promise.set_value(1);
+
+      // Assert
+      EXPECT_EQ(4, result.get());
+      EXPECT_EQ(3, resource.GetAllocations());
+   }
+
+   EXPECT_EQ(0, resource.GetOutstanding());
+}
+
+TEST(StdPmrTest, Promise_WithStdMonotonicBufferResource)
+{
+   // Arrange
+   std::array<std::byte, 4096> buffer;
+   std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size(), std::pmr::null_memory_resource());
+
+   // Act
+   promise<int> promise(std::allocator_arg_t(), &arena);
+   auto result = promise.get_future().then([](auto& f) { return f.get() + 1; });
+   promise.set_value(1);
+
+   // Assert
+   EXPECT_EQ(2, result.get());
+}
+
+TEST(StdPmrTest, PackagedTask_WithStdPolymorphicAllocator_SpillsTheCallableToTheResource)
+{
+   // Arrange
+   StdCountingResource resource;
+   std::array<char, 2 * default_function_storage> block{};
+
+   // Act
+   packaged_task<int()> task(std::allocator_arg_t(), std::pmr::polymorphic_allocator<char>(&resource),
+      [block]() { return static_cast<int>(block.size()); });
+
+   auto future = task.get_future();
+   task();
+
+   // Assert
+   EXPECT_EQ(static_cast<int>(block.size()), future.get());
+   EXPECT_EQ(2, resource.GetAllocations());
+}
+
+TEST(StdPmrTest, DefaultResource_IsStdPmrs)
+{
+   // Arrange
+   StdCountingResource resource;
+   auto previous = std::pmr::set_default_resource(&resource);
+
+   // Act
+   {
+      promise<int> promise;
+      promise.set_value(1);
+   }
+
+   std::pmr::set_default_resource(previous);
+
+   // Assert
+   EXPECT_EQ(1, resource.GetAllocations());
+   EXPECT_EQ(0, resource.GetOutstanding());
+}
+
+TEST(StdPmrTest, LibraryResources_AreStdPmrResources)
+{
+   // Arrange
+   unsynchronized_pool_resource pool;
+
+   // Act
+   std::pmr::vector<int> values(&pool);
+   for (auto i = 0; i < 100; ++i)
+      values.push_back(i);
+
+   // Assert
+   EXPECT_EQ(99, values.back());
+}
+
+#endif
@@ -0,0 +1,266 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <eventual/eventual.h>
+#include <eventual/memory_resource.h>
+#include "CountingResource.h"
+
+using namespace eventual;
+
+namespace
+{
+   using pools_t = detail::ThreadCachingPools;
+
+   bool Contains(const std::vector<void*>& blocks, void* p)
+   {
+      return std::find(blocks.begin(), blocks.end(), p) != blocks.end();
+   }
+}
+
+TEST(ThreadCachingResourceTest, Deallocate_OnSameThread_RecyclesTheBlock)
+{
+   // Arrange
+   thread_caching_resource resource;
+   auto p = resource.allocate(100);
+
+   // Act
+   resource.deallocate(p, 100);
+
+   // Assert
+   EXPECT_EQ(p, resource.allocate(100));
+}
+
+TEST(ThreadCachingResourceTest, Allocate_KeepsAFreeListPerSize)
+{
+   // Arrange
+   thread_caching_resource resource;
+   auto p = resource.allocate(200);
+   resource.deallocate(p, 200);
+
+   // Act
+   auto larger = resource.allocate(200 + pools_t::Granularity);
+   auto same = resource.allocate(200 - 1);
+
+   // Assert
+   EXPECT_NE(p, larger);
+   EXPECT_EQ(p, same) << "Sizes that round to the same multiple of max_align_t share a list.";
+}
+
+TEST(ThreadCachingResourceTest, Allocate_ShouldRespectAlignment)
+{
+   // Arrange
+   thread_caching_resource resource;
+
+   // Act/Assert
+   for (std::size_t alignment = 1; alignment <= 256; alignment *= 2)
+   {
+      auto p = resource.allocate(24, alignment);
+      EXPECT_EQ(0U, reinterpret_cast<std::uintptr_t>(p) % alignment) << "alignment " << alignment;
+      resource.deallocate(p, 24, alignment);
+   }
+}
+
+TEST(ThreadCachingResourceTest, Allocate_TakesChunksFromUpstreamInSlabs)
+{
+   // Arrange
+   CountingResource upstream;
+   thread_caching_resource resource(&upstream);
+
+   // Act
+   for (auto i = 0; i < 1000; ++i)
+      EXPECT_NE(nullptr, resource.allocate(64));
+
+   // Assert
+   EXPECT_EQ(1, upstream.GetAllocations());
+}
+
+TEST(ThreadCachingResourceTest, Allocate_LargerThanLargestBlock_GoesToUpstream)
+{
+   // Arrange
+   CountingResource upstream;
+   thread_caching_resource resource(&upstream);
+
+   // Act
+   auto p = resource.allocate(pools_t::LargestBlock + 1);
+   resource.deallocate(p, pools_t::LargestBlock + 1);
+
+   // Assert
+   EXPECT_EQ(1, upstream.GetAllocations());
+   EXPECT_EQ(0, upstream.GetOutstanding());
+}
+
+TEST(ThreadCachingResourceTest, Deallocate_OnAnotherThread_ReturnsBlocksInBatches)
+{
+   // Arrange
+   thread_caching_resource resource;
+   std::vector<void*> blocks;
+   for (std::size_t i = 0; i < pools_t::BatchSize; ++i)
+      blocks.push_back(resource.allocate(48));
+
+   promise<void> partial, resume, done;
+   auto partialFuture = partial.get_future();
+   auto resumeFuture = resume.get_future();
+   auto doneFuture = done.get_future();
+
+   std::thread consumer([&]()
+   {
+      for (std::size_t i = 0; i + 1 < blocks.size(); ++i)
+         resource.deallocate(blocks[i], 48);
+
+      partial.set_value();
+      resumeFuture.wait();
+
+      resource.deallocate(blocks.back(), 48);
+      done.set_value();
+
+      // keeps the thread (and its cache) alive until the owner has checked
+      resumeFuture.get();
+   });
+
+   // Act
+   partialFuture.wait();
+   auto beforeBatch = resource.allocate(48);
+   resume.set_value();
+   doneFuture.wait();
+   auto afterBatch = resource.allocate(48);
+
+   consumer.join();
+
+   // Assert
+   EXPECT_FALSE(Contains(blocks, beforeBatch)) << "A partial batch should stay with the freeing thread.";
+   EXPECT_TRUE(Contains(blocks, afterBatch)) << "A full batch should be returned to the owning thread.";
+}
+
+TEST(ThreadCachingResourceTest, ThreadExit_ReturnsPendingBlocksToTheirOwner)
+{
+   // Arrange
+   thread_caching_resource resource;
+   auto p = resource.allocate(48);
+
+   // Act
+   std::thread([&resource, p]() { resource.deallocate(p, 48); }).join();
+
+   // Assert
+   EXPECT_EQ(p, resource.allocate(48));
+}
+
+TEST(ThreadCachingResourceTest, ThreadExit_LeavesItsCacheToTheNextThread)
+{
+   // Arrange
+   thread_caching_resource resource;
+   void* first = nullptr;
+   void* second = nullptr;
+
+   // Act
+   std::thread([&resource, &first]()
+   {
+      first = resource.allocate(80);
+      resource.deallocate(first, 80);
+   }).join();
+
+   std::thread([&resource, &second]() { second = resource.allocate(80); }).join();
+
+   // Assert
+   EXPECT_EQ(first, second);
+}
+
+TEST(ThreadCachingResourceTest, ThreadExit_StateReleasedAfterTheCache_ReturnsItsBlock)
+{
+   // Arrange
+   thread_caching_resource resource;
+
+   // Act
+   std::thread([&resource]()
+   {
+      // the thread-exit notifier is constructed first, so it is destroyed after the cache
+      promise<int> first;
+      first.set_value_at_thread_exit(1);
+
+      promise<int> second { std::allocator_arg_t(), detail::polymorphic_allocator<int>(&resource) };
+      second.set_value_at_thread_exit(2);
+   }).join();
+
+   std::thread([&resource]() { resource.deallocate(resource.allocate(32), 32); }).join();
+
+   // Assert
+   SUCCEED() << "A State released at thread exit, after the thread's cache, should be returned safely.";
+}
+
+TEST(ThreadCachingResourceTest, Destructor_ReturnsEverythingToUpstream)
+{
+   // Arrange
+   CountingResource upstream;
+
+   // Act
+   {
+      thread_caching_resource resource(&upstream);
+      for (auto i = 0; i < 100; ++i)
+         EXPECT_NE(nullptr, resource.allocate(16 * (i % 10 + 1)));
+
+      std::thread([&resource]() { EXPECT_NE(nullptr, resource.allocate(32)); }).join();
+   }
+
+   // Assert
+   EXPECT_EQ(0, upstream.GetOutstanding());
+}
+
+TEST(ThreadCachingResourceTest, Destructor_WhileAnotherThreadHoldsACache)
+{
+   // Arrange
+   auto resource = std::make_unique<thread_caching_resource>();
+   promise<void> used, destroyed;
+   auto usedFuture = used.get_future();
+   auto destroyedFuture = destroyed.get_future();
+
+   std::thread user([&]()
+   {
+      EXPECT_NE(nullptr, resource->allocate(32));
+      used.set_value();
+      destroyedFuture.wait();
+   });
+
+   // Act
+   usedFuture.wait();
+   resource.reset();
+   destroyed.set_value();
+
+   // Assert
+   EXPECT_NO_THROW(user.join()) << "A thread should be able to exit after the resource is gone.";
+}
+
+TEST(ThreadCachingResourceTest, AsDefaultResource_RecyclesStatesReleasedOnAnotherThread)
+{
+   // Arrange
+   CountingResource upstream;
+   thread_caching_resource resource(&upstream);
+   auto previous = set_default_resource(&resource);
+
+   // Act
+   std::vector<future<int>> futures;
+   for (auto round = 0; round < 10; ++round)
+   {
+      for (auto i = 0; i < 100; ++i)
+      {
+         promise<int> promise;
+         futures.push_back(promise.get_future());
+         promise.set_value(i);
+      }
+
+      std::thread([&futures]()
+      {
+         for (auto& future : futures)
+            future.get();
+
+         futures.clear();
+      }).join();
+   }
+
+   set_default_resource(previous);
+
+   // Assert
+   EXPECT_EQ(1, upstream.GetAllocations()) << "States freed by the consumer should be reused by the producer.";
+}
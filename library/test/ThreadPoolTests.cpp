@@ -0,0 +1,189 @@
+#include "stdafx.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <eventual/thread_pool.h>
+
+using namespace eventual;
+
+namespace
+{
+   void Spawn(thread_pool& pool, std::atomic<int>& count, int depth)
+   {
+      count++;
+      if (depth == 0)
+         return;
+
+      pool.execute([&pool, &count, depth]() { Spawn(pool, count, depth - 1); });
+      pool.execute([&pool, &count, depth]() { Spawn(pool, count, depth - 1); });
+   }
+}
+
+TEST(ThreadPoolTest, IsAnExecutor)
+{
+   // Assert
+   EXPECT_TRUE(is_executor<thread_pool>::value);
+}
+
+TEST(ThreadPoolTest, Constructor_StartsAtLeastOneThread)
+{
+   // Arrange
+   thread_pool pool(0);
+
+   // Assert
+   EXPECT_EQ(1U, pool.thread_count());
+}
+
+TEST(ThreadPoolTest, Execute_RunsCallableOnAWorker)
+{
+   // Arrange
+   thread_pool pool(2);
+   promise<bool> ranOnWorker;
+   auto result = ranOnWorker.get_future();
+
+   // Act
+   pool.execute([&pool, &ranOnWorker]() { ranOnWorker.set_value(pool.running_in_this_thread()); });
+
+   // Assert
+   EXPECT_TRUE(result.get());
+   EXPECT_FALSE(pool.running_in_this_thread());
+}
+
+TEST(ThreadPoolTest, Execute_AcceptsMoveOnlyCallables)
+{
+   // Arrange
+   thread_pool pool(2);
+   auto value = std::make_unique<int>(42);
+   promise<int> observed;
+   auto result = observed.get_future();
+
+   // Act
+   pool.execute([value = std::move(value), &observed]() { observed.set_value(*value); });
+
+   // Assert
+   EXPECT_EQ(42, result.get());
+}
+
+TEST(ThreadPoolTest, Execute_RunsPackagedTask)
+{
+   // Arrange
+   thread_pool pool(2);
+   packaged_task<int()> task([]() { return 7; });
+   auto result = task.get_future();
+
+   // Act
+   pool.execute(std::move(task));
+
+   // Assert
+   EXPECT_EQ(7, result.get());
+}
+
+TEST(ThreadPoolTest, Submit_ReturnsFutureForResult)
+{
+   // Arrange
+   thread_pool pool(2);
+
+   // Act
+   auto value = pool.submit([]() { return 3; });
+   auto nothing = pool.submit([]() { });
+
+   // Assert
+   EXPECT_EQ(3, value.get());
+   EXPECT_NO_THROW(nothing.get());
+}
+
+TEST(ThreadPoolTest, Submit_AcceptsMoveOnlyCallables)
+{
+   // Arrange
+   thread_pool pool(2);
+   auto value = std::make_unique<int>(4);
+
+   // Act
+   auto result = pool.submit([value = std::move(value)]() { return *value; });
+
+   // Assert
+   EXPECT_EQ(4, result.get());
+}
+
+TEST(ThreadPoolTest, Then_RunsContinuationOnAWorker)
+{
+   // Arrange
+   thread_pool pool(2);
+   promise<int> promise;
+
+   auto continuation = promise.get_future().then(pool, [&pool](auto& f)
+   {
+      return pool.running_in_this_thread() ? f.get() : -1;
+   });
+
+   // Act
+   promise.set_value(5);
+
+   // Assert
+   EXPECT_EQ(5, continuation.get());
+}
+
+TEST(ThreadPoolTest, Destructor_RunsAllSpawnedWork)
+{
+   // Arrange
+   std::atomic<int> count(0);
+
+   // Act
+   {
+      thread_pool pool(4);
+      pool.execute([&pool, &count]() { Spawn(pool, count, 10); });
+   }
+
+   // Assert
+   EXPECT_EQ((1 << 11) - 1, count.load());
+}
+
+TEST(ThreadPoolTest, Destructor_FromAWorker_RunsTheRestOfTheWork)
+{
+   // Arrange
+   std::atomic<int> count(0);
+   eventual::promise<void> destroyed;
+   auto done = destroyed.get_future();
+   auto pool = std::make_unique<thread_pool>(2);
+
+   // Act
+   pool->execute([&pool, &count, destroyed = std::move(destroyed)]() mutable
+   {
+      Spawn(*pool, count, 4);
+      pool.reset();
+      destroyed.set_value();
+   });
+
+   // Assert
+   done.wait();
+   EXPECT_EQ((1 << 5) - 1, count.load());
+}
+
+TEST(ThreadPoolTest, Execute_FromManyThreads_RunsEveryCallable)
+{
+   // Arrange
+   constexpr auto producers = 4;
+   constexpr auto perProducer = 2000;
+   std::atomic<int> count(0);
+
+   // Act
+   {
+      thread_pool pool(3);
+      std::vector<std::thread> threads;
+      for (auto p = 0; p < producers; ++p)
+      {
+         threads.emplace_back([&pool, &count]()
+         {
+            for (auto i = 0; i < perProducer; ++i)
+               pool.execute([&count]() { count++; });
+         });
+      }
+
+      for (auto& thread : threads)
+         thread.join();
+   }
+
+   // Assert
+   EXPECT_EQ(producers * perProducer, count.load());
+}
@@ -0,0 +1,186 @@
+#include "stdafx.h"
+#include <array>
+#include <functional>
+#include <memory>
+#include <eventual/unique_function.h>
+#include "BasicAllocator.h"
+
+using namespace eventual;
+
+namespace
+{
+   int Twice(int value) { return value * 2; }
+
+   // larger than the default inline storage
+   struct LargeCallable
+   {
+      std::array<char, 2 * default_function_storage> Block;
+
+      int operator()(int value) { return value + 1; }
+   };
+}
+
+TEST(UniqueFunctionTest, DefaultConstructor_CreatesEmptyFunction)
+{
+   // Arrange
+   unique_function<int(int)> function;
+
+   // Act/Assert
+   EXPECT_FALSE(function);
+   EXPECT_TRUE(function == nullptr);
+   EXPECT_THROW(function(1), std::bad_function_call);
+}
+
+TEST(UniqueFunctionTest, NullFunctionPointer_CreatesEmptyFunction)
+{
+   // Arrange
+   int(*pointer)(int) = nullptr;
+
+   // Act
+   unique_function<int(int)> function(pointer);
+
+   // Assert
+   EXPECT_FALSE(function);
+}
+
+TEST(UniqueFunctionTest, Invoke_CallsFunctionPointer)
+{
+   // Arrange
+   unique_function<int(int)> function(&Twice);
+
+   // Act/Assert
+   ASSERT_TRUE(function);
+   EXPECT_EQ(6, function(3));
+}
+
+TEST(UniqueFunctionTest, Invoke_CallsMoveOnlyCallable)
+{
+   // Arrange
+   auto value = std::make_unique<int>(5);
+   unique_function<int()> function([value = std::move(value)]() { return *value; });
+
+   // Act/Assert
+   EXPECT_EQ(5, function());
+}
+
+TEST(UniqueFunctionTest, Invoke_ForwardsMoveOnlyArguments)
+{
+   // Arrange
+   unique_function<int(std::unique_ptr<int>)> function([](std::unique_ptr<int> value) { return *value; });
+
+   // Act/Assert
+   EXPECT_EQ(7, function(std::make_unique<int>(7)));
+}
+
+TEST(UniqueFunctionTest, Invoke_DiscardsResult_WhenSignatureReturnsVoid)
+{
+   // Arrange
+   auto invoked = false;
+   unique_function<void()> function([&invoked]() { invoked = true; return 1; });
+
+   // Act
+   function();
+
+   // Assert
+   EXPECT_TRUE(invoked);
+}
+
+TEST(UniqueFunctionTest, SmallCallable_IsHeldInPlace)
+{
+   // Arrange
+   auto alloc = BasicAllocator<int>();
+   auto value = std::make_unique<int>(1);
+
+   // Act
+   unique_function<int()> function(std::allocator_arg_t(), alloc, [value = std::move(value)]() { return *value; });
+
+   // Assert
+   EXPECT_EQ(0, alloc.GetCount()) << "A callable that fits the inline storage should not be allocated.";
+   EXPECT_EQ(1, function());
+}
+
+TEST(UniqueFunctionTest, LargeCallable_IsAllocatedFromTheProvidedAllocator)
+{
+   // Arrange
+   auto alloc = BasicAllocator<int>();
+
+   {
+      // Act
+      unique_function<int(int)> function(std::allocator_arg_t(), alloc, LargeCallable());
+
+      // Assert
+      EXPECT_EQ(1, alloc.GetCount()) << "A callable that does not fit should be allocated once.";
+      EXPECT_EQ(2, function(1));
+   }
+
+   EXPECT_EQ(0, alloc.GetCount()) << "The allocated callable was not released.";
+}
+
+TEST(UniqueFunctionTest, LargeCallable_FitsLargerInlineStorage)
+{
+   // Arrange
+   auto alloc = BasicAllocator<int>();
+
+   // Act
+   unique_function<int(int), 4 * default_function_storage> function(std::allocator_arg_t(), alloc, LargeCallable());
+
+   // Assert
+   EXPECT_EQ(0, alloc.GetCount());
+   EXPECT_EQ(2, function(1));
+}
+
+TEST(UniqueFunctionTest, MoveConstructor_TransfersTarget)
+{
+   // Arrange
+   auto alloc = BasicAllocator<int>();
+   unique_function<int(int)> small([](int value) { return value; });
+   unique_function<int(int)> large(std::allocator_arg_t(), alloc, LargeCallable());
+
+   // Act
+   auto movedSmall = std::move(small);
+   auto movedLarge = std::move(large);
+
+   // Assert
+   EXPECT_FALSE(small);
+   EXPECT_FALSE(large);
+   EXPECT_EQ(3, movedSmall(3));
+   EXPECT_EQ(4, movedLarge(3));
+   EXPECT_EQ(1, alloc.GetCount()) << "Moving an allocated callable should only move its pointer.";
+}
+
+TEST(UniqueFunctionTest, MoveAssignment_ReleasesPreviousTarget)
+{
+   // Arrange
+   auto alloc = BasicAllocator<int>();
+   unique_function<int(int)> target(std::allocator_arg_t(), alloc, LargeCallable());
+   unique_function<int(int)> source(&Twice);
+
+   // Act
+   target = std::move(source);
+
+   // Assert
+   EXPECT_EQ(0, alloc.GetCount());
+   EXPECT_FALSE(source);
+   EXPECT_EQ(4, target(2));
+}
+
+TEST(UniqueFunctionTest, Swap_ExchangesTargets)
+{
+   // Arrange
+   unique_function<int(int)> first(&Twice);
+   unique_function<int(int)> second([](int value) { return -value; });
+
+   // Act
+   swap(first, second);
+
+   // Assert
+   EXPECT_EQ(-2, first(2));
+   EXPECT_EQ(4, second(2));
+}
+
+TEST(UniqueFunctionTest, UsesAllocator)
+{
+   // Assert
+   EXPECT_TRUE((std::uses_allocator<unique_function<void()>, BasicAllocator<int>>::value));
+   EXPECT_FALSE(std::is_copy_constructible<unique_function<void()>>::value);
+}
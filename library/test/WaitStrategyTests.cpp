@@ -0,0 +1,235 @@
+#include "stdafx.h"
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <eventual/eventual.h>
+#include "CountingResource.h"
+
+using namespace eventual;
+using namespace std::chrono;
+
+namespace
+{
+   class TestException { };
+
+   // sets 'promise' to 'value' from another thread, after 'delay'
+   template<class T>
+   std::thread SetLater(promise<T>& promise, T value, nanoseconds delay)
+   {
+      return std::thread([&promise, value, delay]()
+      {
+         std::this_thread::sleep_for(delay);
+         promise.set_value(value);
+      });
+   }
+}
+
+TEST(WaitStrategyTest, Block_NeitherSpinsNorYields)
+{
+   auto strategy = wait_strategy::block();
+
+   EXPECT_EQ(nanoseconds(0), strategy.spin_time());
+   EXPECT_EQ(nanoseconds(0), strategy.yield_time());
+   EXPECT_TRUE(strategy.blocks_immediately());
+}
+
+TEST(WaitStrategyTest, Spin_SpinsThenBlocks)
+{
+   auto strategy = wait_strategy::spin(microseconds(5));
+
+   EXPECT_EQ(nanoseconds(5000), strategy.spin_time());
+   EXPECT_EQ(nanoseconds(0), strategy.yield_time());
+   EXPECT_FALSE(strategy.blocks_immediately());
+}
+
+TEST(WaitStrategyTest, Yield_YieldsThenBlocks)
+{
+   auto strategy = wait_strategy::yield(microseconds(5));
+
+   EXPECT_EQ(nanoseconds(0), strategy.spin_time());
+   EXPECT_EQ(nanoseconds(5000), strategy.yield_time());
+}
+
+TEST(WaitStrategyTest, Adaptive_SpinsOnlyWithSeveralHardwareThreads)
+{
+   auto strategy = wait_strategy::adaptive();
+
+   EXPECT_EQ(std::thread::hardware_concurrency() > 1, strategy.spin_time() > nanoseconds(0));
+   EXPECT_GT(strategy.yield_time(), nanoseconds(0));
+}
+
+TEST(WaitStrategyTest, Constructor_ClampsTimes)
+{
+   wait_strategy strategy(nanoseconds(-1), hours(24));
+
+   EXPECT_EQ(nanoseconds(0), strategy.spin_time());
+   EXPECT_EQ(nanoseconds(std::numeric_limits<std::uint32_t>::max()), strategy.yield_time());
+}
+
+TEST(WaitStrategyTest, Wait_Spinning_ReturnsWhenAnotherThreadSetsTheValue)
+{
+   promise<int> promise;
+   auto future = promise.get_future();
+   auto thread = SetLater(promise, 7, microseconds(100));
+
+   future.wait(wait_strategy::spin(seconds(10)));
+   EXPECT_EQ(7, future.get());
+   thread.join();
+}
+
+TEST(WaitStrategyTest, Wait_Yielding_ReturnsWhenAnotherThreadSetsTheValue)
+{
+   promise<int> promise;
+   auto future = promise.get_future();
+   auto thread = SetLater(promise, 7, microseconds(100));
+
+   future.wait(wait_strategy::yield(seconds(10)));
+   EXPECT_EQ(7, future.get());
+   thread.join();
+}
+
+TEST(WaitStrategyTest, Wait_SpinExpires_BlocksUntilReady)
+{
+   promise<int> promise;
+   auto future = promise.get_future();
+   auto thread = SetLater(promise, 7, milliseconds(20));
+
+   future.wait(wait_strategy(microseconds(10), microseconds(10)));
+   EXPECT_EQ(7, future.get());
+   thread.join();
+}
+
+TEST(WaitStrategyTest, Wait_Ready_ReturnsWithoutWaiting)
+{
+   auto future = make_ready_future(3);
+
+   future.wait(wait_strategy::spin(seconds(10)));
+   EXPECT_EQ(3, future.get());
+}
+
+TEST(WaitStrategyTest, Wait_Exceptional_ReturnsAndGetThrows)
+{
+   promise<void> promise;
+   auto future = promise.get_future();
+   promise.set_exception(std::make_exception_ptr(TestException()));
+
+   EXPECT_NO_THROW(future.wait(wait_strategy::spin(seconds(1))));
+   EXPECT_THROW(future.get(), TestException);
+}
+
+TEST(WaitStrategyTest, Wait_Invalid_ThrowsNoState)
+{
+   future<int> future;
+
+   EXPECT_THROW(future.wait(wait_strategy::block()), future_error);
+}
+
+TEST(WaitStrategyTest, Wait_Reference_GetReturnsTheReference)
+{
+   int value = 0;
+   promise<int&> promise;
+   auto future = promise.get_future();
+   promise.set_value(value);
+
+   future.wait(wait_strategy::adaptive());
+   EXPECT_EQ(&value, &future.get());
+}
+
+TEST(WaitStrategyTest, Wait_SharedFuture_GetReturnsTheValue)
+{
+   promise<int> promise;
+   auto future = promise.get_future().share();
+   auto thread = SetLater(promise, 7, microseconds(100));
+
+   future.wait(wait_strategy::spin(seconds(10)));
+   EXPECT_EQ(7, future.get());
+   future.wait(wait_strategy::block());
+   EXPECT_EQ(7, future.get());
+   thread.join();
+}
+
+TEST(WaitStrategyTest, WaitFor_Spinning_TimesOutAtTheDeadline)
+{
+   promise<int> promise;
+   auto future = promise.get_future();
+
+   auto start = steady_clock::now();
+   auto status = future.wait_for(milliseconds(20), wait_strategy::spin(seconds(10)));
+
+   EXPECT_EQ(future_status::timeout, status);
+   EXPECT_GE(steady_clock::now() - start, milliseconds(20));
+   EXPECT_LT(steady_clock::now() - start, seconds(5));
+}
+
+TEST(WaitStrategyTest, WaitUntil_Yielding_TimesOutAtTheDeadline)
+{
+   promise<int> promise;
+   auto future = promise.get_future();
+
+   auto deadline = steady_clock::now() + milliseconds(20);
+   auto status = future.wait_until(deadline, wait_strategy::yield(seconds(10)));
+
+   EXPECT_EQ(future_status::timeout, status);
+   EXPECT_GE(steady_clock::now(), deadline);
+}
+
+TEST(WaitStrategyTest, WaitFor_Spinning_ReturnsReadyWhenSet)
+{
+   promise<int> promise;
+   auto future = promise.get_future();
+   auto thread = SetLater(promise, 7, microseconds(100));
+
+   EXPECT_EQ(future_status::ready, future.wait_for(seconds(10), wait_strategy::spin(seconds(10))));
+   EXPECT_EQ(7, future.get());
+   thread.join();
+}
+
+TEST(WaitStrategyTest, Promise_WaitStrategy_IsTheDefaultOfItsFutures)
+{
+   promise<int> promise(wait_strategy::spin(seconds(10)));
+   auto future = promise.get_future();
+   auto thread = SetLater(promise, 7, microseconds(100));
+
+   // the promise's strategy spins for the whole wait; the result must still be delivered.
+   future.wait();
+   EXPECT_EQ(7, future.get());
+   thread.join();
+}
+
+TEST(WaitStrategyTest, Promise_WaitStrategy_TimedWaitStillTimesOut)
+{
+   promise<void> promise(wait_strategy::spin(seconds(10)));
+   auto future = promise.get_future();
+
+   EXPECT_EQ(future_status::timeout, future.wait_for(milliseconds(10)));
+}
+
+TEST(WaitStrategyTest, Promise_AllocatorAndWaitStrategy_AllocatesFromTheAllocator)
+{
+   CountingResource resource;
+   {
+      promise<int> promise(std::allocator_arg_t(), &resource, wait_strategy::block());
+      auto future = promise.get_future();
+      promise.set_value(1);
+
+      future.wait(wait_strategy::block());
+   EXPECT_EQ(1, future.get());
+   }
+
+   EXPECT_GT(resource.GetAllocations(), 0);
+   EXPECT_EQ(resource.GetAllocations(), resource.GetDeallocations());
+}
+
+TEST(WaitStrategyTest, Promise_UnwrappingWithWaitStrategy_WaitsForTheInnerFuture)
+{
+   promise<future<int>> outer(wait_strategy::yield(seconds(10)));
+   promise<int> inner;
+   future<int> unwrapped(outer.get_future());
+   outer.set_value(inner.get_future());
+   auto thread = SetLater(inner, 7, microseconds(100));
+
+   EXPECT_EQ(7, unwrapped.get());
+   thread.join();
+}
@@ -0,0 +1,109 @@
+#include "stdafx.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <eventual/detail/work_stealing.h>
+
+using namespace eventual::detail;
+
+TEST(WorkStealingDequeTest, Pop_ReturnsNewestItemFirst)
+{
+   // Arrange
+   int items[3];
+   WorkStealingDeque<int*> deque;
+   for (auto& item : items)
+      deque.Push(&item);
+
+   // Act / Assert
+   EXPECT_EQ(&items[2], deque.Pop());
+   EXPECT_EQ(&items[1], deque.Pop());
+   EXPECT_EQ(&items[0], deque.Pop());
+   EXPECT_EQ(nullptr, deque.Pop());
+}
+
+TEST(WorkStealingDequeTest, Steal_ReturnsOldestItemFirst)
+{
+   // Arrange
+   int items[3];
+   WorkStealingDeque<int*> deque;
+   for (auto& item : items)
+      deque.Push(&item);
+
+   // Act / Assert
+   EXPECT_EQ(&items[0], deque.Steal());
+   EXPECT_EQ(&items[1], deque.Steal());
+   EXPECT_EQ(&items[2], deque.Pop());
+   EXPECT_EQ(nullptr, deque.Steal());
+   EXPECT_TRUE(deque.Empty());
+}
+
+TEST(WorkStealingDequeTest, Push_GrowsBeyondInitialCapacity)
+{
+   // Arrange
+   std::vector<int> items(100);
+   WorkStealingDeque<int*> deque(4);
+
+   // Act
+   for (auto& item : items)
+      deque.Push(&item);
+
+   // Assert
+   EXPECT_EQ(&items.front(), deque.Steal());
+   for (auto i = items.size(); i-- > 1; )
+      EXPECT_EQ(&items[i], deque.Pop());
+
+   EXPECT_TRUE(deque.Empty());
+}
+
+TEST(WorkStealingDequeTest, ConcurrentThieves_TakeEachItemExactlyOnce)
+{
+   // Arrange
+   constexpr auto itemCount = 20000;
+   constexpr auto thiefCount = 3;
+   std::vector<int> items(itemCount);
+   std::vector<std::atomic<int>> taken(itemCount);
+   for (auto& count : taken)
+      count = 0;
+
+   WorkStealingDeque<int*> deque(8);
+   std::atomic<bool> done(false);
+
+   auto take = [&items, &taken](int* item)
+   {
+      taken[item - items.data()]++;
+   };
+
+   // Act
+   std::vector<std::thread> thieves;
+   for (auto t = 0; t < thiefCount; ++t)
+   {
+      thieves.emplace_back([&deque, &done, &take]()
+      {
+         while (!done.load() || !deque.Empty())
+         {
+            if (auto item = deque.Steal())
+               take(item);
+         }
+      });
+   }
+
+   for (auto i = 0; i < itemCount; ++i)
+   {
+      deque.Push(&items[i]);
+
+      // the owner competes for its own work, too
+      if (i % 3 == 0)
+      {
+         if (auto item = deque.Pop())
+            take(item);
+      }
+   }
+
+   done = true;
+   for (auto& thief : thieves)
+      thief.join();
+
+   // Assert
+   for (auto i = 0; i < itemCount; ++i)
+      ASSERT_EQ(1, taken[i].load()) << "item " << i;
+}